@@ -44,6 +44,7 @@ public class BasicConnection extends NativeLibrary {
 
   public native long readKey (boolean wait);
   public native long readKeyWithTimeout (int milliseconds);
+  public native int readKeys (int milliseconds, long[] keys);
 
   public native void ignoreKeys (long type, long[] keys);
   public native void acceptKeys (long type, long[] keys);
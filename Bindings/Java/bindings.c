@@ -694,6 +694,35 @@ JAVA_INSTANCE_METHOD(
   return (jlong)code;
 }
 
+JAVA_INSTANCE_METHOD(
+  org_a11y_brlapi_BasicConnection, readKeys, jint,
+  jint timeout_ms, jlongArray jcodes
+) {
+  jlong *codes;
+  unsigned int n;
+  int result;
+  GET_CONNECTION_HANDLE(env, this, -1);
+
+  if (!jcodes) {
+    throwJavaError(env, JAVA_OBJ_NULL_POINTER_EXCEPTION, __func__);
+    return -1;
+  }
+
+  n = (unsigned int) (*env)->GetArrayLength(env, jcodes);
+  codes = (*env)->GetLongArrayElements(env, jcodes, NULL);
+
+  result = brlapi__readKeys(handle, timeout_ms, (brlapi_keyCode_t *)codes, n);
+
+  if (result < 0) {
+    (*env)->ReleaseLongArrayElements(env, jcodes, codes, JNI_ABORT);
+    throwConnectionError(env);
+    return -1;
+  }
+
+  (*env)->ReleaseLongArrayElements(env, jcodes, codes, 0);
+  return (jint) result;
+}
+
 JAVA_INSTANCE_METHOD(
   org_a11y_brlapi_BasicConnection, ignoreKeys, void,
   jlong jrange, jlongArray js
@@ -346,6 +346,27 @@ CAMLprim value brlapiml_readKeyWithTimeout(value handle, value timeout_ms)
   CAMLreturn(retVal);
 }
 
+CAMLprim value brlapiml_readKeys(value handle, value timeout_ms, value count)
+{
+  CAMLparam3(handle, timeout_ms, count);
+  CAMLlocal1(retVal);
+  /* A bounded buffer rather than one sized by the caller: errors are raised
+   * by longjmp, which would leak a heap allocation. Any further keys are left
+   * for the next call. */
+  brlapi_keyCode_t keyCodes[0X100];
+  const int maximum = sizeof(keyCodes) / sizeof(keyCodes[0]);
+  int i, res, size = Int_val(count);
+  if (size<=0) CAMLreturn(Atom(0));
+  if (size>maximum) size = maximum;
+  {
+    brlapiCheckErrorWithCode(readKeys, &res, Int_val(timeout_ms), keyCodes, size);
+    if (res==0) CAMLreturn(Atom(0));
+    retVal = caml_alloc(res, 0);
+    for (i=0; i<res; i++) Store_field(retVal, i, caml_copy_int64(keyCodes[i]));
+  }
+  CAMLreturn(retVal);
+}
+
 CAMLprim value brlapiml_waitKey(value handle, value unit)
 {
   CAMLparam2(handle, unit);
@@ -163,6 +163,8 @@ external waitKey :
   ?h:handle -> unit -> int64 = "brlapiml_waitKey"
 external readKeyWithTimeout :
   ?h:handle -> int -> int64 option = "brlapiml_readKeyWithTimeout"
+external readKeys :
+  ?h:handle -> int -> int -> int64 array = "brlapiml_readKeys"
 
 type expandedKeyCode = {
   type_ : int32;
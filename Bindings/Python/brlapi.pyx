@@ -636,6 +636,29 @@ cdef class Connection:
 		else:
 			return code
 
+	def readKeys(self, timeout_ms = -1, count = 64):
+		"""Read all the pending keys from the braille keyboard.
+		See brlapi_readKeys(3).
+
+		This function works like readKeyWithTimeout, except that it returns a list of all the key codes which have already been received (at most count of them), and an empty list if the timeout expires."""
+		cdef c_brlapi.brlapi_keyCode_t *c_codes
+		cdef int retval
+		cdef int c_timeout_ms
+		cdef unsigned int c_count
+		c_timeout_ms = timeout_ms
+		c_count = count
+		if c_count == 0:
+			return []
+		c_codes = <c_brlapi.brlapi_keyCode_t*>c_brlapi.malloc(c_count * sizeof(c_brlapi.brlapi_keyCode_t))
+		with nogil:
+			retval = c_brlapi.brlapi__readKeys(self.h, c_timeout_ms, c_codes, c_count)
+		if retval == -1:
+			c_brlapi.free(c_codes)
+			raise OperationError()
+		codes = [c_codes[i] for i in range(retval)]
+		c_brlapi.free(c_codes)
+		return codes
+
 	def expandKeyCode(self, code):
 		"""Expand a keycode into its individual components.
 		This is a stub to maintain backward compatibility.
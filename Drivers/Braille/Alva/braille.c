@@ -577,7 +577,7 @@ typedef struct {
 typedef struct {
   void (*initializeVariables) (BrailleDisplay *brl, char **parameters);
 
-  BraillePacketVerifier *verifyPacket;
+  const BraillePacketFormat *packetFormat;
   int (*readPacket) (BrailleDisplay *brl, unsigned char *packet, int size);
 
   const SettingsUpdateEntry *requiredSettings;
@@ -664,7 +664,7 @@ parseDecimalField (
 
 static int
 readPacket (BrailleDisplay *brl, unsigned char *packet, int size) {
-  return readBraillePacket(brl, NULL, packet, size, protocol->verifyPacket, NULL);
+  return readFormattedBraillePacket(brl, NULL, packet, size, protocol->packetFormat, NULL);
 }
 
 static int
@@ -1399,50 +1399,29 @@ interpretKeyEvent2 (BrailleDisplay *brl, unsigned char group, unsigned char key)
   return EOF;
 }
 
-static BraillePacketVerifierResult
-verifyPacket2s (
-  BrailleDisplay *brl,
-  const unsigned char *bytes, size_t size,
-  size_t *length, void *data
-) {
-  unsigned char byte = bytes[size-1];
-
-  switch (size) {
-    case 1:
-      switch (byte) {
-        case ESC:
-          *length = 2;
-          break;
-
-        default:
-          return BRL_PVR_INVALID;
-      }
-      break;
-
-    case 2:
-      switch (byte) {
-        case 0X32: /* 2 */ *length =  5; break;
-        case 0X3F: /* ? */ *length =  3; break;
-        case 0X45: /* E */ *length =  3; break;
-        case 0X4B: /* K */ *length =  4; break;
-        case 0X4E: /* N */ *length = 14; break;
-        case 0X50: /* P */ *length =  3; break;
-        case 0X54: /* T */ *length =  4; break;
-        case 0X56: /* V */ *length = 13; break;
-        case 0X68: /* h */ *length = 10; break;
-        case 0X72: /* r */ *length = 3; break;
-
-        default:
-          return BRL_PVR_INVALID;
-      }
-      break;
+static const unsigned char packetHeader2s[] = {ESC};
+
+static const BraillePacketLayout packetTypes2s[] = {
+  [0X32] = {.length =  5}, /* 2 */
+  [0X3F] = {.length =  3}, /* ? */
+  [0X45] = {.length =  3}, /* E */
+  [0X4B] = {.length =  4}, /* K */
+  [0X4E] = {.length = 14}, /* N */
+  [0X50] = {.length =  3}, /* P */
+  [0X54] = {.length =  4}, /* T */
+  [0X56] = {.length = 13}, /* V */
+  [0X68] = {.length = 10}, /* h */
+  [0X72] = {.length =  3}, /* r */
+};
 
-    default:
-      break;
-  }
+static const BraillePacketFormat packetFormat2s = {
+  .header = packetHeader2s,
+  .headerLength = sizeof(packetHeader2s),
 
-  return BRL_PVR_INCLUDE;
-}
+  .types = packetTypes2s,
+  .typeCount = ARRAY_COUNT(packetTypes2s),
+  .typeOffset = 1
+};
 
 static int
 setFeature2s (BrailleDisplay *brl, const unsigned char *request, size_t size) {
@@ -1635,7 +1614,7 @@ static const SettingsUpdateEntry requiredSettings2s[] = {
 static const ProtocolOperations protocol2sOperations = {
   .initializeVariables = initializeVariables2,
 
-  .verifyPacket = verifyPacket2s,
+  .packetFormat = &packetFormat2s,
   .readPacket = readPacket,
 
   .requiredSettings = requiredSettings2s,
@@ -1649,31 +1628,16 @@ static const ProtocolOperations protocol2sOperations = {
   .writeBraille = writeBraille2s
 };
 
-static BraillePacketVerifierResult
-verifyPacket2u (
-  BrailleDisplay *brl,
-  const unsigned char *bytes, size_t size,
-  size_t *length, void *data
-) {
-  unsigned char byte = bytes[size-1];
-
-  switch (size) {
-    case 1:
-      switch (byte) {
-        case 0X01: *length = 9; break;
-        case 0X04: *length = 3; break;
-
-        default:
-          return BRL_PVR_INVALID;
-      }
-      break;
-
-    default:
-      break;
-  }
+static const BraillePacketLayout packetTypes2u[] = {
+  [0X01] = {.length = 9},
+  [0X04] = {.length = 3},
+};
 
-  return BRL_PVR_INCLUDE;
-}
+static const BraillePacketFormat packetFormat2u = {
+  .types = packetTypes2u,
+  .typeCount = ARRAY_COUNT(packetTypes2u),
+  .typeOffset = 0
+};
 
 static int
 setFeature2u (BrailleDisplay *brl, const unsigned char *request, size_t size) {
@@ -1828,7 +1792,7 @@ static const SettingsUpdateEntry requiredSettings2u[] = {
 static const ProtocolOperations protocol2uOperations = {
   .initializeVariables = initializeVariables2,
 
-  .verifyPacket = verifyPacket2u,
+  .packetFormat = &packetFormat2u,
   .readPacket = readPacket,
 
   .requiredSettings = requiredSettings2u,
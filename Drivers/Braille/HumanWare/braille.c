@@ -354,34 +354,22 @@ handlePoweringOff (BrailleDisplay *brl) {
   brl->data->isOffline = 1;
 }
 
-static BraillePacketVerifierResult
-verifySerialPacket (
-  BrailleDisplay *brl,
-  const unsigned char *bytes, size_t size,
-  size_t *length, void *data
-) {
-  unsigned char byte = bytes[size-1];
+static const unsigned char serialPacketHeader[] = {ESC};
 
-  switch (size) {
-    case 1:
-      if (byte != ESC) return BRL_PVR_INVALID;
-      *length = 3;
-      break;
+static const BraillePacketFormat serialPacketFormat = {
+  .header = serialPacketHeader,
+  .headerLength = sizeof(serialPacketHeader),
 
-    case 3:
-      *length += byte;
-      break;
-
-    default:
-      break;
+  .layout = {
+    .length = 3,
+    .lengthOffset = 2,
+    .lengthSize = 1
   }
-
-  return BRL_PVR_INCLUDE;
-}
+};
 
 static size_t
 readSerialPacket (BrailleDisplay *brl, void *buffer, size_t size) {
-  return readBraillePacket(brl, NULL, buffer, size, verifySerialPacket, NULL);
+  return readFormattedBraillePacket(brl, NULL, buffer, size, &serialPacketFormat, NULL);
 }
 
 static int
@@ -210,65 +210,54 @@ verifyPacket1 (
   const unsigned char *bytes, size_t size,
   size_t *length, void *data
 ) {
-  unsigned char byte = bytes[size-1];
+  switch (bytes[1]) {
+    case PM_P1_PKT_RECEIVE:
+      if (size != 10) return BRL_PVR_INVALID;
+      break;
 
-  switch (size) {
-    case 1:
-      *length = 2;
-      if (byte != STX) return BRL_PVR_INVALID;
+    default:
       break;
+  }
 
-    case 2:
-      switch (byte) {
-        case PM_P1_PKT_IDENTITY:
-          *length = 10;
-          break;
+  return BRL_PVR_INCLUDE;
+}
 
-        case PM_P1_PKT_RECEIVE:
-          *length = 6;
-          break;
+static const unsigned char packetHeader1[] = {STX};
 
-        case 0X03:
-        case 0X04:
-        case 0X05:
-        case 0X06:
-        case 0X07:
-          *length = 3;
-          break;
+static const BraillePacketLayout packetTypes1[] = {
+  [PM_P1_PKT_IDENTITY] = {.length = 10},
 
-        default:
-          return BRL_PVR_INVALID;
-      }
-      break;
+  [PM_P1_PKT_RECEIVE] = {
+    .lengthOffset = 4,
+    .lengthSize = 2,
+    .lengthIsBigEndian = 1,
+    .maximumLength = 10
+  },
 
-    case 6:
-      switch (bytes[1]) {
-        case PM_P1_PKT_RECEIVE:
-          *length = (bytes[4] << 8) | byte;
-          if (*length != 10) return BRL_PVR_INVALID;
-          break;
+  [0X03] = {.length = 3},
+  [0X04] = {.length = 3},
+  [0X05] = {.length = 3},
+  [0X06] = {.length = 3},
+  [0X07] = {.length = 3},
+};
 
-        default:
-          break;
-      }
-      break;
+static const BraillePacketFormat packetFormat1 = {
+  .header = packetHeader1,
+  .headerLength = sizeof(packetHeader1),
 
-    default:
-      break;
-  }
+  .hasTerminator = 1,
+  .terminator = ETX,
 
-  if (size == *length) {
-    if (byte != ETX) {
-      return BRL_PVR_INVALID;
-    }
-  }
+  .types = packetTypes1,
+  .typeCount = ARRAY_COUNT(packetTypes1),
+  .typeOffset = 1,
 
-  return BRL_PVR_INCLUDE;
-}
+  .verifyPacket = verifyPacket1
+};
 
 static size_t
 readPacket1 (BrailleDisplay *brl, void *packet, size_t size) {
-  return readBraillePacket(brl, NULL, packet, size, verifyPacket1, NULL);
+  return readFormattedBraillePacket(brl, NULL, packet, size, &packetFormat1, NULL);
 }
 
 static int
@@ -86,9 +86,21 @@ static unsigned char typeFlags[TYPE_COUNT];
 static char *curSender;
 static char *curPath;
 
+/* The rows are kept in a gap buffer so that runs of insertions and deletions
+ * at about the same place (the usual case for a terminal) don't have to move
+ * the whole scrollback. A Fenwick tree over the row slots (gap slots have a
+ * length of 0) maps a text offset to its row in logarithmic time.
+ */
+typedef struct {
+  wchar_t *text;
+  long length;
+} RowEntry;
+
+static RowEntry *rowEntries;
+static long *rowIndex;
+static long rowSlots, rowGapStart, rowGapEnd;
+
 static long curNumRows, curNumCols;
-static wchar_t **curRows;
-static long *curRowLengths;
 static long curCaret,curPosX,curPosY;
 
 static DBusConnection *bus = NULL;
@@ -220,23 +232,183 @@ static size_t my_mbslen(const char *s, size_t n) {
   return ret;
 }
 
+static long rowSlot(long y) {
+  return (y < rowGapStart)? y: y + (rowGapEnd - rowGapStart);
+}
+
+static RowEntry *getRow(long y) {
+  return &rowEntries[rowSlot(y)];
+}
+
+static void adjustRowIndex(long slot, long delta) {
+  if (delta)
+    for (slot++; slot <= rowSlots; slot += slot & -slot)
+      rowIndex[slot] += delta;
+}
+
+static void buildRowIndex(void) {
+  long slot, next;
+  for (slot=1; slot<=rowSlots; slot++)
+    rowIndex[slot] = rowEntries[slot-1].length;
+  for (slot=1; slot<=rowSlots; slot++)
+    if ((next = slot + (slot & -slot)) <= rowSlots)
+      rowIndex[next] += rowIndex[slot];
+}
+
+static long getRowsLength(void) {
+  long slot, length = 0;
+  for (slot=rowSlots; slot>0; slot -= slot & -slot)
+    length += rowIndex[slot];
+  return length;
+}
+
+static void setRowLength(long y, long length) {
+  RowEntry *row = getRow(y);
+  adjustRowIndex(rowSlot(y), length - row->length);
+  row->length = length;
+}
+
+static void refreshRowIndexNode(long node) {
+  long step;
+  rowIndex[node] = rowEntries[node-1].length;
+  for (step=1; step<(node & -node); step<<=1)
+    rowIndex[node] += rowIndex[node-step];
+}
+
+/* The slots from first up to (but not including) end have been rewritten,
+ * changing their total length by delta. Only the nodes which cover those
+ * slots are refreshed, so the cost follows the size of the range rather
+ * than the number of slots - unless the range is most of the buffer, in
+ * which case the linear rebuild is cheaper.
+ */
+static void refreshRowIndex(long first, long end, long delta) {
+  long node;
+
+  if ((end - first) * 2 > rowSlots) {
+    buildRowIndex();
+    return;
+  }
+
+  for (node=first+1; node<=end; node++)
+    refreshRowIndexNode(node);
+  for (node=end + (end & -end); node<=rowSlots; node += node & -node) {
+    if (node - (node & -node) <= first)
+      rowIndex[node] += delta;
+    else
+      refreshRowIndexNode(node);
+  }
+}
+
+static void moveRowGap(long pos) {
+  long from, to, count, length, slot, end;
+
+  if (pos < rowGapStart) {
+    count = rowGapStart - pos;
+    from = pos;
+    to = rowGapEnd - count;
+  } else if (pos > rowGapStart) {
+    count = pos - rowGapStart;
+    from = rowGapEnd;
+    to = rowGapStart;
+  } else {
+    return;
+  }
+
+  if ((to + count <= from) || (from + count <= to)) {
+    /* the ranges are disjoint so each can be refreshed on its own */
+    for (length=0, slot=from; slot<from+count; slot++)
+      length += rowEntries[slot].length;
+    memcpy(&rowEntries[to], &rowEntries[from], count*sizeof(*rowEntries));
+    refreshRowIndex(to, to+count, length);
+
+    for (slot=from; slot<from+count; slot++) {
+      rowEntries[slot].text = NULL;
+      rowEntries[slot].length = 0;
+    }
+    refreshRowIndex(from, from+count, -length);
+  } else {
+    memmove(&rowEntries[to], &rowEntries[from], count*sizeof(*rowEntries));
+
+    /* clear the slots which have become part of the gap */
+    if (to < from) {
+      slot = to + count;
+      end = from + count;
+    } else {
+      slot = from;
+      end = to;
+    }
+    for (; slot<end; slot++) {
+      rowEntries[slot].text = NULL;
+      rowEntries[slot].length = 0;
+    }
+
+    if (to < from)
+      refreshRowIndex(to, from+count, 0);
+    else
+      refreshRowIndex(from, to+count, 0);
+  }
+
+  rowGapEnd += pos - rowGapStart;
+  rowGapStart = pos;
+}
+
+static void growRows(long num) {
+  long gap = rowGapEnd - rowGapStart;
+  long slots, tail, y;
+  RowEntry *entries;
+
+  if (gap >= num)
+    return;
+  slots = MAX(rowSlots * 2, rowSlots - gap + num);
+  if (slots < 0X40)
+    slots = 0X40;
+  tail = rowSlots - rowGapEnd;
+  entries = malloc(slots*sizeof(*entries));
+  memcpy(entries,rowEntries,rowGapStart*sizeof(*entries));
+  memcpy(entries+slots-tail,rowEntries+rowGapEnd,tail*sizeof(*entries));
+  for (y=rowGapStart; y<slots-tail; y++) {
+    entries[y].text = NULL;
+    entries[y].length = 0;
+  }
+  free(rowEntries);
+  rowEntries = entries;
+  rowGapEnd = slots - tail;
+  rowSlots = slots;
+  free(rowIndex);
+  rowIndex = malloc((rowSlots+1)*sizeof(*rowIndex));
+  buildRowIndex();
+}
+
 static void addRows(long pos, long num) {
+  growRows(num);
+  moveRowGap(pos);
+  rowGapStart += num;
   curNumRows += num;
-  curRows = realloc(curRows,curNumRows*sizeof(*curRows));
-  curRowLengths = realloc(curRowLengths,curNumRows*sizeof(*curRowLengths));
-  memmove(curRows      +pos+num,curRows      +pos,(curNumRows-(pos+num))*sizeof(*curRows));
-  memmove(curRowLengths+pos+num,curRowLengths+pos,(curNumRows-(pos+num))*sizeof(*curRowLengths));
 }
 
 static void delRows(long pos, long num) {
   long y;
-  for (y=pos;y<pos+num;y++)
-    free(curRows[y]);
-  memmove(curRows      +pos,curRows      +pos+num,(curNumRows-(pos+num))*sizeof(*curRows));
-  memmove(curRowLengths+pos,curRowLengths+pos+num,(curNumRows-(pos+num))*sizeof(*curRowLengths));
+  moveRowGap(pos);
+  for (y=rowGapEnd; y<rowGapEnd+num; y++) {
+    adjustRowIndex(y, -rowEntries[y].length);
+    free(rowEntries[y].text);
+    rowEntries[y].text = NULL;
+    rowEntries[y].length = 0;
+  }
+  rowGapEnd += num;
   curNumRows -= num;
-  curRows = realloc(curRows,curNumRows*sizeof(*curRows));
-  curRowLengths = realloc(curRowLengths,curNumRows*sizeof(*curRowLengths));
+}
+
+static void clearRows(void) {
+  long y;
+  for (y=0; y<rowSlots; y++)
+    free(rowEntries[y].text);
+  free(rowEntries);
+  rowEntries = NULL;
+  free(rowIndex);
+  rowIndex = NULL;
+  rowSlots = rowGapStart = rowGapEnd = 0;
+  curNumRows = 0;
 }
 
 static int
@@ -354,14 +526,9 @@ send_with_reply_and_block(DBusConnection *bus, DBusMessage *msg, int timeout_ms,
 }
 
 static void findPosition(long position, long *px, long *py) {
-  long offset=0, newoffset, x, y;
+  long offset=0, slot=0, step, x, y;
   /* XXX: I don't know what they do with necessary combining accents */
-  for (y=0; y<curNumRows; y++) {
-    if ((newoffset = offset + curRowLengths[y]) > position)
-      break;
-    offset = newoffset;
-  }
-  if (y==curNumRows) {
+  if (position >= getRowsLength()) {
     if (!curNumRows) {
       y = 0;
       x = 0;
@@ -370,10 +537,21 @@ static void findPosition(long position, long *px, long *py) {
        * terminal: caret position is only updated afterwards... In the
        * meanwhile, keep caret at the end of last line. */
       y = curNumRows-1;
-      x = curRowLengths[y];
+      x = getRow(y)->length;
+    }
+  } else {
+    /* descend the index to the last slot whose end is still <= position,
+     * the row we want is in the slot just after it */
+    for (step=1; step*2<=rowSlots; step*=2);
+    for (; step; step/=2) {
+      if (slot+step <= rowSlots && offset+rowIndex[slot+step] <= position) {
+        slot += step;
+        offset += rowIndex[slot];
+      }
     }
-  } else
+    y = (slot < rowGapStart)? slot: slot - (rowGapEnd - rowGapStart);
     x = position-offset;
+  }
   *px = x;
   *py = y;
 }
@@ -391,9 +569,8 @@ static void finiTerm(void) {
   free(curPath);
   curPath = NULL;
   curPosX = curPosY = 0;
-  free(curRows);
-  curRows = NULL;
-  curNumCols = curNumRows = 0;
+  clearRows();
+  curNumCols = 0;
 }
 
 /* Get the role of an AT-SPI2 object */
@@ -511,13 +688,7 @@ static void restartTerm(const char *sender, const char *path) {
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "new term %s:%s with text %s",curSender,curPath, text);
 
-  if (curRows) {
-    for (i=0;i<curNumRows;i++)
-      free(curRows[i]);
-    free(curRows);
-  }
-  curNumRows = 0;
-  free(curRowLengths);
+  clearRows();
   c = text;
   while (*c) {
     curNumRows++;
@@ -527,8 +698,9 @@ static void restartTerm(const char *sender, const char *path) {
   }
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "%ld rows",curNumRows);
-  curRows = malloc(curNumRows * sizeof(*curRows));
-  curRowLengths = malloc(curNumRows * sizeof(*curRowLengths));
+  rowSlots = rowGapStart = rowGapEnd = curNumRows;
+  rowEntries = malloc(rowSlots * sizeof(*rowEntries));
+  rowIndex = malloc((rowSlots+1) * sizeof(*rowIndex));
   i = 0;
   curNumCols = 0;
   for (c = text; *c; c = d+1) {
@@ -536,7 +708,7 @@ static void restartTerm(const char *sender, const char *path) {
     if (d)
       *d = 0;
     e = c;
-    curRowLengths[i] = (len = my_mbsrtowcs(NULL,&e,0,NULL)) + (d != NULL);
+    rowEntries[i].length = (len = my_mbsrtowcs(NULL,&e,0,NULL)) + (d != NULL);
     if (len > curNumCols)
       curNumCols = len;
     else if (len < 0) {
@@ -544,17 +716,18 @@ static void restartTerm(const char *sender, const char *path) {
 	logMessage(LOG_ERR,"unterminated sequence %s",c);
       else if (len==-1)
 	logSystemError("mbrlen");
-      curRowLengths[i] = (len = -1) + (d != NULL);
+      rowEntries[i].length = (len = -1) + (d != NULL);
     }
-    curRows[i] = malloc((len + (d!=NULL)) * sizeof(*curRows[i]));
+    rowEntries[i].text = malloc((len + (d!=NULL)) * sizeof(*rowEntries[i].text));
     e = c;
-    my_mbsrtowcs(curRows[i],&e,len,NULL);
+    my_mbsrtowcs(rowEntries[i].text,&e,len,NULL);
     if (d)
-      curRows[i][len]='\n';
+      rowEntries[i].text[len]='\n';
     else
       break;
     i++;
   }
+  buildRowIndex();
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "%ld cols",curNumCols);
   caretPosition(getCaret(sender, path));
@@ -577,26 +750,18 @@ static void tryRestartTerm(const char *sender, const char *path) {
   free(role);
 }
 
-/* Get the state of an object */
-static dbus_uint32_t *getState(const char *sender, const char *path)
+/* Extract the state from a GetState reply */
+static dbus_uint32_t *getStateFromReply(DBusMessage *reply)
 {
-  DBusMessage *msg, *reply;
   DBusMessageIter iter, iter_array;
   dbus_uint32_t *states, *ret = NULL;
   int count;
 
-  msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetState");
-  if (!msg)
-    return NULL;
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting state");
-  if (!reply)
-    return NULL;
-
   if (strcmp (dbus_message_get_signature (reply), "au") != 0)
   {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "unexpected signature %s while getting active state", dbus_message_get_signature(reply));
-    goto out;
+    return NULL;
   }
   dbus_message_iter_init (reply, &iter);
   dbus_message_iter_recurse (&iter, &iter_array);
@@ -605,12 +770,27 @@ static dbus_uint32_t *getState(const char *sender, const char *path)
   {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "unexpected signature %s while getting active state", dbus_message_get_signature(reply));
-    goto out;
+    return NULL;
   }
   ret = malloc(sizeof(*ret) * count);
   memcpy(ret, states, sizeof(*ret) * count);
+  return ret;
+}
 
-out:
+/* Get the state of an object */
+static dbus_uint32_t *getState(const char *sender, const char *path)
+{
+  DBusMessage *msg, *reply;
+  dbus_uint32_t *ret;
+
+  msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetState");
+  if (!msg)
+    return NULL;
+  reply = send_with_reply_and_block(bus, msg, 1000, "getting state");
+  if (!reply)
+    return NULL;
+
+  ret = getStateFromReply(reply);
   dbus_message_unref(reply);
   return ret;
 }
@@ -692,110 +872,394 @@ static int reinitTerm(const char *sender, const char *path) {
 
 /* Try to find an active object among children of the given object */
 
-/* We need to take care of bogus applications which have children loops, so we
- * need to compare newly found children with the list of ancestors */
-struct pathList {
-  const char *sender;
-  const char *path;
-  struct pathList *prev;
-  int loop;
+/* The desktop is walked asynchronously: the GetState and GetChildren calls for
+ * many objects are kept outstanding at once, and their replies are handled as
+ * they come in through the D-Bus watches. The children of each object are
+ * cached (until a ChildrenChanged event says otherwise) so that walking the
+ * desktop again only needs to query the states. */
+
+#define DISCOVERY_REQUEST_LIMIT 0X20
+#define OBJECT_CACHE_LIMIT 0X4000
+#define OBJECT_HASH_SIZE 0X100
+
+typedef struct ObjectEntryStruct ObjectEntry;
+
+struct objectChild {
+  char *sender;
+  char *path;
 };
-static int findTerm(const char *sender, const char *path, int active, int depth, struct pathList *list);
-static int recurseFindTerm(const char *sender, const char *path, int active, int depth, struct pathList *list) {
-  DBusMessage *msg, *reply;
-  DBusMessageIter iter, iter_array, iter_struct;
-  int res = 0;
 
-  msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetChildren");
-  if (!msg)
-    return 0;
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting active object");
-  if (!reply)
-    return 0;
+struct ObjectEntryStruct {
+  ObjectEntry *next;
+  char *sender;
+  char *path;
+
+  /* the discovery walk which last reached this object */
+  unsigned int walk;
+  int active;
+
+  int haveChildren;
+  unsigned int childCount;
+  struct objectChild *children;
+};
+
+typedef enum {
+  DISCOVER_STATE,
+  DISCOVER_CHILDREN
+} DiscoveryStep;
+
+struct discoveryRequest {
+  struct discoveryRequest *next;
+  struct discoveryRequest *prev;
+  ObjectEntry *object;
+  DiscoveryStep step;
+  DBusPendingCall *pending;
+};
+
+static struct {
+  ObjectEntry *objects[OBJECT_HASH_SIZE];
+  unsigned int objectCount;
+
+  unsigned int walk;
+  int searching;
+  unsigned int examined;
+
+  struct discoveryRequest *waiting, *waitingTail;
+  struct discoveryRequest *outstanding;
+  unsigned int outstandingCount;
+} discovery;
+
+static unsigned int hashObject(const char *sender, const char *path) {
+  unsigned int hash = 0;
+  while (*sender)
+    hash = hash*31 + (unsigned char)*sender++;
+  while (*path)
+    hash = hash*31 + (unsigned char)*path++;
+  return hash % OBJECT_HASH_SIZE;
+}
+
+static void forgetObjectChildren(ObjectEntry *object) {
+  unsigned int i;
+  for (i=0; i<object->childCount; i++) {
+    free(object->children[i].sender);
+    free(object->children[i].path);
+  }
+  free(object->children);
+  object->children = NULL;
+  object->childCount = 0;
+  object->haveChildren = 0;
+}
+
+static ObjectEntry *findObject(const char *sender, const char *path) {
+  ObjectEntry *object;
+  for (object = discovery.objects[hashObject(sender, path)]; object; object = object->next)
+    if (!strcmp(object->path, path) && !strcmp(object->sender, sender))
+      return object;
+  return NULL;
+}
+
+static ObjectEntry *getObject(const char *sender, const char *path) {
+  ObjectEntry *object = findObject(sender, path);
+  unsigned int hash;
+
+  if (object)
+    return object;
+
+  if (!(object = calloc(1, sizeof(*object)))) {
+    logMallocError();
+    return NULL;
+  }
+  if (!(object->sender = strdup(sender)) || !(object->path = strdup(path))) {
+    logMallocError();
+    free(object->sender);
+    free(object);
+    return NULL;
+  }
+
+  hash = hashObject(sender, path);
+  object->next = discovery.objects[hash];
+  discovery.objects[hash] = object;
+  discovery.objectCount++;
+  return object;
+}
+
+static void clearObjects(void) {
+  unsigned int hash;
+  for (hash=0; hash<OBJECT_HASH_SIZE; hash++) {
+    ObjectEntry *object;
+    while ((object = discovery.objects[hash])) {
+      discovery.objects[hash] = object->next;
+      forgetObjectChildren(object);
+      free(object->sender);
+      free(object->path);
+      free(object);
+    }
+  }
+  discovery.objectCount = 0;
+}
+
+/* A ChildrenChanged event invalidates what we know of the object's children */
+static void childrenChanged(const char *sender, const char *path) {
+  ObjectEntry *object = findObject(sender, path);
+  if (object && object->haveChildren) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "children of %s %s changed", sender, path);
+    forgetObjectChildren(object);
+  }
+}
+
+static void stopDiscovery(void) {
+  struct discoveryRequest *request;
+
+  while ((request = discovery.outstanding)) {
+    discovery.outstanding = request->next;
+    dbus_pending_call_cancel(request->pending);
+    dbus_pending_call_unref(request->pending);
+    free(request);
+  }
+  discovery.outstandingCount = 0;
+
+  while ((request = discovery.waiting)) {
+    discovery.waiting = request->next;
+    free(request);
+  }
+  discovery.waitingTail = NULL;
+
+  discovery.searching = 0;
+}
+
+static void addDiscoveryRequest(ObjectEntry *object, DiscoveryStep step) {
+  struct discoveryRequest *request = malloc(sizeof(*request));
+
+  if (!request) {
+    logMallocError();
+    return;
+  }
+  request->object = object;
+  request->step = step;
+  request->pending = NULL;
+  request->next = NULL;
+  request->prev = discovery.waitingTail;
+  if (discovery.waitingTail)
+    discovery.waitingTail->next = request;
+  else
+    discovery.waiting = request;
+  discovery.waitingTail = request;
+}
+
+/* Queue looking at an object, unless this walk already reached it (which also
+ * takes care of bogus applications which have children loops) */
+static void discoverObject(const char *sender, const char *path, int active) {
+  ObjectEntry *object = getObject(sender, path);
+
+  if (!object || object->walk == discovery.walk)
+    return;
+  object->walk = discovery.walk;
+  object->active = active;
+  addDiscoveryRequest(object, DISCOVER_STATE);
+}
+
+static void discoverChildren(const ObjectEntry *object) {
+  unsigned int i;
+  for (i=0; i<object->childCount; i++)
+    discoverObject(object->children[i].sender, object->children[i].path, object->active);
+}
+
+static void handleStateReply(ObjectEntry *object, DBusMessage *reply) {
+  dbus_uint32_t *states = getStateFromReply(reply);
+
+  if (!states)
+    return;
+
+  discovery.examined++;
+
+  if (states[0] & (1<<ATSPI_STATE_ACTIVE))
+    /* This application is active */
+    object->active = 1;
+
+  if (states[0] & (1<<ATSPI_STATE_FOCUSED) && object->active)
+  {
+    /* And this widget is focused */
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "%s %s is focused!", object->sender, object->path);
+    free(states);
+    stopDiscovery();
+    tryRestartTerm(object->sender, object->path);
+    updated = 1;
+    return;
+  }
+
+  free(states);
+  addDiscoveryRequest(object, DISCOVER_CHILDREN);
+}
+
+static void handleChildrenReply(ObjectEntry *object, DBusMessage *reply) {
+  DBusMessageIter iter, iter_array, iter_struct;
+  unsigned int count = 0;
 
   if (strcmp (dbus_message_get_signature (reply), "a(so)") != 0)
   {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "unexpected signature %s while getting active object", dbus_message_get_signature(reply));
-    goto out;
+    return;
+  }
+
+  forgetObjectChildren(object);
+
+  dbus_message_iter_init(reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+  {
+    count++;
+    dbus_message_iter_next (&iter_array);
   }
+
+  if (count && !(object->children = calloc(count, sizeof(*object->children)))) {
+    logMallocError();
+    return;
+  }
+
   dbus_message_iter_init(reply, &iter);
   dbus_message_iter_recurse (&iter, &iter_array);
   while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
   {
     const char *childsender, *childpath;
-    struct pathList *cur;
+    struct objectChild *child = &object->children[object->childCount];
 
     dbus_message_iter_recurse (&iter_array, &iter_struct);
     dbus_message_iter_get_basic (&iter_struct, &childsender);
     dbus_message_iter_next (&iter_struct);
     dbus_message_iter_get_basic (&iter_struct, &childpath);
 
-    /* Make sure that the child is not the same as an ancestor, to avoid
-     * recursing indefinitely.  */
-    for (cur = list; cur; cur = cur->prev)
-      if (!strcmp(childsender, cur->sender) && !strcmp(childpath, cur->path))
-      {
-	/* Loop detected, avoid continuing looking at this part of the tree
-	which is not actually a tree! */
-	cur->loop = 1;
-	break;
-      }
-    if (! cur)
-    {
-      struct pathList me = {
-	.sender = sender,
-	.path = path,
-	.prev = list,
-      };
-      if (findTerm(childsender, childpath, active, depth, &me))
-      {
-	res = 1;
-	goto out;
-      }
-      if (me.loop) {
-        /* There is a loop up to us.  Avoid continuing looking here which may
-         * entail an exponential number of lookups. */
-	break;
-      }
+    if (!(child->sender = strdup(childsender)) || !(child->path = strdup(childpath))) {
+      logMallocError();
+      free(child->sender);
+      forgetObjectChildren(object);
+      return;
     }
+    object->childCount++;
 
     dbus_message_iter_next (&iter_array);
   }
 
-out:
-  dbus_message_unref(reply);
-  return res;
+  object->haveChildren = 1;
+  discoverChildren(object);
 }
 
-/* Test whether this object is active, and if not recurse in its children */
-static int findTerm(const char *sender, const char *path, int active, int depth, struct pathList *list) {
-  dbus_uint32_t *states = getState(sender, path);
+static void handleDiscoveryReply(DBusPendingCall *pending, void *data);
 
-  if (!states)
-    return 0;
+static void sendDiscoveryRequests(void) {
+  struct discoveryRequest *request;
 
-  if (states[0] & (1<<ATSPI_STATE_ACTIVE))
-    /* This application is active */
-    active = 1;
+  while (discovery.outstandingCount < DISCOVERY_REQUEST_LIMIT && (request = discovery.waiting)) {
+    ObjectEntry *object = request->object;
+    DBusMessage *msg;
 
-  if (states[0] & (1<<ATSPI_STATE_FOCUSED) && active)
-  {
-    /* And this widget is focused */
+    if (!(discovery.waiting = request->next))
+      discovery.waitingTail = NULL;
+    else
+      discovery.waiting->prev = NULL;
+
+    if (request->step == DISCOVER_CHILDREN && object->haveChildren) {
+      /* already known, no need to ask */
+      discoverChildren(object);
+      free(request);
+      continue;
+    }
+
+    msg = new_method_call(object->sender, object->path, SPI2_DBUS_INTERFACE_ACCESSIBLE,
+                          request->step == DISCOVER_STATE? "GetState": "GetChildren");
+    if (!msg) {
+      free(request);
+      continue;
+    }
+    if (!dbus_connection_send_with_reply(bus, msg, &request->pending, 1000) || !request->pending) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "can't send request while getting active object");
+      dbus_message_unref(msg);
+      free(request);
+      continue;
+    }
+    dbus_message_unref(msg);
+
+    if (!dbus_pending_call_set_notify(request->pending, handleDiscoveryReply, request, NULL)) {
+      logMallocError();
+      dbus_pending_call_cancel(request->pending);
+      dbus_pending_call_unref(request->pending);
+      free(request);
+      continue;
+    }
+
+    request->prev = NULL;
+    if ((request->next = discovery.outstanding))
+      request->next->prev = request;
+    discovery.outstanding = request;
+    discovery.outstandingCount++;
+  }
+
+  if (discovery.searching && !discovery.outstandingCount && !discovery.waiting) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
-               "%s %s is focused!", sender, path);
-    free(states);
-    tryRestartTerm(sender, path);
-    return 1;
+               "no focused object among %u examined", discovery.examined);
+    discovery.searching = 0;
   }
+}
 
-  free(states);
-  return recurseFindTerm(sender, path, active, depth+1, list);
+static void handleDiscoveryReply(DBusPendingCall *pending, void *data) {
+  struct discoveryRequest *request = data;
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+  if (request->prev)
+    request->prev->next = request->next;
+  else
+    discovery.outstanding = request->next;
+  if (request->next)
+    request->next->prev = request->prev;
+  discovery.outstandingCount--;
+  dbus_pending_call_unref(pending);
+
+  if (!reply) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "no reply while getting active object");
+  } else {
+    if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "error while getting active object");
+    } else if (request->step == DISCOVER_STATE) {
+      handleStateReply(request->object, reply);
+    } else {
+      handleChildrenReply(request->object, reply);
+    }
+    dbus_message_unref(reply);
+  }
+
+  free(request);
+  if (discovery.searching)
+    sendDiscoveryRequests();
 }
 
 /* Find out currently focused terminal, starting from registry */
 static void initTerm(void) {
-  recurseFindTerm(SPI2_DBUS_INTERFACE_REG, SPI2_DBUS_PATH_ROOT, 0, 0, NULL);
+  ObjectEntry *root;
+
+  stopDiscovery();
+  if (discovery.objectCount > OBJECT_CACHE_LIMIT)
+    clearObjects();
+
+  if (!(root = getObject(SPI2_DBUS_INTERFACE_REG, SPI2_DBUS_PATH_ROOT)))
+    return;
+
+  discovery.walk++;
+  discovery.searching = 1;
+  discovery.examined = 0;
+  root->walk = discovery.walk;
+  root->active = 0;
+
+  /* The registry's ChildrenChanged events come from its unique bus name
+   * rather than from the well-known one it's known by here, so its children
+   * (the applications) can't be kept. */
+  forgetObjectChildren(root);
+  addDiscoveryRequest(root, DISCOVER_CHILDREN);
+  sendDiscoveryRequests();
 }
 
 /* Handle incoming events */
@@ -853,10 +1317,18 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     && !strcmp(detail, "focused");
 
   if (StateChanged_focused && !detail1) {
-    if (curSender && !strcmp(sender, curSender) && !strcmp(path, curPath))
+    if (curSender && !strcmp(sender, curSender) && !strcmp(path, curPath)) {
       finiTerm();
+      /* Look for where the focus went, in case no focus event says so.
+       * The cached children make this walk only query the states. */
+      initTerm();
+    }
   } else if (!strcmp(interface,"Focus") || (StateChanged_focused && detail1)) {
+    stopDiscovery();
     tryRestartTerm(sender, path);
+  } else if (!strcmp(interface, "Object") && !strcmp(member, "ChildrenChanged")) {
+    childrenChanged(sender, path);
+    return;
   } else if (!strcmp(interface, "Object") && !strcmp(member, "TextCaretMoved")) {
     if (!curSender || strcmp(sender, curSender) || strcmp(path, curPath)) return;
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
@@ -881,11 +1353,11 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
                "'%s'",deleted);
     downTo = y;
     if (downTo < curNumRows)
-      length = curRowLengths[downTo];
+      length = getRow(downTo)->length;
     while (x+toDelete >= length) {
       downTo++;
       if (downTo <= curNumRows - 1)
-	length += curRowLengths[downTo];
+	length += getRow(downTo)->length;
       else {
 	/* imaginary extra line doesn't provide more length, and shouldn't need to ! */
 	if (x+toDelete > length) {
@@ -898,15 +1370,18 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     }
     if (length-toDelete>0) {
       /* still something on line y */
+      RowEntry *row = getRow(y);
       if (y!=downTo) {
-	curRowLengths[y] = length-toDelete;
-	curRows[y]=realloc(curRows[y],curRowLengths[y]*sizeof(*curRows[y]));
+	setRowLength(y, length-toDelete);
+	row->text=realloc(row->text,row->length*sizeof(*row->text));
+      }
+      if ((toCopy = length-toDelete-x)) {
+	RowEntry *from = getRow(downTo);
+	memmove(row->text+x,from->text+from->length-toCopy,toCopy*sizeof(*from->text));
       }
-      if ((toCopy = length-toDelete-x))
-	memmove(curRows[y]+x,curRows[downTo]+curRowLengths[downTo]-toCopy,toCopy*sizeof(*curRows[downTo]));
       if (y==downTo) {
-	curRowLengths[y] = length-toDelete;
-	curRows[y]=realloc(curRows[y],curRowLengths[y]*sizeof(*curRows[y]));
+	setRowLength(y, length-toDelete);
+	row->text=realloc(row->text,row->length*sizeof(*row->text));
       }
     } else {
       /* kills this line as well ! */
@@ -919,6 +1394,7 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     caretPosition(curCaret);
   } else if (!strcmp(interface, "Object") && !strcmp(member, "TextChanged") && !strcmp(detail, "insert")) {
     long len=detail2,semilen,x,y;
+    RowEntry *row, *next;
     const char *added;
     const char *adding,*c;
     if (!curSender || strcmp(sender, curSender) || strcmp(path, curPath)) return;
@@ -937,33 +1413,36 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     if (x && (c = strchr(adding,'\n'))) {
       /* splitting line */
       addRows(y,1);
+      row=getRow(y);
+      next=getRow(y+1);
       semilen=my_mbslen(adding,c+1-adding);
-      curRowLengths[y]=x+semilen;
+      setRowLength(y,x+semilen);
       if (x+semilen-1>curNumCols)
 	curNumCols=x+semilen-1;
 
       /* copy beginning */
-      curRows[y]=malloc(curRowLengths[y]*sizeof(*curRows[y]));
-      memcpy(curRows[y],curRows[y+1],x*sizeof(*curRows[y]));
+      row->text=malloc(row->length*sizeof(*row->text));
+      memcpy(row->text,next->text,x*sizeof(*row->text));
       /* add */
-      my_mbsrtowcs(curRows[y]+x,&adding,semilen,NULL);
+      my_mbsrtowcs(row->text+x,&adding,semilen,NULL);
       len-=semilen;
       adding=c+1;
       /* shift end */
-      curRowLengths[y+1]-=x;
-      memmove(curRows[y+1],curRows[y+1]+x,curRowLengths[y+1]*sizeof(*curRows[y+1]));
+      setRowLength(y+1,next->length-x);
+      memmove(next->text,next->text+x,next->length*sizeof(*next->text));
       x=0;
       y++;
     }
     while ((c = strchr(adding,'\n'))) {
       /* adding lines */
       addRows(y,1);
+      row=getRow(y);
       semilen=my_mbslen(adding,c+1-adding);
-      curRowLengths[y]=semilen;
+      setRowLength(y,semilen);
       if (semilen-1>curNumCols)
 	curNumCols=semilen-1;
-      curRows[y]=malloc(semilen*sizeof(*curRows[y]));
-      my_mbsrtowcs(curRows[y],&adding,semilen,NULL);
+      row->text=malloc(semilen*sizeof(*row->text));
+      my_mbsrtowcs(row->text,&adding,semilen,NULL);
       len-=semilen;
       adding=c+1;
       y++;
@@ -971,17 +1450,16 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     if (len) {
       /* still length to add on the line following it */
       if (y==curNumRows) {
-	/* It won't insert ending \n yet */
+	/* It won't insert ending \n yet (new rows start out empty) */
 	addRows(y,1);
-	curRows[y]=NULL;
-	curRowLengths[y]=0;
       }
-      curRowLengths[y] += len;
-      curRows[y]=realloc(curRows[y],curRowLengths[y]*sizeof(*curRows[y]));
-      memmove(curRows[y]+x+len,curRows[y]+x,(curRowLengths[y]-(x+len))*sizeof(*curRows[y]));
-      my_mbsrtowcs(curRows[y]+x,&adding,len,NULL);
-      if (curRowLengths[y]-(curRows[y][curRowLengths[y]-1]=='\n')>curNumCols)
-	curNumCols=curRowLengths[y]-(curRows[y][curRowLengths[y]-1]=='\n');
+      row=getRow(y);
+      setRowLength(y,row->length+len);
+      row->text=realloc(row->text,row->length*sizeof(*row->text));
+      memmove(row->text+x+len,row->text+x,(row->length-(x+len))*sizeof(*row->text));
+      my_mbsrtowcs(row->text+x,&adding,len,NULL);
+      if (row->length-(row->text[row->length-1]=='\n')>curNumCols)
+	curNumCols=row->length-(row->text[row->length-1]=='\n');
     }
     caretPosition(curCaret);
   } else {
@@ -1290,6 +1768,8 @@ noBus:
 
 static void
 destruct_AtSpi2Screen (void) {
+  stopDiscovery();
+  clearObjects();
   dbus_connection_remove_filter(bus, AtSpi2Filter, NULL);
   dbus_connection_close(bus);
   dbus_connection_unref(bus);
@@ -1354,10 +1834,12 @@ readCharacters_AtSpi2Screen (const ScreenBox *box, ScreenCharacter *buffer) {
   if (!validateScreenBox(box, cols, curNumRows)) return 0;
 
   for (unsigned int y=0; y<box->height; y+=1) {
-    if (curRowLengths[box->top+y]) {
+    const RowEntry *row = getRow(box->top+y);
+
+    if (row->length) {
       for (unsigned int x=0; x<box->width; x+=1) {
-        if (box->left+x < curRowLengths[box->top+y] - (curRows[box->top+y][curRowLengths[box->top+y]-1]=='\n')) {
-          buffer[y*box->width+x].text = curRows[box->top+y][box->left+x];
+        if (box->left+x < row->length - (row->text[row->length-1]=='\n')) {
+          buffer[y*box->width+x].text = row->text[box->left+x];
         }
       }
     }
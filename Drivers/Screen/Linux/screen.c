@@ -551,6 +551,10 @@ static unsigned char *unicodeCacheBuffer;
 static size_t unicodeCacheSize;
 static size_t unicodeCacheUsed;
 
+static unsigned char *previousUnicodeBuffer;
+static size_t previousUnicodeSize;
+static size_t previousUnicodeUsed;
+
 static size_t
 readUnicodeCache (off_t offset, void *buffer, size_t size) {
   if (offset <= unicodeCacheSize) {
@@ -618,6 +622,8 @@ static int isMonitorable;
 static THREAD_LOCAL AsyncHandle screenMonitor = NULL;
 
 static int screenUpdated;
+static int screenDamageKnown;
+static ScreenDamage screenDamage;
 
 static int currentConsoleNumber;
 static int inTextMode;
@@ -720,6 +726,7 @@ setCurrentScreen (unsigned char vt) {
 
   screenMonitor = NULL;
   screenUpdated = 1;
+  screenDamageKnown = 0;
   return 1;
 }
 
@@ -735,6 +742,9 @@ readScreenDevice (off_t offset, void *buffer, size_t size) {
 static unsigned char *screenCacheBuffer;
 static size_t screenCacheSize;
 
+static unsigned char *previousScreenBuffer;
+static size_t previousScreenSize;
+
 static size_t
 readScreenCache (off_t offset, void *buffer, size_t size) {
   if (offset <= screenCacheSize) {
@@ -1024,6 +1034,50 @@ determineAttributesMasks (void) {
 
 static wchar_t translationTable[0X200];
 
+static wint_t decodeTable[ARRAY_COUNT(translationTable)];
+static int decodeTableCharset = -1;
+
+static void
+setDecodeTable (void) {
+  CharsetEntry *charset = getCharsetEntry();
+  unsigned int isMultiByte = charset->isMultiByte;
+  unsigned int index = charsetIndex;
+
+  for (unsigned int position=0; position<ARRAY_COUNT(decodeTable); position+=1) {
+    const wchar_t *character = &translationTable[position];
+    wint_t *decoded = &decodeTable[position];
+
+    if ((*character & ~0XFF) != UNICODE_ROW_DIRECT) {
+      *decoded = *character;
+    } else {
+      char byte = *character & 0XFF;
+      wchar_t wc = 0;
+
+      /* only bytes which the current charset maps to a character by
+       * themselves can be decoded without the stateful conversion
+       */
+      if (convertCharsToWchar(&byte, 1, &wc, NULL) != CONV_OK) {
+        *decoded = WEOF;
+      } else if (charsetIndex != index) {
+        *decoded = WEOF;
+      } else {
+        *decoded = wc;
+      }
+
+      charsetIndex = index;
+    }
+  }
+
+  charset->isMultiByte = isMultiByte;
+  decodeTableCharset = index;
+}
+
+static inline wint_t
+decodeCharacter (uint16_t position) {
+  if (decodeTableCharset != charsetIndex) setDecodeTable();
+  return decodeTable[position];
+}
+
 static int
 setTranslationTable (int force) {
   int mappingChanged = 0;
@@ -1060,10 +1114,28 @@ setTranslationTable (int force) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER), "character mapping changed");
   }
 
+  if (mappingChanged || force) {
+    decodeTableCharset = -1;
+    screenDamageKnown = 0;
+  }
+
   restartTimePeriod(&mappingRecalculationTimer);
   return mappingChanged;
 }
 
+static inline uint16_t
+getVgaPosition (uint16_t vga) {
+  uint16_t position = vga & 0XFF;
+  if (vga & fontAttributesMask) position |= 0X100;
+  return position;
+}
+
+static inline unsigned char
+getVgaAttributes (uint16_t vga) {
+  return ((vga & unshiftedAttributesMask) |
+          ((vga & shiftedAttributesMask) >> 1)) >> 8;
+}
+
 static int
 readScreenRow (int row, size_t size, ScreenCharacter *characters, int *offsets) {
   uint16_t vgaBuffer[size];
@@ -1076,6 +1148,7 @@ readScreenRow (int row, size_t size, ScreenCharacter *characters, int *offsets)
     const uint16_t *end = vga + size;
     const uint32_t *text = NULL;
     ScreenCharacter *character = characters;
+    int stateful = 0;
 
     if (directUnicode) {
       if (unicodeCacheUsed) {
@@ -1087,16 +1160,22 @@ readScreenRow (int row, size_t size, ScreenCharacter *characters, int *offsets)
 
     while (vga != end) {
       if (character) {
-        character->attributes = ((*vga & unshiftedAttributesMask) |
-                                 ((*vga & shiftedAttributesMask) >> 1)) >> 8;
+        character->attributes = getVgaAttributes(*vga);
 
         if (text) {
           character->text = *text++;
         } else {
-          uint16_t position = *vga & 0XFF;
-          if (*vga & fontAttributesMask) position |= 0X100;
+          uint16_t position = getVgaPosition(*vga);
+          wint_t wc;
+
+          /* once a byte has been left to the converter, its state must be
+           * honoured for the rest of the row
+           */
+          if (stateful || ((wc = decodeCharacter(position)) == WEOF)) {
+            wc = convertCharacter(&translationTable[position]);
+            stateful = 1;
+          }
 
-          wint_t wc = convertCharacter(&translationTable[position]);
           character->text = (wc != WEOF)? wc: WC_C(' ');
         }
 
@@ -1127,6 +1206,62 @@ readScreenRow (int row, size_t size, ScreenCharacter *characters, int *offsets)
   return 0;
 }
 
+static int
+readScreenBoxRow (int row, size_t size, unsigned int left, unsigned int width, ScreenCharacter *characters) {
+  unsigned int right = left + width;
+  uint16_t vgaBuffer[right];
+  off_t offset = row * size;
+
+  if (readScreenContent(offset, vgaBuffer, right)) {
+    const uint16_t *vga = &vgaBuffer[left];
+    const uint16_t *end = &vgaBuffer[right];
+    ScreenCharacter *character = characters;
+
+    if (directUnicode && unicodeCacheUsed) {
+      uint32_t textBuffer[width];
+
+      if (readUnicodeContent(offset+left, textBuffer, width)) {
+        const uint32_t *text = textBuffer;
+
+        while (vga != end) {
+          character->attributes = getVgaAttributes(*vga);
+          character->text = *text++;
+
+          character += 1;
+          vga += 1;
+        }
+
+        return 1;
+      }
+    }
+
+    /* a cell to the left of the box can still affect how the cells within
+     * it are decoded if the charset converter has to see it
+     */
+    for (unsigned int column=0; column<right; column+=1) {
+      if (decodeCharacter(getVgaPosition(vgaBuffer[column])) == WEOF) {
+        ScreenCharacter rowCharacters[size];
+        if (!readScreenRow(row, size, rowCharacters, NULL)) return 0;
+
+        memcpy(characters, &rowCharacters[left], (width * sizeof(*characters)));
+        return 1;
+      }
+    }
+
+    while (vga != end) {
+      character->attributes = getVgaAttributes(*vga);
+      character->text = decodeCharacter(getVgaPosition(*vga));
+
+      character += 1;
+      vga += 1;
+    }
+
+    return 1;
+  }
+
+  return 0;
+}
+
 static void
 adjustCursorColumn (short *column, short row, short columns) {
   const CharsetEntry *charset = getCharsetEntry();
@@ -1349,6 +1484,12 @@ destruct_LinuxScreen (void) {
   }
   screenCacheSize = 0;
 
+  if (previousScreenBuffer) {
+    free(previousScreenBuffer);
+    previousScreenBuffer = NULL;
+  }
+  previousScreenSize = 0;
+
   if (unicodeCacheBuffer) {
     free(unicodeCacheBuffer);
     unicodeCacheBuffer = NULL;
@@ -1356,6 +1497,15 @@ destruct_LinuxScreen (void) {
   unicodeCacheSize = 0;
   unicodeCacheUsed = 0;
 
+  if (previousUnicodeBuffer) {
+    free(previousUnicodeBuffer);
+    previousUnicodeBuffer = NULL;
+  }
+  previousUnicodeSize = 0;
+  previousUnicodeUsed = 0;
+
+  screenDamageKnown = 0;
+
   closeMainConsole();
 }
 
@@ -1487,11 +1637,92 @@ testTextMode (void) {
   return 0;
 }
 
+static void
+swapCacheBuffers (
+  unsigned char **buffer1, size_t *size1,
+  unsigned char **buffer2, size_t *size2
+) {
+  unsigned char *buffer = *buffer1;
+  size_t size = *size1;
+
+  *buffer1 = *buffer2;
+  *size1 = *size2;
+
+  *buffer2 = buffer;
+  *size2 = size;
+}
+
+static void
+addContentDamage (
+  const unsigned char *from, const unsigned char *to, size_t size,
+  unsigned int columns, unsigned int rows
+) {
+  const CharsetEntry *charset = getCharsetEntry();
+  const size_t rowSize = columns * size;
+
+  for (unsigned int row=0; row<rows; row+=1) {
+    if (memcmp(from, to, rowSize) != 0) {
+      int left = 0;
+      int right = columns - 1;
+
+      /* multibyte characters don't map one-to-one onto screen columns */
+      if (!charset->isMultiByte) {
+        while (memcmp(&from[left * size], &to[left * size], size) == 0) left += 1;
+        while (memcmp(&from[right * size], &to[right * size], size) == 0) right -= 1;
+      }
+
+      addScreenDamage(&screenDamage, left, right, row, row);
+    }
+
+    from += rowSize;
+    to += rowSize;
+  }
+}
+
+static void
+updateScreenDamage (void) {
+  if (screenDamageKnown) {
+    const ScreenHeader *oldHeader = (void *)previousScreenBuffer;
+    const ScreenHeader *newHeader = (void *)screenCacheBuffer;
+
+    if (!oldHeader ||
+        (oldHeader->size.columns != newHeader->size.columns) ||
+        (oldHeader->size.rows != newHeader->size.rows)) {
+      screenDamageKnown = 0;
+    } else {
+      const unsigned int columns = newHeader->size.columns;
+      const unsigned int rows = newHeader->size.rows;
+
+      addContentDamage((const void *)(oldHeader + 1),
+                       (const void *)(newHeader + 1),
+                       2, columns, rows);
+
+      if (unicodeCacheUsed || previousUnicodeUsed) {
+        if (unicodeCacheUsed != previousUnicodeUsed) {
+          screenDamageKnown = 0;
+        } else if (unicodeCacheUsed >= (columns * rows * 4)) {
+          addContentDamage(previousUnicodeBuffer, unicodeCacheBuffer,
+                           4, columns, rows);
+        }
+      }
+    }
+  }
+}
+
 static int
 refreshCache (void) {
+  swapCacheBuffers(&screenCacheBuffer, &screenCacheSize,
+                   &previousScreenBuffer, &previousScreenSize);
+
+  swapCacheBuffers(&unicodeCacheBuffer, &unicodeCacheSize,
+                   &previousUnicodeBuffer, &previousUnicodeSize);
+  previousUnicodeUsed = unicodeCacheUsed;
+
   size_t size = refreshScreenBuffer(&screenCacheBuffer, &screenCacheSize);
   if (!size) return 0;
   if (!refreshUnicodeCache(size)) return 0;
+
+  updateScreenDamage();
   return 1;
 }
 
@@ -1503,6 +1734,7 @@ refresh_LinuxScreen (void) {
 
       if (!refreshCache()) {
         problemText = "can't read screen content";
+        screenDamageKnown = 0;
         return 0;
       }
 
@@ -1515,10 +1747,11 @@ refresh_LinuxScreen (void) {
                    currentConsoleNumber, consoleNumber);
 
         currentConsoleNumber = consoleNumber;
+        screenDamageKnown = 0;
       }
     }
 
-    inTextMode = testTextMode();
+    if (!(inTextMode = testTextMode())) screenDamageKnown = 0;
     screenUpdated = 0;
   }
 
@@ -1568,6 +1801,17 @@ describe_LinuxScreen (ScreenDescription *description) {
   }
 }
 
+static int
+getDamage_LinuxScreen (ScreenDamage *damage) {
+  int known = screenDamageKnown;
+
+  *damage = screenDamage;
+  clearScreenDamage(&screenDamage);
+  screenDamageKnown = 1;
+
+  return known;
+}
+
 static int
 readCharacters_LinuxScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   ScreenSize size;
@@ -1580,11 +1824,7 @@ readCharacters_LinuxScreen (const ScreenBox *box, ScreenCharacter *buffer) {
       }
 
       for (unsigned int row=0; row<box->height; row+=1) {
-        ScreenCharacter characters[size.columns];
-        if (!readScreenRow(box->top+row, size.columns, characters, NULL)) return 0;
-
-        memcpy(buffer, &characters[box->left],
-               box->width * sizeof(characters[0]));
+        if (!readScreenBoxRow(box->top+row, size.columns, box->left, box->width, buffer)) return 0;
         buffer += box->width;
       }
 
@@ -2355,6 +2595,7 @@ scr_initialize (MainScreen *main) {
   main->base.poll = poll_LinuxScreen;
   main->base.refresh = refresh_LinuxScreen;
   main->base.describe = describe_LinuxScreen;
+  main->base.getDamage = getDamage_LinuxScreen;
   main->base.readCharacters = readCharacters_LinuxScreen;
   main->base.insertKey = insertKey_LinuxScreen;
   main->base.highlightRegion = highlightRegion_LinuxScreen;
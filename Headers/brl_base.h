@@ -115,6 +115,41 @@ extern size_t readBraillePacket (
   BraillePacketVerifier *verifyPacket, void *data
 );
 
+typedef struct {
+  size_t length; /* the packet length less what its length field says */
+  unsigned char lengthOffset; /* where its length field starts */
+  unsigned char lengthSize; /* how many bytes its length field has (0 if none) */
+  unsigned char lengthIsBigEndian:1; /* the most significant length byte is first */
+  size_t maximumLength; /* checked as soon as the length field is in (0 if none) */
+} BraillePacketLayout;
+
+typedef struct {
+  const unsigned char *header; /* the bytes which every packet starts with */
+  unsigned char headerLength;
+
+  unsigned char hasTerminator:1;
+  unsigned char terminator; /* the last byte of every packet */
+
+  /* When there's a table of packet types, it's indexed by the byte at
+   * typeOffset and gives the layout of each type of packet. A type whose
+   * layout has neither a length nor a length field isn't valid. Otherwise,
+   * every packet has the same layout.
+   */
+  BraillePacketLayout layout;
+  const BraillePacketLayout *types;
+  unsigned short typeCount;
+  unsigned char typeOffset;
+
+  BraillePacketVerifier *verifyPacket; /* optional check of a whole packet */
+} BraillePacketFormat;
+
+extern size_t readFormattedBraillePacket (
+  BrailleDisplay *brl,
+  GioEndpoint *endpoint,
+  void *packet, size_t size,
+  const BraillePacketFormat *format, void *data
+);
+
 extern int writeBraillePacket (
   BrailleDisplay *brl, GioEndpoint *endpoint,
   const void *packet, size_t size
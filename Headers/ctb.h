@@ -39,6 +39,37 @@ extern void contractText (
   int cursorOffset /* Position of coursor in source */
 );
 
+/* A context holds everything which changes while translating so that several
+ * threads, each with its own context, can share one compiled table.
+ * contractText() uses the table's own context.
+ */
+typedef struct ContractionContextStruct ContractionContext;
+
+extern ContractionContext *newContractionContext (ContractionTable *table);
+extern void destroyContractionContext (ContractionContext *context);
+extern void contractTextInContext (
+  ContractionContext *context,
+  const wchar_t *inputBuffer, int *inputLength,
+  unsigned char *outputBuffer, int *outputLength,
+  int *offsetsMap, int cursorOffset
+);
+
+/* Lets a table which translates out of process start on text which is
+ * likely to be asked for soon. Tables which don't need it ignore it, and
+ * say so via canPrefetchContractedText() so that the text needn't be read.
+ */
+extern int canPrefetchContractedText (ContractionTable *contractionTable);
+extern void prefetchContractedText (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int inputLength,
+  int outputLength, int cursorOffset
+);
+
+/* How many lines, and how many bytes, each contraction table may keep
+ * translated. No lines are kept if either limit is 0.
+ */
+extern void setContractionCacheLimits (unsigned int entries, size_t size);
+
 extern char *ensureContractionTableExtension (const char *path);
 extern char *makeContractionTablePath (const char *directory, const char *name);
 
@@ -43,6 +43,8 @@ extern ssize_t gioWriteData (GioEndpoint *endpoint, const void *data, size_t siz
 extern int gioAwaitInput (GioEndpoint *endpoint, int timeout);
 extern ssize_t gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait);
 extern int gioReadByte (GioEndpoint *endpoint, unsigned char *byte, int wait);
+extern size_t gioPeekInput (GioEndpoint *endpoint, const unsigned char **bytes, int wait);
+extern void gioConsumeInput (GioEndpoint *endpoint, size_t count);
 extern int gioDiscardInput (GioEndpoint *endpoint);
 
 extern int gioReconfigureResource (
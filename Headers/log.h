@@ -68,6 +68,7 @@ typedef enum {
   LOG_CATEGORY_INDEX(CURSOR_ROUTING),
 
   LOG_CATEGORY_INDEX(UPDATE_EVENTS),
+  LOG_CATEGORY_INDEX(TEXT_TABLES),
   LOG_CATEGORY_INDEX(SPEECH_EVENTS),
   LOG_CATEGORY_INDEX(ASYNC_EVENTS),
   LOG_CATEGORY_INDEX(SERVER_EVENTS),
@@ -97,6 +98,7 @@ extern unsigned char logCategoryFlags[LOG_CATEGORY_COUNT];
 
 extern void openLogFile (const char *path);
 extern void closeLogFile (void);
+extern void setLogFileFlushInterval (int milliseconds);
 
 extern void openSystemLog (void);
 extern void closeSystemLog (void);
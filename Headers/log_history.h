@@ -39,8 +39,12 @@ extern unsigned int getLogEntryCount (const LogEntry *entry);
 
 extern int pushLogEntry (LogEntry **head, const char *text, LogEntryPushOptions options);
 extern int popLogEntry (LogEntry **head);
+extern void deallocateLogEntry (const LogEntry *entry);
 
 extern const LogEntry *getNewestLogMessage (int freeze);
+extern const LogEntry *copyNewLogMessages (unsigned int *sequence);
+extern unsigned int getLogMessageHistorySize (void);
+extern int setLogMessageHistorySize (unsigned int size);
 extern void pushLogMessage (const char *message);
 
 #ifdef __cplusplus
@@ -63,6 +63,8 @@ extern Menu *newSubmenuMenuItem (
   Menu *menu, const MenuString *name
 );
 
+extern void deleteMenuItems (Menu *menu, unsigned int index, unsigned int count);
+
 typedef int MenuItemTester (void);
 extern void setMenuItemTester (MenuItem *item, MenuItemTester *handler);
 
@@ -35,6 +35,7 @@ typedef struct {
   int (*poll) (void);
   int (*refresh) (void);
   void (*describe) (ScreenDescription *);
+  int (*getDamage) (ScreenDamage *damage);
 
   int (*readCharacters) (const ScreenBox *box, ScreenCharacter *buffer);
   int (*insertKey) (ScreenKey key);
@@ -83,6 +83,11 @@ typedef struct {
   short width, height;	/* dimensions */
 } ScreenBox;
 
+typedef struct {
+  short top, bottom;	/* changed rows (none if bottom < top) */
+  short left, right;	/* changed columns within those rows */
+} ScreenDamage;
+
 #define SCR_KEY_SHIFT     0X40000000
 #define SCR_KEY_UPPER     0X20000000
 #define SCR_KEY_CONTROL   0X10000000
@@ -29,6 +29,9 @@ extern void clearScreenCharacters (ScreenCharacter *characters, size_t count);
 extern void setScreenCharacterText (ScreenCharacter *characters, wchar_t text, size_t count);
 extern void setScreenCharacterAttributes (ScreenCharacter *characters, unsigned char attributes, size_t count);
 
+extern void clearScreenDamage (ScreenDamage *damage);
+extern void addScreenDamage (ScreenDamage *damage, int left, int right, int top, int bottom);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,44 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2018 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_TBLCACHE
+#define BRLTTY_INCLUDED_TBLCACHE
+
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct TableCacheStruct TableCache;
+
+extern TableCache *beginTableCache (const char *type, const char *path, size_t layout);
+extern void endTableCache (TableCache *cache);
+
+extern void *loadTableCacheImage (TableCache *cache, size_t *size);
+extern int saveTableCacheImage (TableCache *cache, const void *image, size_t size);
+extern void releaseTableCacheImage (void *image, size_t size);
+
+extern void addTableCacheSource (const char *path, const struct stat *status);
+extern void disableTableCache (void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_TBLCACHE */
@@ -31,6 +31,7 @@ extern "C" {
 
 #define UNICODE_ZERO_WIDTH_SPACE 0X200B
 #define UNICODE_BYTE_ORDER_MARK 0XFEFF
+#define UNICODE_LAST_CHARACTER 0X10FFFF
 
 #define UNICODE_BRAILLE_ROW 0X2800
 
@@ -0,0 +1,281 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2018 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "program.h"
+#include "options.h"
+#include "log.h"
+#include "file.h"
+#include "autospeak.h"
+
+#define MAXIMUM_ROW_WIDTH 0X400
+
+BEGIN_OPTION_TABLE(programOptions)
+END_OPTION_TABLE
+
+typedef struct {
+  ScreenCharacter characters[MAXIMUM_ROW_WIDTH];
+  int width;
+  int cursor;
+} CorpusRow;
+
+typedef struct {
+  const char *path;
+  unsigned int line;
+
+  CorpusRow oldRow;
+  CorpusRow newRow;
+  unsigned char cursorTracked;
+  Preferences preferences;
+
+  unsigned int cases;
+  unsigned int failures;
+  unsigned int errors;
+} CorpusData;
+
+static void
+resetCase (CorpusData *cd) {
+  cd->oldRow.width = -1;
+  cd->newRow.width = -1;
+  cd->cursorTracked = 1;
+
+  memset(&cd->preferences, 0, sizeof(cd->preferences));
+  cd->preferences.autospeakInsertedCharacters = 1;
+  cd->preferences.autospeakDeletedCharacters = 1;
+  cd->preferences.autospeakReplacedCharacters = 1;
+  cd->preferences.autospeakCompletedWords = 1;
+}
+
+static void
+reportError (CorpusData *cd, const char *problem) {
+  logMessage(LOG_ERR, "%s[%u]: %s", cd->path, cd->line, problem);
+  cd->errors += 1;
+}
+
+static int
+parseRow (CorpusData *cd, const char *operands, CorpusRow *row) {
+  const char *from = strchr(operands, '|');
+  const char *to = strrchr(operands, '|');
+
+  if (!from || (to == from)) {
+    reportError(cd, "row not enclosed within vertical bars");
+    return 0;
+  }
+
+  if (sscanf(operands, "%d", &row->cursor) != 1) {
+    reportError(cd, "missing cursor column");
+    return 0;
+  }
+
+  from += 1;
+  row->width = to - from;
+
+  if (row->width > MAXIMUM_ROW_WIDTH) {
+    reportError(cd, "row too wide");
+    return 0;
+  }
+
+  {
+    int column;
+
+    for (column=0; column<row->width; column+=1) {
+      ScreenCharacter *character = &row->characters[column];
+
+      character->text = (unsigned char)from[column];
+      character->attributes = 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+parsePreferences (CorpusData *cd, const char *operands) {
+  Preferences *prefs = &cd->preferences;
+
+  prefs->autospeakInsertedCharacters = 0;
+  prefs->autospeakDeletedCharacters = 0;
+  prefs->autospeakReplacedCharacters = 0;
+  prefs->autospeakCompletedWords = 0;
+
+  while (*operands && !iswspace(*operands)) {
+    switch (*operands++) {
+      case 'i':
+        prefs->autospeakInsertedCharacters = 1;
+        break;
+
+      case 'd':
+        prefs->autospeakDeletedCharacters = 1;
+        break;
+
+      case 'r':
+        prefs->autospeakReplacedCharacters = 1;
+        break;
+
+      case 'w':
+        prefs->autospeakCompletedWords = 1;
+        break;
+
+      case '-':
+        break;
+
+      default:
+        reportError(cd, "unknown preference");
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void
+checkCase (CorpusData *cd, const char *operands) {
+  char row[4];
+  int column;
+  int count;
+  int length;
+
+  if (sscanf(operands, "%3s %d %d %n", row, &column, &count, &length) < 3) {
+    reportError(cd, "invalid expectation");
+  } else if ((cd->oldRow.width < 0) || (cd->newRow.width < 0)) {
+    reportError(cd, "old or new row not specified");
+  } else if ((cd->oldRow.width != cd->newRow.width) || !cd->newRow.width) {
+    reportError(cd, "rows not the same nonzero width");
+  } else {
+    const char *reason = operands + length;
+    AutospeakChange change;
+
+    findAutospeakChange(&change, &cd->preferences,
+                        cd->oldRow.characters, cd->oldRow.cursor,
+                        cd->newRow.characters, cd->newRow.cursor,
+                        cd->newRow.width, cd->cursorTracked);
+
+    {
+      const char *actual = (change.characters == cd->oldRow.characters)? "old": "new";
+
+      if ((strcmp(row, actual) != 0) ||
+          (change.column != column) || (change.count != count) ||
+          (strcmp(change.reason, reason) != 0)) {
+        logMessage(LOG_ERR, "%s[%u]: expected %s %d %d %s, got %s %d %d %s",
+                   cd->path, cd->line, row, column, count, reason,
+                   actual, change.column, change.count, change.reason);
+        cd->failures += 1;
+      }
+    }
+
+    cd->cases += 1;
+  }
+
+  resetCase(cd);
+}
+
+/* Each case of the corpus is made up of these lines:
+ *
+ *   old <cursor-column> |<row>|
+ *   new <cursor-column> |<row>|
+ *   untracked                    (optional: the cursor isn't on the row)
+ *   prefs <letters>              (optional: the autospeak preferences which
+ *                                 are on - i, d, r, w - or - for none)
+ *   expect old|new <column> <count> <reason>
+ *
+ * The expect line runs the case. Blank lines and lines starting with #
+ * are ignored.
+ */
+static int
+handleCorpusLine (char *line, void *data) {
+  CorpusData *cd = data;
+  char *operands;
+
+  cd->line += 1;
+  while (iswspace(*line)) line += 1;
+  if (!*line || (*line == '#')) return 1;
+
+  if ((operands = strchr(line, ' '))) {
+    *operands++ = 0;
+  } else {
+    operands = line + strlen(line);
+  }
+
+  if (strcmp(line, "old") == 0) {
+    parseRow(cd, operands, &cd->oldRow);
+  } else if (strcmp(line, "new") == 0) {
+    parseRow(cd, operands, &cd->newRow);
+  } else if (strcmp(line, "untracked") == 0) {
+    cd->cursorTracked = 0;
+  } else if (strcmp(line, "prefs") == 0) {
+    parsePreferences(cd, operands);
+  } else if (strcmp(line, "expect") == 0) {
+    checkCase(cd, operands);
+  } else {
+    reportError(cd, "unknown directive");
+  }
+
+  return 1;
+}
+
+int
+main (int argc, char *argv[]) {
+  ProgramExitStatus exitStatus = PROG_EXIT_SUCCESS;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "aspktest",
+      .argumentsSummary = "corpus-file ..."
+    };
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  if (!argc) {
+    logMessage(LOG_ERR, "missing corpus file");
+    return PROG_EXIT_SYNTAX;
+  }
+
+  while (argc) {
+    const char *path = (argc--, *argv++);
+    FILE *file = openFile(path, "r", 0);
+
+    if (file) {
+      CorpusData cd = {
+        .path = path
+      };
+
+      resetCase(&cd);
+
+      if (!processLines(file, handleCorpusLine, &cd)) cd.errors += 1;
+      fclose(file);
+
+      logMessage(LOG_NOTICE, "%s: %u cases, %u failures",
+                 path, cd.cases, cd.failures);
+
+      if (cd.errors) {
+        exitStatus = PROG_EXIT_FATAL;
+      } else if (cd.failures && (exitStatus == PROG_EXIT_SUCCESS)) {
+        exitStatus = PROG_EXIT_SEMANTIC;
+      }
+    } else {
+      exitStatus = PROG_EXIT_FATAL;
+    }
+  }
+
+  return exitStatus;
+}
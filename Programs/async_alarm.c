@@ -32,19 +32,33 @@ typedef struct {
   AsyncAlarmCallback *callback;
   void *data;
 
+  AsyncAlarmData *alarmData;
+  Element *element;
+  unsigned long int sequence;
+  unsigned int heapIndex;
+
   unsigned active:1;
   unsigned cancel:1;
   unsigned reschedule:1;
+  unsigned scheduled:1;
 } AlarmEntry;
 
 struct AsyncAlarmDataStruct {
   Queue *alarmQueue;
+
+  struct {
+    AlarmEntry **entries;
+    unsigned int size;
+    unsigned int count;
+    unsigned long int sequence;
+  } heap;
 };
 
 void
 asyncDeallocateAlarmData (AsyncAlarmData *ad) {
   if (ad) {
     if (ad->alarmQueue) deallocateQueue(ad->alarmQueue);
+    if (ad->heap.entries) free(ad->heap.entries);
     free(ad);
   }
 }
@@ -64,12 +78,107 @@ getAlarmData (void) {
 
     memset(ad, 0, sizeof(*ad));
     ad->alarmQueue = NULL;
+
+    ad->heap.entries = NULL;
+    ad->heap.size = 0;
+    ad->heap.count = 0;
+    ad->heap.sequence = 0;
     tsd->alarmData = ad;
   }
 
   return tsd->alarmData;
 }
 
+/* The alarms are ordered by a binary heap (earliest first) so that adding,
+ * resetting, and removing one costs O(log n) rather than the linear scan
+ * which a sorted queue needs. The queue itself is unsorted - it only owns
+ * the entries and provides the elements which async handles refer to.
+ */
+
+static int
+isEarlierAlarm (const AlarmEntry *alarm1, const AlarmEntry *alarm2) {
+  int relation = compareTimeValues(&alarm1->time, &alarm2->time);
+
+  if (relation) return relation < 0;
+  return alarm1->sequence < alarm2->sequence;
+}
+
+static void
+setHeapAlarm (AsyncAlarmData *ad, unsigned int index, AlarmEntry *alarm) {
+  ad->heap.entries[index] = alarm;
+  alarm->heapIndex = index;
+}
+
+static void
+siftHeapAlarm (AsyncAlarmData *ad, AlarmEntry *alarm) {
+  AlarmEntry **entries = ad->heap.entries;
+  unsigned int count = ad->heap.count;
+  unsigned int index = alarm->heapIndex;
+
+  while (index > 0) {
+    unsigned int parent = (index - 1) / 2;
+
+    if (!isEarlierAlarm(alarm, entries[parent])) break;
+    setHeapAlarm(ad, index, entries[parent]);
+    index = parent;
+  }
+
+  while (1) {
+    unsigned int child = (index * 2) + 1;
+
+    if (child >= count) break;
+    if ((child + 1 < count) && isEarlierAlarm(entries[child+1], entries[child])) child += 1;
+    if (!isEarlierAlarm(entries[child], alarm)) break;
+
+    setHeapAlarm(ad, index, entries[child]);
+    index = child;
+  }
+
+  setHeapAlarm(ad, index, alarm);
+}
+
+static int
+addHeapAlarm (AsyncAlarmData *ad, AlarmEntry *alarm) {
+  if (ad->heap.count == ad->heap.size) {
+    unsigned int newSize = ad->heap.size? ad->heap.size<<1: 0X10;
+    AlarmEntry **newEntries = realloc(ad->heap.entries, ARRAY_SIZE(newEntries, newSize));
+
+    if (!newEntries) {
+      logMallocError();
+      return 0;
+    }
+
+    ad->heap.entries = newEntries;
+    ad->heap.size = newSize;
+  }
+
+  alarm->sequence = ++ad->heap.sequence;
+  alarm->scheduled = 1;
+  setHeapAlarm(ad, ad->heap.count++, alarm);
+  siftHeapAlarm(ad, alarm);
+  return 1;
+}
+
+static void
+removeHeapAlarm (AsyncAlarmData *ad, AlarmEntry *alarm) {
+  unsigned int index = alarm->heapIndex;
+
+  alarm->scheduled = 0;
+
+  if (index < --ad->heap.count) {
+    AlarmEntry *last = ad->heap.entries[ad->heap.count];
+
+    setHeapAlarm(ad, index, last);
+    siftHeapAlarm(ad, last);
+  }
+}
+
+static void
+rescheduleHeapAlarm (AsyncAlarmData *ad, AlarmEntry *alarm) {
+  alarm->sequence = ++ad->heap.sequence;
+  siftHeapAlarm(ad, alarm);
+}
+
 static void
 cancelAlarm (Element *element) {
   AlarmEntry *alarm = getElementItem(element);
@@ -85,24 +194,17 @@ static void
 deallocateAlarmEntry (void *item, void *data) {
   AlarmEntry *alarm = item;
 
+  if (alarm->scheduled) removeHeapAlarm(alarm->alarmData, alarm);
   free(alarm);
 }
 
-static int
-compareAlarmEntries (const void *newItem, const void *existingItem, void *queueData) {
-  const AlarmEntry *newAlarm = newItem;
-  const AlarmEntry *existingAlarm = existingItem;
-
-  return compareTimeValues(&newAlarm->time, &existingAlarm->time) < 0;
-}
-
 static Queue *
 getAlarmQueue (int create) {
   AsyncAlarmData *ad = getAlarmData();
   if (!ad) return NULL;
 
   if (!ad->alarmQueue && create) {
-    if ((ad->alarmQueue = newQueue(deallocateAlarmEntry, compareAlarmEntries))) {
+    if ((ad->alarmQueue = newQueue(deallocateAlarmEntry, NULL))) {
       static AsyncQueueMethods methods = {
         .cancelRequest = cancelAlarm
       };
@@ -123,6 +225,7 @@ typedef struct {
 static Element *
 newAlarmElement (const void *parameters) {
   const AlarmElementParameters *aep = parameters;
+  AsyncAlarmData *ad = getAlarmData();
   Queue *alarms = getAlarmQueue(1);
 
   if (alarms) {
@@ -136,17 +239,22 @@ newAlarmElement (const void *parameters) {
       alarm->callback = aep->callback;
       alarm->data = aep->data;
 
+      alarm->alarmData = ad;
       alarm->active = 0;
       alarm->cancel = 0;
       alarm->reschedule = 0;
+      alarm->scheduled = 0;
 
-      {
+      if (addHeapAlarm(ad, alarm)) {
         Element *element = enqueueItem(alarms, alarm);
 
         if (element) {
+          alarm->element = element;
           logSymbol(LOG_CATEGORY(ASYNC_EVENTS), aep->callback, "alarm added");
           return element;
         }
+
+        removeHeapAlarm(ad, alarm);
       }
 
       free(alarm);
@@ -201,7 +309,7 @@ asyncResetAlarmTo (AsyncHandle handle, const TimeValue *time) {
     AlarmEntry *alarm = getElementItem(element);
 
     alarm->time = *time;
-    requeueElement(element);
+    if (alarm->scheduled) rescheduleHeapAlarm(alarm->alarmData, alarm);
     return 1;
   }
 
@@ -232,23 +340,14 @@ asyncResetAlarmEvery (AsyncHandle handle, int milliseconds) {
   return 0;
 }
 
-static int
-testInactiveAlarm (void *item, void *data) {
-  const AlarmEntry *alarm = item;
-
-  return !alarm->active;
-}
-
 int
 asyncExecuteAlarmCallback (AsyncAlarmData *ad, long int *timeout) {
   if (ad) {
     Queue *alarms = ad->alarmQueue;
 
     if (alarms) {
-      Element *element = processQueue(alarms, testInactiveAlarm, NULL);
-
-      if (element) {
-        AlarmEntry *alarm = getElementItem(element);
+      if (ad->heap.count > 0) {
+        AlarmEntry *alarm = ad->heap.entries[0];
         TimeValue now;
         long int milliseconds;
 
@@ -256,6 +355,7 @@ asyncExecuteAlarmCallback (AsyncAlarmData *ad, long int *timeout) {
         milliseconds = millisecondsBetween(&now, &alarm->time);
 
         if (milliseconds <= 0) {
+          Element *element = alarm->element;
           AsyncAlarmCallback *callback = alarm->callback;
           const AsyncAlarmCallbackParameters parameters = {
             .now = &now,
@@ -263,15 +363,16 @@ asyncExecuteAlarmCallback (AsyncAlarmData *ad, long int *timeout) {
           };
 
           logSymbol(LOG_CATEGORY(ASYNC_EVENTS), callback, "alarm starting");
+          removeHeapAlarm(ad, alarm);
           alarm->active = 1;
           if (callback) callback(&parameters);
           alarm->active = 0;
 
-          if (alarm->reschedule) {
+          if (alarm->reschedule && !alarm->cancel) {
             adjustTimeValue(&alarm->time, alarm->interval);
             getMonotonicTime(&now);
             if (compareTimeValues(&alarm->time, &now) < 0) alarm->time = now;
-            requeueElement(element);
+            if (!addHeapAlarm(ad, alarm)) alarm->cancel = 1;
           } else {
             alarm->cancel = 1;
           }
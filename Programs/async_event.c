@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include <string.h>
+#include <errno.h>
 
 #include "log.h"
 #include "async_io.h"
@@ -26,6 +27,20 @@
 #include "async_internal.h"
 #include "file.h"
 
+#include "get_pthreads.h"
+
+/* An eventfd can't carry the signal data, so it's queued separately. This
+ * requires a lock, which is only safe when events are never signalled from
+ * within a signal handler, i.e. when signals are delivered via signalfd.
+ */
+#if defined(ENABLE_EPOLL_MONITORING) && defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_SYS_SIGNALFD_H) && defined(GOT_PTHREADS)
+#define ASYNC_EVENT_USE_EVENTFD
+
+#include <sys/eventfd.h>
+
+#include "lock.h"
+#endif /* ASYNC_EVENT_USE_EVENTFD */
+
 struct AsyncEventStruct {
   AsyncEventCallback *callback;
   void *data;
@@ -40,8 +55,159 @@ struct AsyncEventStruct {
   CRITICAL_SECTION criticalSection;
   unsigned int pendingCount;
 #endif /* __MINGW32__ */
+
+#ifdef ASYNC_EVENT_USE_EVENTFD
+  struct {
+    LockDescriptor *lock;
+    void **array;
+    unsigned int size;
+    unsigned int first;
+    unsigned int count;
+  } pending;
+#endif /* ASYNC_EVENT_USE_EVENTFD */
 };
 
+static void
+handleEventSignal (AsyncEvent *event, void *data) {
+  AsyncEventCallback *callback = event->callback;
+
+  const AsyncEventCallbackParameters parameters = {
+    .eventData = event->data,
+    .signalData = data
+  };
+
+  logSymbol(LOG_CATEGORY(ASYNC_EVENTS), callback, "event starting");
+  if (callback) callback(&parameters);
+}
+
+#ifdef ASYNC_EVENT_USE_EVENTFD
+static int
+addPendingSignal (AsyncEvent *event, void *data) {
+  int added = 0;
+
+  obtainExclusiveLock(event->pending.lock);
+
+  if (event->pending.count == event->pending.size) {
+    unsigned int newSize = event->pending.size? (event->pending.size << 1): 0X10;
+    void **newArray = malloc(ARRAY_SIZE(newArray, newSize));
+
+    if (newArray) {
+      for (unsigned int index=0; index<event->pending.count; index+=1) {
+        newArray[index] = event->pending.array[(event->pending.first + index) % event->pending.size];
+      }
+
+      if (event->pending.array) free(event->pending.array);
+      event->pending.array = newArray;
+      event->pending.size = newSize;
+      event->pending.first = 0;
+    } else {
+      logMallocError();
+    }
+  }
+
+  if (event->pending.count < event->pending.size) {
+    event->pending.array[(event->pending.first + event->pending.count++) % event->pending.size] = data;
+    added = 1;
+  }
+
+  releaseLock(event->pending.lock);
+  return added;
+}
+
+static int
+removePendingSignal (AsyncEvent *event, void **data) {
+  int removed = 0;
+
+  obtainExclusiveLock(event->pending.lock);
+
+  if (event->pending.count) {
+    *data = event->pending.array[event->pending.first];
+    if (++event->pending.first == event->pending.size) event->pending.first = 0;
+    event->pending.count -= 1;
+    removed = 1;
+  }
+
+  releaseLock(event->pending.lock);
+  return removed;
+}
+
+ASYNC_MONITOR_CALLBACK(asyncMonitorEventDescriptor) {
+  AsyncEvent *event = parameters->data;
+  eventfd_t value;
+
+  if (eventfd_read(event->monitorDescriptor, &value) != -1) {
+    void *data;
+
+    if (removePendingSignal(event, &data)) handleEventSignal(event, data);
+    return 1;
+  }
+
+  if (errno == EAGAIN) return 1;
+  logSystemError("eventfd_read");
+  return 0;
+}
+
+int
+asyncSignalEvent (AsyncEvent *event, void *data) {
+  if (addPendingSignal(event, data)) {
+    if (eventfd_write(event->monitorDescriptor, 1) != -1) return 1;
+    logSystemError("eventfd_write");
+  }
+
+  return 0;
+}
+
+AsyncEvent *
+asyncNewEvent (AsyncEventCallback *callback, void *data) {
+  AsyncEvent *event;
+
+  if ((event = malloc(sizeof(*event)))) {
+    memset(event, 0, sizeof(*event));
+    event->callback = callback;
+    event->data = data;
+
+    event->pending.array = NULL;
+    event->pending.size = 0;
+    event->pending.first = 0;
+    event->pending.count = 0;
+
+    if ((event->pending.lock = newLockDescriptor())) {
+      if ((event->monitorDescriptor = eventfd(0, (EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC))) != -1) {
+        if (asyncMonitorFileInput(&event->monitorHandle, event->monitorDescriptor,
+                                  asyncMonitorEventDescriptor, event)) {
+          logSymbol(LOG_CATEGORY(ASYNC_EVENTS), event->callback, "event added");
+          return event;
+        }
+
+        closeFileDescriptor(event->monitorDescriptor);
+      } else {
+        logSystemError("eventfd");
+      }
+
+      freeLockDescriptor(event->pending.lock);
+    }
+
+    free(event);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+void
+asyncDiscardEvent (AsyncEvent *event) {
+  asyncCancelRequest(event->monitorHandle);
+  closeFileDescriptor(event->monitorDescriptor);
+
+  freeLockDescriptor(event->pending.lock);
+  if (event->pending.array) free(event->pending.array);
+
+  logSymbol(LOG_CATEGORY(ASYNC_EVENTS), event->callback, "event removed");
+  free(event);
+}
+
+#else /* ASYNC_EVENT_USE_EVENTFD */
 ASYNC_MONITOR_CALLBACK(asyncMonitorEventPipe) {
   AsyncEvent *event = parameters->data;
   void *data;
@@ -54,18 +220,7 @@ ASYNC_MONITOR_CALLBACK(asyncMonitorEventPipe) {
     LeaveCriticalSection(&event->criticalSection);
 #endif /* __MINGW32__ */
 
-    {
-      AsyncEventCallback *callback = event->callback;
-
-      const AsyncEventCallbackParameters parameters = {
-        .eventData = event->data,
-        .signalData = data
-      };
-
-      logSymbol(LOG_CATEGORY(ASYNC_EVENTS), callback, "event starting");
-      if (callback) callback(&parameters);
-    }
-
+    handleEventSignal(event, data);
     return 1;
   }
 
@@ -157,4 +312,4 @@ asyncDiscardEvent (AsyncEvent *event) {
   logSymbol(LOG_CATEGORY(ASYNC_EVENTS), event->callback, "event removed");
   free(event);
 }
-
+#endif /* ASYNC_EVENT_USE_EVENTFD */
@@ -45,6 +45,12 @@ typedef HANDLE MonitorEntry;
 #include <sys/poll.h>
 typedef struct pollfd MonitorEntry;
 
+#if defined(ENABLE_EPOLL_MONITORING) && defined(HAVE_SYS_EPOLL_H)
+#define ASYNC_CAN_MONITOR_WITH_EPOLL
+
+#include <sys/epoll.h>
+#endif /* epoll */
+
 #elif defined(GOT_SELECT)
 #define ASYNC_CAN_MONITOR_IO
 
@@ -134,6 +140,16 @@ struct FunctionEntryStruct {
     short int events;
   } poll;
 
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+  struct {
+    AsyncIoData *ioData;
+    Element *element;
+    FunctionEntry *next;
+    uint32_t events;
+    unsigned suspended:1;
+  } epoll;
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
 #elif defined(HAVE_SELECT)
   struct {
     SelectDescriptor *descriptor;
@@ -152,14 +168,42 @@ typedef struct {
   unsigned int count;
 } MonitorGroup;
 
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+typedef struct {
+  FunctionEntry *functions;
+  uint32_t events;
+  unsigned alwaysReady:1;
+} EpollDescriptor;
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
 struct AsyncIoDataStruct {
   Queue *functionQueue;
+
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+  struct {
+    int descriptor;
+    pid_t process;
+    EpollDescriptor *descriptors;
+    unsigned int descriptorCount;
+
+    unsigned int alwaysReadyCount;
+    unsigned int alwaysReadyIndex;
+
+    FunctionEntry *finishedFunction;
+  } epoll;
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
 };
 
 void
 asyncDeallocateIoData (AsyncIoData *iod) {
   if (iod) {
     if (iod->functionQueue) deallocateQueue(iod->functionQueue);
+
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+    if (iod->epoll.descriptor != -1) close(iod->epoll.descriptor);
+    if (iod->epoll.descriptors) free(iod->epoll.descriptors);
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
     free(iod);
   }
 }
@@ -179,6 +223,20 @@ getIoData (void) {
 
     memset(iod, 0, sizeof(*iod));
     iod->functionQueue = NULL;
+
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+    iod->epoll.descriptors = NULL;
+    iod->epoll.descriptorCount = 0;
+    iod->epoll.alwaysReadyCount = 0;
+    iod->epoll.alwaysReadyIndex = 0;
+    iod->epoll.finishedFunction = NULL;
+    iod->epoll.process = getpid();
+
+    if ((iod->epoll.descriptor = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+      logSystemError("epoll_create1");
+    }
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
     tsd->ioData = iod;
   }
 
@@ -385,19 +443,31 @@ testMonitor (const MonitorEntry *monitor, int *error) {
   return monitor->revents != 0;
 }
 
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+static inline void
+setEpollEvents (FunctionEntry *function, uint32_t events) {
+  function->epoll.events = events;
+}
+#else /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+#define setEpollEvents(function, events)
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
 static void
 beginUnixInputFunction (FunctionEntry *function) {
   function->poll.events = POLLIN;
+  setEpollEvents(function, EPOLLIN);
 }
 
 static void
 beginUnixOutputFunction (FunctionEntry *function) {
   function->poll.events = POLLOUT;
+  setEpollEvents(function, EPOLLOUT);
 }
 
 static void
 beginUnixAlertFunction (FunctionEntry *function) {
   function->poll.events = POLLPRI;
+  setEpollEvents(function, EPOLLPRI);
 }
 
 #elif defined(HAVE_SELECT)
@@ -550,11 +620,189 @@ finishUnixWrite (OperationEntry *operation) {
 #endif /* ASYNC_CAN_MONITOR_IO */
 #endif /* __MINGW32__ */
 
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+static EpollDescriptor *
+getEpollDescriptor (AsyncIoData *iod, int fileDescriptor) {
+  if (fileDescriptor < 0) return NULL;
+
+  if (fileDescriptor >= iod->epoll.descriptorCount) {
+    unsigned int oldCount = iod->epoll.descriptorCount;
+    unsigned int newCount = (fileDescriptor | 0X3F) + 1;
+    EpollDescriptor *descriptors = realloc(iod->epoll.descriptors, ARRAY_SIZE(descriptors, newCount));
+
+    if (!descriptors) {
+      logMallocError();
+      return NULL;
+    }
+
+    memset(&descriptors[oldCount], 0, ARRAY_SIZE(descriptors, (newCount - oldCount)));
+    iod->epoll.descriptors = descriptors;
+    iod->epoll.descriptorCount = newCount;
+  }
+
+  return &iod->epoll.descriptors[fileDescriptor];
+}
+
+static void updateEpollDescriptor (AsyncIoData *iod, int fileDescriptor);
+
+static void
+verifyEpollProcess (AsyncIoData *iod) {
+  pid_t process = getpid();
+
+  if (process != iod->epoll.process) {
+    /* A forked child shares the epoll set of its parent, so any change it
+     * were to make would also affect the parent.
+     */
+    iod->epoll.process = process;
+
+    if (iod->epoll.descriptor != -1) close(iod->epoll.descriptor);
+    iod->epoll.alwaysReadyCount = 0;
+
+    for (unsigned int fileDescriptor=0; fileDescriptor<iod->epoll.descriptorCount; fileDescriptor+=1) {
+      EpollDescriptor *descriptor = &iod->epoll.descriptors[fileDescriptor];
+
+      descriptor->events = 0;
+      descriptor->alwaysReady = 0;
+    }
+
+    if ((iod->epoll.descriptor = epoll_create1(EPOLL_CLOEXEC)) != -1) {
+      for (unsigned int fileDescriptor=0; fileDescriptor<iod->epoll.descriptorCount; fileDescriptor+=1) {
+        if (iod->epoll.descriptors[fileDescriptor].functions) {
+          updateEpollDescriptor(iod, fileDescriptor);
+        }
+      }
+    } else {
+      logSystemError("epoll_create1");
+    }
+  }
+}
+
+static void
+updateEpollDescriptor (AsyncIoData *iod, int fileDescriptor) {
+  EpollDescriptor *descriptor = &iod->epoll.descriptors[fileDescriptor];
+  uint32_t events = 0;
+
+  verifyEpollProcess(iod);
+  if (iod->epoll.descriptor == -1) return;
+
+  {
+    const FunctionEntry *function = descriptor->functions;
+
+    while (function) {
+      if (!function->epoll.suspended) events |= function->epoll.events;
+      function = function->epoll.next;
+    }
+  }
+
+  if (descriptor->alwaysReady) {
+    if (!descriptor->functions) {
+      descriptor->alwaysReady = 0;
+      iod->epoll.alwaysReadyCount -= 1;
+    }
+  } else if (events != descriptor->events) {
+    struct epoll_event event = {
+      .events = events,
+      .data.fd = fileDescriptor
+    };
+
+    int operation = !descriptor->events? EPOLL_CTL_ADD:
+                    events? EPOLL_CTL_MOD:
+                    EPOLL_CTL_DEL;
+
+    int result = epoll_ctl(iod->epoll.descriptor, operation, fileDescriptor, &event);
+
+    if ((result == -1) && (errno == ENOENT) && (operation == EPOLL_CTL_MOD)) {
+      /* it was closed (and maybe reopened) while still being monitored */
+      operation = EPOLL_CTL_ADD;
+      result = epoll_ctl(iod->epoll.descriptor, operation, fileDescriptor, &event);
+    }
+
+    if (result != -1) {
+      descriptor->events = events;
+    } else if (operation == EPOLL_CTL_DEL) {
+      /* it was closed before its monitors were cancelled */
+      descriptor->events = 0;
+    } else if ((errno == EPERM) || (errno == EBADF)) {
+      /* Regular files can't be monitored (they're always ready), and an
+       * invalid descriptor should have its error reported by the operation.
+       */
+      descriptor->events = 0;
+      descriptor->alwaysReady = 1;
+      iod->epoll.alwaysReadyCount += 1;
+    } else {
+      logSystemError("epoll_ctl");
+    }
+  }
+}
+
+static int
+addEpollFunction (AsyncIoData *iod, FunctionEntry *function, Element *element) {
+  function->epoll.ioData = iod;
+  function->epoll.element = element;
+  function->epoll.next = NULL;
+  function->epoll.suspended = 0;
+
+  verifyEpollProcess(iod);
+  if (iod->epoll.descriptor != -1) {
+    EpollDescriptor *descriptor = getEpollDescriptor(iod, function->fileDescriptor);
+    if (!descriptor) return 0;
+
+    {
+      FunctionEntry **next = &descriptor->functions;
+
+      while (*next) next = &(*next)->epoll.next;
+      *next = function;
+    }
+
+    updateEpollDescriptor(iod, function->fileDescriptor);
+  }
+
+  return 1;
+}
+
+static void
+removeEpollFunction (FunctionEntry *function) {
+  AsyncIoData *iod = function->epoll.ioData;
+
+  if (iod) {
+    if (iod->epoll.finishedFunction == function) iod->epoll.finishedFunction = NULL;
+
+    verifyEpollProcess(iod);
+    if (iod->epoll.descriptor != -1) {
+      if ((function->fileDescriptor >= 0) &&
+          (function->fileDescriptor < iod->epoll.descriptorCount)) {
+        FunctionEntry **next = &iod->epoll.descriptors[function->fileDescriptor].functions;
+
+        while (*next) {
+          if (*next == function) {
+            *next = function->epoll.next;
+            updateEpollDescriptor(iod, function->fileDescriptor);
+            break;
+          }
+
+          next = &(*next)->epoll.next;
+        }
+      }
+    }
+  }
+}
+
+static void
+suspendEpollFunction (FunctionEntry *function, int suspend) {
+  function->epoll.suspended = suspend;
+  updateEpollDescriptor(function->epoll.ioData, function->fileDescriptor);
+}
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
 #ifdef ASYNC_CAN_MONITOR_IO
 static void
 deallocateFunctionEntry (void *item, void *data) {
   FunctionEntry *function = item;
 
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+  removeEpollFunction(function);
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
   if (function->operations) deallocateQueue(function->operations);
   if (function->methods->endFunction) function->methods->endFunction(function);
   free(function);
@@ -718,60 +966,197 @@ testFunctionMonitor (void *item, void *data) {
   return 0;
 }
 
-int
-asyncExecuteIoCallback (AsyncIoData *iod, long int timeout) {
-  if (iod) {
-    Queue *functions = iod->functionQueue;
-    unsigned int functionCount = functions? getQueueSize(functions): 0;
+static void
+executeFunction (Element *functionElement) {
+  FunctionEntry *function = getElementItem(functionElement);
+  Element *operationElement = getActiveOperationElement(function);
+  OperationEntry *operation = getElementItem(operationElement);
 
-    prepareMonitors();
+  if (!operation->finished) finishOperation(operation);
 
-    if (functionCount) {
-      MonitorEntry monitorArray[functionCount];
-      MonitorGroup monitors = {
-        .array = monitorArray,
-        .count = 0
-      };
+  operation->active = 1;
+  if (!function->methods->invokeCallback(operation)) operation->cancel = 1;
+  operation->active = 0;
+
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+  if (function->epoll.suspended) suspendEpollFunction(function, 0);
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
+  if (operation->cancel) {
+    deleteElement(operationElement);
+  } else {
+    operation->error = 0;
+  }
 
-      int executed = 0;
-      Element *functionElement = processQueue(functions, addFunctionMonitor, &monitors);
+  if ((operationElement = getActiveOperationElement(function))) {
+    operation = getElementItem(operationElement);
+    if (!operation->finished) startOperation(operation);
+    requeueElement(functionElement);
 
-      if (!functionElement) {
-        if (!monitors.count) {
-          approximateDelay(timeout);
-        } else if (awaitMonitors(&monitors, timeout)) {
-          functionElement = processQueue(functions, testFunctionMonitor, NULL);
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+    if (operation->finished) function->epoll.ioData->epoll.finishedFunction = function;
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+  } else {
+    deleteElement(functionElement);
+  }
+}
+
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+static FunctionEntry *
+getAlwaysReadyFunction (AsyncIoData *iod) {
+  unsigned int count = iod->epoll.descriptorCount;
+  unsigned int index = iod->epoll.alwaysReadyIndex;
+
+  for (unsigned int counter=0; counter<count; counter+=1) {
+    const EpollDescriptor *descriptor = &iod->epoll.descriptors[index];
+
+    if (++index == count) index = 0;
+
+    if (descriptor->alwaysReady) {
+      FunctionEntry *function = descriptor->functions;
+
+      while (function) {
+        const OperationEntry *operation = getActiveOperation(function);
+
+        if (operation && !operation->active) {
+          iod->epoll.alwaysReadyIndex = index;
+          return function;
         }
+
+        function = function->epoll.next;
       }
+    }
+  }
 
-      if (functionElement) {
-        FunctionEntry *function = getElementItem(functionElement);
-        Element *operationElement = getActiveOperationElement(function);
-        OperationEntry *operation = getElementItem(operationElement);
+  return NULL;
+}
 
-        if (!operation->finished) finishOperation(operation);
+static FunctionEntry *
+getEpollFunction (AsyncIoData *iod, const struct epoll_event *event) {
+  int fileDescriptor = event->data.fd;
 
-        operation->active = 1;
-        if (!function->methods->invokeCallback(operation)) operation->cancel = 1;
-        operation->active = 0;
-        executed = 1;
+  if ((fileDescriptor >= 0) && (fileDescriptor < iod->epoll.descriptorCount)) {
+    EpollDescriptor *descriptor = &iod->epoll.descriptors[fileDescriptor];
+    FunctionEntry **next = &descriptor->functions;
 
-        if (operation->cancel) {
-          deleteElement(operationElement);
-        } else {
-          operation->error = 0;
-        }
+    while (*next) {
+      FunctionEntry *function = *next;
+
+      if (event->events & (function->epoll.events | EPOLLERR | EPOLLHUP)) {
+        OperationEntry *operation = getActiveOperation(function);
+
+        if (operation) {
+          if (operation->active) {
+            /* Its callback is waiting, so stop the descriptor from being
+             * reported as ready until the callback returns.
+             */
+            suspendEpollFunction(function, 1);
+          } else {
+            int *error = &operation->error;
+
+            *error = 0;
+
+            if (event->events & EPOLLERR) {
+              *error = EIO;
+            } else if (event->events & EPOLLHUP) {
+              *error = ENODEV;
+            }
 
-        if ((operationElement = getActiveOperationElement(function))) {
-          operation = getElementItem(operationElement);
-          if (!operation->finished) startOperation(operation);
-          requeueElement(functionElement);
-        } else {
-          deleteElement(functionElement);
+            if (function->epoll.next) {
+              /* give the other functions on this descriptor a turn */
+              FunctionEntry **last = &function->epoll.next;
+
+              while (*last) last = &(*last)->epoll.next;
+              *next = function->epoll.next;
+              function->epoll.next = NULL;
+              *last = function;
+            }
+
+            return function;
+          }
         }
       }
 
-      return executed;
+      next = &function->epoll.next;
+    }
+  }
+
+  return NULL;
+}
+
+static Element *
+awaitEpollFunction (AsyncIoData *iod, long int timeout) {
+  FunctionEntry *function;
+
+  if ((function = iod->epoll.finishedFunction)) {
+    iod->epoll.finishedFunction = NULL;
+    return function->epoll.element;
+  }
+
+  {
+    struct epoll_event event;
+    int result = epoll_wait(iod->epoll.descriptor, &event, 1,
+                            (iod->epoll.alwaysReadyCount? 0: timeout));
+
+    if (result > 0) {
+      if ((function = getEpollFunction(iod, &event))) return function->epoll.element;
+    } else if (result == -1) {
+      if (errno != EINTR) logSystemError("epoll_wait");
+    }
+  }
+
+  if (iod->epoll.alwaysReadyCount) {
+    if ((function = getAlwaysReadyFunction(iod))) return function->epoll.element;
+  }
+
+  return NULL;
+}
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
+int
+asyncExecuteIoCallback (AsyncIoData *iod, long int timeout) {
+  if (iod) {
+    Queue *functions = iod->functionQueue;
+    unsigned int functionCount = functions? getQueueSize(functions): 0;
+
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+    verifyEpollProcess(iod);
+
+    if (iod->epoll.descriptor != -1) {
+      if (functionCount) {
+        Element *functionElement = awaitEpollFunction(iod, timeout);
+        if (!functionElement) return 0;
+
+        executeFunction(functionElement);
+        return 1;
+      }
+    } else
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
+    {
+      prepareMonitors();
+
+      if (functionCount) {
+        MonitorEntry monitorArray[functionCount];
+        MonitorGroup monitors = {
+          .array = monitorArray,
+          .count = 0
+        };
+
+        Element *functionElement = processQueue(functions, addFunctionMonitor, &monitors);
+
+        if (!functionElement) {
+          if (!monitors.count) {
+            approximateDelay(timeout);
+          } else if (awaitMonitors(&monitors, timeout)) {
+            functionElement = processQueue(functions, testFunctionMonitor, NULL);
+          }
+        }
+
+        if (!functionElement) return 0;
+        executeFunction(functionElement);
+        return 1;
+      }
     }
   }
 
@@ -864,7 +1249,17 @@ getFunctionElement (FileDescriptor fileDescriptor, const FunctionMethods *method
 
           {
             Element *element = enqueueItem(functions, function);
-            if (element) return element;
+
+            if (element) {
+#ifdef ASYNC_CAN_MONITOR_WITH_EPOLL
+              if (!addEpollFunction(getIoData(), function, element)) {
+                deleteElement(element);
+                return NULL;
+              }
+#endif /* ASYNC_CAN_MONITOR_WITH_EPOLL */
+
+              return element;
+            }
           }
 
           deallocateQueue(function->operations);
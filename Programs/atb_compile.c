@@ -20,9 +20,11 @@
 
 #include <string.h>
 
+#include "log.h"
 #include "file.h"
 #include "datafile.h"
 #include "dataarea.h"
+#include "tblcache.h"
 #include "atb.h"
 #include "atb_internal.h"
 
@@ -161,9 +163,52 @@ static DATA_OPERANDS_PROCESSOR(processAttributesTableOperands) {
   return processDirectiveOperand(file, &directives, "attributes table directive", data);
 }
 
+static AttributesTable *
+newAttributesTable (AttributesTableHeader *header, size_t size) {
+  AttributesTable *table = malloc(sizeof(*table));
+
+  if (table) {
+    memset(table, 0, sizeof(*table));
+
+    table->header.fields = header;
+    table->size = size;
+  } else {
+    logMallocError();
+  }
+
+  return table;
+}
+
+static AttributesTable *
+loadAttributesTable (TableCache *cache) {
+  size_t size;
+  void *image = loadTableCacheImage(cache, &size);
+
+  if (image) {
+    AttributesTable *table = newAttributesTable(image, size);
+
+    if (table) {
+      table->fromCache = 1;
+      return table;
+    }
+
+    releaseTableCacheImage(image, size);
+  }
+
+  return NULL;
+}
+
 AttributesTable *
 compileAttributesTable (const char *name) {
   AttributesTable *table = NULL;
+  TableCache *cache = beginTableCache(ATTRIBUTES_TABLE_EXTENSION, name, sizeof(AttributesTableHeader));
+
+  if (cache) {
+    if ((table = loadAttributesTable(cache))) {
+      endTableCache(cache);
+      return table;
+    }
+  }
 
   if (setTableDataVariables(ATTRIBUTES_TABLE_EXTENSION, ATTRIBUTES_SUBTABLE_EXTENSION)) {
     AttributesTableData atd;
@@ -178,10 +223,9 @@ compileAttributesTable (const char *name) {
 
         if (processDataFile(name, &parameters)) {
           if (makeAttributesToDots(&atd)) {
-            if ((table = malloc(sizeof(*table)))) {
-              table->header.fields = getAttributesTableHeader(&atd);
-              table->size = getDataSize(atd.area);
+            if ((table = newAttributesTable(getAttributesTableHeader(&atd), getDataSize(atd.area)))) {
               resetDataArea(atd.area);
+              if (cache) saveTableCacheImage(cache, table->header.bytes, table->size);
             }
           }
         }
@@ -191,13 +235,19 @@ compileAttributesTable (const char *name) {
     }
   }
 
+  if (cache) endTableCache(cache);
   return table;
 }
 
 void
 destroyAttributesTable (AttributesTable *table) {
   if (table->size) {
-    free(table->header.fields);
+    if (table->fromCache) {
+      releaseTableCacheImage(table->header.fields, table->size);
+    } else {
+      free(table->header.fields);
+    }
+
     free(table);
   }
 }
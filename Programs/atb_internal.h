@@ -36,6 +36,7 @@ struct AttributesTableStruct {
   } header;
 
   size_t size;
+  unsigned fromCache:1;
 };
 
 #ifdef __cplusplus
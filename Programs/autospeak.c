@@ -0,0 +1,220 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2018 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include "autospeak.h"
+
+static int
+isSameRowText (
+  const ScreenCharacter *characters1,
+  const ScreenCharacter *characters2,
+  int count
+) {
+  while (count > 0) {
+    if (characters1->text != characters2->text) return 0;
+    characters1 += 1;
+    characters2 += 1;
+    count -= 1;
+  }
+
+  return 1;
+}
+
+/* Set each element of matches to the length of the common prefix of the
+ * pattern and the text starting at that offset (the Z algorithm). When
+ * prefixes is NULL the text is the pattern itself, otherwise it must be the
+ * result of doing that for the pattern. This finds every shift at which the
+ * text matches the pattern through to its end in linear time.
+ */
+static void
+findPrefixMatches (
+  const ScreenCharacter *pattern, const int *prefixes,
+  const ScreenCharacter *text, int count, int *matches
+) {
+  int index = 0;
+  int from = 0;
+  int to = 0;
+
+  if (!prefixes) {
+    if (!count) return;
+    matches[index++] = count;
+    prefixes = matches;
+  }
+
+  while (index < count) {
+    int length = 0;
+
+    if (index < to) length = MIN(prefixes[index-from], to-index);
+
+    while ((index + length) < count) {
+      if (text[index+length].text != pattern[length].text) break;
+      length += 1;
+    }
+
+    matches[index] = length;
+
+    if ((index + length) > to) {
+      from = index;
+      to = index + length;
+    }
+
+    index += 1;
+  }
+}
+
+void
+findAutospeakChange (
+  AutospeakChange *change, const Preferences *preferences,
+  const ScreenCharacter *oldCharacters, int oldX,
+  const ScreenCharacter *newCharacters, int newX,
+  int width, int cursorTracked
+) {
+  const ScreenCharacter *characters = newCharacters;
+  int column = 0;
+  int count = width;
+  const char *reason = NULL;
+
+  if (cursorTracked) {
+    if ((newX == oldX) && isSameRowText(newCharacters, oldCharacters, newX)) {
+      int oldLength = width;
+      int newLength = width;
+      int x = newX;
+
+      while (oldLength > oldX) {
+        if (!iswspace(oldCharacters[oldLength-1].text)) break;
+        oldLength -= 1;
+      }
+      if (oldLength < width) oldLength += 1;
+
+      while (newLength > newX) {
+        if (!iswspace(newCharacters[newLength-1].text)) break;
+        newLength -= 1;
+      }
+      if (newLength < width) newLength += 1;
+
+      {
+        int length = width - newX;
+        int matches[length];
+        int insertions[length];
+        int deletions[length];
+
+        findPrefixMatches(oldCharacters+oldX, NULL, oldCharacters+oldX, length, matches);
+        findPrefixMatches(oldCharacters+oldX, matches, newCharacters+newX, length, insertions);
+
+        findPrefixMatches(newCharacters+newX, NULL, newCharacters+newX, length, matches);
+        findPrefixMatches(newCharacters+newX, matches, oldCharacters+oldX, length, deletions);
+
+        while (1) {
+          int done = 1;
+          int shift = x - newX;
+
+          if (x < newLength) {
+            if (insertions[shift] == (length - shift)) {
+              column = newX;
+              count = preferences->autospeakInsertedCharacters? (x - newX): 0;
+              reason = "characters inserted after cursor";
+              goto found;
+            }
+
+            done = 0;
+          }
+
+          if (x < oldLength) {
+            if (deletions[shift] == (length - shift)) {
+              characters = oldCharacters;
+              column = oldX;
+              count = preferences->autospeakDeletedCharacters? (x - oldX): 0;
+              reason = "characters deleted after cursor";
+              goto found;
+            }
+
+            done = 0;
+          }
+
+          if (done) break;
+          x += 1;
+        }
+      }
+    }
+
+    if (oldX < 0) oldX = 0;
+    if ((newX > oldX) &&
+        isSameRowText(newCharacters, oldCharacters, oldX) &&
+        isSameRowText(newCharacters+newX, oldCharacters+oldX, width-newX)) {
+      column = oldX;
+      count = newX - oldX;
+
+      if (preferences->autospeakCompletedWords) {
+        int last = column + count - 1;
+
+        if (iswspace(characters[last].text)) {
+          int first = column;
+
+          while (first > 0) {
+            if (iswspace(characters[--first].text)) {
+              first += 1;
+              break;
+            }
+          }
+
+          if (first < column) {
+            while (last >= first) {
+              if (!iswspace(characters[last].text)) break;
+              last -= 1;
+            }
+
+            if (last > first) {
+              column = first;
+              count = last - first + 1;
+              reason = "word inserted";
+              goto found;
+            }
+          }
+        }
+      }
+
+      if (!preferences->autospeakInsertedCharacters) count = 0;
+      reason = "characters inserted before cursor";
+      goto found;
+    }
+
+    if (oldX >= width) oldX = width - 1;
+    if ((newX < oldX) &&
+        isSameRowText(newCharacters, oldCharacters, newX) &&
+        isSameRowText(newCharacters+newX, oldCharacters+oldX, width-oldX)) {
+      characters = oldCharacters;
+      column = newX;
+      count = preferences->autospeakDeletedCharacters? (oldX - newX): 0;
+      reason = "characters deleted before cursor";
+      goto found;
+    }
+  }
+
+  while (newCharacters[column].text == oldCharacters[column].text) ++column;
+  while (newCharacters[count-1].text == oldCharacters[count-1].text) --count;
+  count -= column;
+  if (!preferences->autospeakReplacedCharacters) count = 0;
+  reason = "characters replaced";
+
+found:
+  change->characters = characters;
+  change->column = column;
+  change->count = count;
+  change->reason = reason;
+}
@@ -0,0 +1,47 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2018 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_AUTOSPEAK
+#define BRLTTY_INCLUDED_AUTOSPEAK
+
+#include "scr_types.h"
+#include "prefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct {
+  const ScreenCharacter *characters;
+  int column;
+  int count;
+  const char *reason;
+} AutospeakChange;
+
+extern void findAutospeakChange (
+  AutospeakChange *change, const Preferences *preferences,
+  const ScreenCharacter *oldCharacters, int oldX,
+  const ScreenCharacter *newCharacters, int newX,
+  int width, int cursorTracked
+);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_AUTOSPEAK */
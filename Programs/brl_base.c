@@ -220,54 +220,205 @@ readBraillePacket (
   if (!endpoint) endpoint = brl->gioEndpoint;
 
   while (1) {
-    unsigned char byte;
+    const unsigned char *input;
+    size_t available = gioPeekInput(endpoint, &input, started);
+    size_t used = 0;
 
-    if (!gioReadByte(endpoint, &byte, started)) {
+    if (!available) {
       if (count > 0) logPartialPacket(bytes, count);
       return 0;
     }
 
-  gotByte:
-    started = 1;
+    while (used < available) {
+      unsigned char byte = input[used++];
 
-    if (count < size) {
-      bytes[count++] = byte;
+    gotByte:
+      started = 1;
+
+      if (count < size) {
+        bytes[count++] = byte;
+
+        {
+          BraillePacketVerifierResult result = verifyPacket(brl, bytes, count, &length, data);
+
+          switch (result) {
+            case BRL_PVR_EXCLUDE:
+              count -= 1;
+            case BRL_PVR_INCLUDE:
+              break;
+
+            default:
+              logMessage(LOG_WARNING, "unimplemented braille packet verifier result: %u", result);
+              /* fall through */
+            case BRL_PVR_INVALID:
+              started = 0;
+
+              if (--count) {
+                logShortPacket(bytes, count);
+                count = 0;
+                length = 1;
+                goto gotByte;
+              }
+
+              logIgnoredByte(byte);
+              continue;
+          }
+        }
+
+        if (count >= length) {
+          gioConsumeInput(endpoint, used);
+          logInputPacket(bytes, length);
+          return length;
+        }
+      } else {
+        if (count++ == size) logTruncatedPacket(bytes, size);
+        logDiscardedByte(byte);
+      }
+    }
+
+    gioConsumeInput(endpoint, used);
+  }
+}
+
+static size_t
+getLayoutPrefix (const BraillePacketLayout *layout) {
+  return layout->lengthSize? (layout->lengthOffset + layout->lengthSize): 0;
+}
+
+static size_t
+getLayoutLength (const BraillePacketLayout *layout, const unsigned char *bytes) {
+  size_t length = 0;
+  unsigned int index;
+
+  for (index=0; index<layout->lengthSize; index+=1) {
+    unsigned int byte = layout->lengthIsBigEndian? index: (layout->lengthSize - index - 1);
+    length = (length << 8) | bytes[layout->lengthOffset + byte];
+  }
+
+  return layout->length + length;
+}
+
+size_t
+readFormattedBraillePacket (
+  BrailleDisplay *brl,
+  GioEndpoint *endpoint,
+  void *packet, size_t size,
+  const BraillePacketFormat *format, void *data
+) {
+  unsigned char *bytes = packet;
+  size_t count = 0;
+  size_t length = 0;
+  int started = 0;
+
+  const BraillePacketLayout *layout = NULL;
+  size_t prefix = 0;
+
+  if (!endpoint) endpoint = brl->gioEndpoint;
+
+  while (1) {
+    const unsigned char *input;
+    size_t available = gioPeekInput(endpoint, &input, started);
+    const unsigned char *next = input;
+    const unsigned char *end = input + available;
+
+    if (!available) {
+      if (count > 0) logPartialPacket(bytes, MIN(count, size));
+      return 0;
+    }
+
+    while (next < end) {
+      if (!count) {
+        if (format->headerLength) {
+          /* skip to where the next packet might start */
+          const unsigned char *start = memchr(next, format->header[0], end-next);
+          if (!start) start = end;
+          while (next < start) logIgnoredByte(*next++);
+          if (next == end) break;
+        }
+
+        if (format->types) {
+          layout = NULL;
+          prefix = MAX(format->headerLength, format->typeOffset+1);
+        } else {
+          layout = &format->layout;
+          prefix = MAX(format->headerLength, getLayoutPrefix(layout));
+        }
+
+        /* the length is worked out once the first byte is in */
+        if (!prefix) prefix = 1;
+      }
+
+      started = 1;
+
+      if (count < prefix) {
+        /* the header, the type, and the length field are checked one byte at a time */
+        unsigned char byte = *next;
+
+        if ((count < format->headerLength) && (byte != format->header[count])) goto invalid;
+
+        if (format->types && (count == format->typeOffset)) {
+          if (byte >= format->typeCount) goto invalid;
+          layout = &format->types[byte];
+          if (!(layout->length || layout->lengthSize)) goto invalid;
+          prefix = MAX(prefix, getLayoutPrefix(layout));
+        }
+
+        if (count < size) bytes[count] = byte;
+        count += 1;
+        next += 1;
+
+        if (count < prefix) continue;
+        length = getLayoutLength(layout, bytes);
+        if (length < count) length = count;
+
+        /* a corrupt length mustn't swallow the packets which follow it */
+        if (layout->maximumLength && (length > layout->maximumLength)) goto invalid;
+      }
 
       {
-        BraillePacketVerifierResult result = verifyPacket(brl, bytes, count, &length, data);
+        /* the rest of the packet is taken as a block */
+        size_t amount = MIN(length-count, end-next);
 
-        switch (result) {
-          case BRL_PVR_EXCLUDE:
-            count -= 1;
-          case BRL_PVR_INCLUDE:
-            break;
+        if (count < size) memcpy(&bytes[count], next, MIN(amount, size-count));
+        count += amount;
+        next += amount;
+      }
 
-          default:
-            logMessage(LOG_WARNING, "unimplemented braille packet verifier result: %u", result);
-            /* fall through */
-          case BRL_PVR_INVALID:
-            started = 0;
-
-            if (--count) {
-              logShortPacket(bytes, count);
-              count = 0;
-              length = 1;
-              goto gotByte;
-            }
-
-            logIgnoredByte(byte);
-            continue;
+      if (count == length) {
+        if (length > size) {
+          logTruncatedPacket(bytes, size);
+        } else if ((format->hasTerminator && (next[-1] != format->terminator)) ||
+                   (format->verifyPacket && (format->verifyPacket(brl, bytes, length, &length, data) != BRL_PVR_INCLUDE))) {
+          /* the last byte might start the next packet */
+          count -= 1;
+          next -= 1;
+          goto invalid;
+        } else {
+          gioConsumeInput(endpoint, next-input);
+          logInputPacket(bytes, length);
+          return length;
         }
+
+        count = 0;
+        length = 0;
       }
 
-      if (count >= length) {
-        logInputPacket(bytes, length);
-        return length;
+      continue;
+
+    invalid:
+      started = 0;
+
+      if (count) {
+        logShortPacket(bytes, MIN(count, size));
+      } else {
+        logIgnoredByte(*next++);
       }
-    } else {
-      if (count++ == size) logTruncatedPacket(bytes, size);
-      logDiscardedByte(byte);
+
+      count = 0;
+      length = 0;
     }
+
+    gioConsumeInput(endpoint, next-input);
   }
 }
 
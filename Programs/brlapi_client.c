@@ -1741,6 +1741,57 @@ int BRLAPI_STDCALL brlapi_readKeyWithTimeout(int timeout_ms, brlapi_keyCode_t *c
   return brlapi__readKeyWithTimeout(&defaultHandle, timeout_ms, code);
 }
 
+/* Function : brlapi_readKeys */
+int BRLAPI_STDCALL brlapi__readKeys(brlapi_handle_t *handle, int timeout_ms, brlapi_keyCode_t codes[], unsigned int count)
+{
+  ssize_t res;
+  uint32_t buf[2];
+  unsigned int got = 0;
+
+  pthread_mutex_lock(&handle->state_mutex);
+  if (!(handle->state & STCONTROLLINGTTY)) {
+    pthread_mutex_unlock(&handle->state_mutex);
+    brlapi_errno = BRLAPI_ERROR_ILLEGAL_INSTRUCTION;
+    return -1;
+  }
+  pthread_mutex_unlock(&handle->state_mutex);
+
+  if (!count) return 0;
+
+  pthread_mutex_lock(&handle->read_mutex);
+  while ((handle->keybuf_nb>0) && (got<count)) {
+    codes[got++]=handle->keybuf[handle->keybuf_next];
+    handle->keybuf_next=(handle->keybuf_next+1)%BRL_KEYBUF_SIZE;
+    handle->keybuf_nb--;
+  }
+  pthread_mutex_unlock(&handle->read_mutex);
+
+  /* Only wait for the first key, then take what has already arrived */
+  pthread_mutex_lock(&handle->key_mutex);
+  while (got<count) {
+    res=brlapi__waitForPacket(handle,BRLAPI_PACKET_KEY, buf, sizeof(buf), 0, got? 0: timeout_ms);
+    if (res < 0) {
+      if (got || (res == -4) || ((res == -3) && (timeout_ms == 0))) break;
+      pthread_mutex_unlock(&handle->key_mutex);
+      if (res == -3) {
+        brlapi_libcerrno = EINTR;
+        brlapi_errno = BRLAPI_ERROR_LIBCERR;
+        brlapi_errfun = "waitForPacket";
+      }
+      return -1;
+    }
+    codes[got++] = ((brlapi_keyCode_t)ntohl(buf[0]) << 32) | ntohl(buf[1]);
+  }
+  pthread_mutex_unlock(&handle->key_mutex);
+
+  return got;
+}
+
+int BRLAPI_STDCALL brlapi_readKeys(int timeout_ms, brlapi_keyCode_t codes[], unsigned int count)
+{
+  return brlapi__readKeys(&defaultHandle, timeout_ms, codes, count);
+}
+
 int BRLAPI_STDCALL brlapi__readKey(brlapi_handle_t *handle, int block, brlapi_keyCode_t *code)
 {
   return brlapi__readKeyWithTimeout(handle, block ? -1 : 0, code);
@@ -281,21 +281,35 @@ out:
 /* Write a packet on the socket */
 ssize_t BRLAPI(writePacket)(brlapi_fileDescriptor fd, brlapi_packetType_t type, const void *buf, size_t size)
 {
-  uint32_t header[2] = { htonl(size), htonl(type) };
+  uint32_t packet[2+BRLAPI_MAXPACKETSIZE/sizeof(uint32_t)];
   ssize_t res;
 
-  /* first send packet header (size+type) */
-  if ((res=brlapi_writeFile(fd,&header[0],sizeof(header)))<0) {
-    LibcError("write in writePacket");
-    return res;
-  }
+  packet[0] = htonl(size);
+  packet[1] = htonl(type);
+
+  if (!buf) size = 0;
+
+  if (size <= BRLAPI_MAXPACKETSIZE) {
+    /* send header (size+type) and data together */
+    if (size) memcpy(&packet[2],buf,size);
+
+    if ((res=brlapi_writeFile(fd,packet,2*sizeof(uint32_t)+size))<0) {
+      LibcError("write in writePacket");
+      return res;
+    }
+  } else {
+    /* first send packet header (size+type) */
+    if ((res=brlapi_writeFile(fd,packet,2*sizeof(uint32_t)))<0) {
+      LibcError("write in writePacket");
+      return res;
+    }
 
-  /* eventually data */
-  if (size && buf)
+    /* then data */
     if ((res=brlapi_writeFile(fd,buf,size))<0) {
       LibcError("write in writePacket");
       return res;
     }
+  }
 
   return 0;
 }
@@ -71,6 +71,11 @@ Samuel Thibault <samuel.thibault@ens-lyon.org>"
 #else /* HAVE_SYS_SELECT_H */
 #include <sys/time.h>
 #endif /* HAVE_SYS_SELECT_H */
+
+#if defined(ENABLE_EPOLL_MONITORING) && defined(HAVE_SYS_EPOLL_H)
+#define SERVER_USE_EPOLL
+#include <sys/epoll.h>
+#endif /* epoll */
 #endif /* __MINGW32__ */
 
 #define BRLAPI_NO_DEPRECATED
@@ -96,6 +101,7 @@ Samuel Thibault <samuel.thibault@ens-lyon.org>"
 #include "io_misc.h"
 #include "scr.h"
 #include "charset.h"
+#include "unicode.h"
 #include "async_event.h"
 #include "async_signal.h"
 #include "thread.h"
@@ -191,6 +197,23 @@ typedef struct Connection {
   pthread_mutex_t acceptedKeysMutex;
   time_t upTime;
   Packet packet;
+
+#ifdef SERVER_USE_EPOLL
+  int polled; /* is it in serverEpoll */
+#endif /* SERVER_USE_EPOLL */
+
+#ifdef HAVE_ICONV_H
+  struct {
+    char *charset; /* the charset of the cached converter */
+    iconv_t iconv;
+  } textConverter;
+#endif /* HAVE_ICONV_H */
+
+  struct {
+    unsigned long int direct; /* converted without iconv */
+    unsigned long int cached; /* converted with the cached converter */
+    unsigned long int opened; /* converted with a new converter */
+  } textConversions;
 } Connection;
 
 typedef struct Tty {
@@ -215,6 +238,11 @@ static struct socketInfo {
 #ifdef __MINGW32__
   OVERLAPPED overl;
 #endif /* __MINGW32__ */
+
+#ifdef SERVER_USE_EPOLL
+  int polled; /* is it in serverEpoll */
+  int ready; /* did serverEpoll report it */
+#endif /* SERVER_USE_EPOLL */
 } socketInfo[SERVER_SOCKET_LIMIT]; /* information for cleaning sockets */
 
 static int serverSocketCount; /* number of sockets */
@@ -242,6 +270,13 @@ static Connection *suspendConnection = NULL;
 static Tty notty;
 static Tty ttys;
 
+#ifdef SERVER_USE_EPOLL
+/* The server thread's persistent interest list: its data points either to
+ * a Connection or to the socketInfo entry of a listening socket. */
+static int serverEpoll = -1;
+static int ttysChanged; /* whether empty ttys may need to be freed */
+#endif /* SERVER_USE_EPOLL */
+
 static unsigned int unauthConnections;
 static unsigned int unauthConnLog = 0;
 
@@ -537,6 +572,18 @@ static Connection *createConnection(FileDescriptor fd, time_t currentTime)
   c->brailleWindow.text = NULL;
   c->brailleWindow.andAttr = NULL;
   c->brailleWindow.orAttr = NULL;
+
+#ifdef SERVER_USE_EPOLL
+  c->polled = 0;
+#endif /* SERVER_USE_EPOLL */
+
+#ifdef HAVE_ICONV_H
+  c->textConverter.charset = NULL;
+  c->textConverter.iconv = (iconv_t)(-1);
+#endif /* HAVE_ICONV_H */
+
+  memset(&c->textConversions, 0, sizeof(c->textConversions));
+
   if (brlapi_initializePacket(&c->packet))
     goto outmalloc;
   return c;
@@ -557,6 +604,22 @@ static void freeConnection(Connection *c)
 {
   if (c->fd != INVALID_FILE_DESCRIPTOR) {
     if (c->auth != 1) unauthConnections--;
+
+    if (c->textConversions.direct || c->textConversions.cached || c->textConversions.opened) {
+      logMessage(LOG_CATEGORY(SERVER_EVENTS),
+                 "fd %"PRIfd" text conversions: %lu direct, %lu cached, %lu opened",
+                 c->fd, c->textConversions.direct,
+                 c->textConversions.cached, c->textConversions.opened);
+    }
+
+#ifdef SERVER_USE_EPOLL
+    if (c->polled && (serverEpoll != -1)) {
+      if (epoll_ctl(serverEpoll, EPOLL_CTL_DEL, c->fd, NULL) == -1) {
+        logSystemError("epoll_ctl[EPOLL_CTL_DEL]");
+      }
+    }
+#endif /* SERVER_USE_EPOLL */
+
     closeFileDescriptor(c->fd);
   }
 
@@ -566,6 +629,11 @@ static void freeConnection(Connection *c)
   pthread_mutex_destroy(&c->acceptedKeysMutex);
   unsetAddressName(&c->acceptedKeysMutex);
 
+#ifdef HAVE_ICONV_H
+  if (c->textConverter.iconv != (iconv_t)(-1)) iconv_close(c->textConverter.iconv);
+  if (c->textConverter.charset) free(c->textConverter.charset);
+#endif /* HAVE_ICONV_H */
+
   freeBrailleWindow(&c->brailleWindow);
   freeKeyrangeList(&c->acceptedKeys);
   free(c);
@@ -605,6 +673,10 @@ static void removeConnection(Connection *c)
 /* Removes the connection from the list and frees its resources */
 static void removeFreeConnection(Connection *c)
 {
+#ifdef SERVER_USE_EPOLL
+  if (c->tty) ttysChanged = 1;
+#endif /* SERVER_USE_EPOLL */
+
   removeConnection(c);
   freeConnection(c);
 }
@@ -628,6 +700,11 @@ static inline Tty *newTty(Tty *father, int number)
   if ((tty->next = father->subttys))
     tty->next->prevnext = &tty->next;
   father->subttys = tty;
+
+#ifdef SERVER_USE_EPOLL
+  ttysChanged = 1;
+#endif /* SERVER_USE_EPOLL */
+
   return tty;
 
 outtty:
@@ -824,6 +901,11 @@ static void doLeaveTty(Connection *c)
   Tty *tty = c->tty;
   logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" releasing tty %#010x",c->fd,tty->number);
   c->tty = NULL;
+
+#ifdef SERVER_USE_EPOLL
+  ttysChanged = 1;
+#endif /* SERVER_USE_EPOLL */
+
   lockMutex(&apiConnectionsMutex);
   __removeConnection(c);
   __addConnection(c,notty.connections);
@@ -868,6 +950,190 @@ static int handleKeyRanges(Connection *c, brlapi_packetType_t type, brlapi_packe
   return 0;
 }
 
+static int isCharsetNamed(const char *charset, const char *const *names)
+{
+  while (*names) {
+    if (strcasecmp(charset, *names) == 0) return 1;
+    names += 1;
+  }
+
+  return 0;
+}
+
+static int isLatin1Charset(const char *charset)
+{
+  static const char *const names[] = {
+    "ISO-8859-1", "ISO8859-1", "ISO_8859-1", "LATIN1", NULL
+  };
+
+  return isCharsetNamed(charset, names);
+}
+
+static int isUtf8Charset(const char *charset)
+{
+  static const char *const names[] = {
+    "UTF-8", "UTF8", NULL
+  };
+
+  return isCharsetNamed(charset, names);
+}
+
+#ifdef HAVE_ICONV_H
+/* Function : getTextConverter */
+/* Returns the connection's converter from the given charset to wchar_t, */
+/* only opening a new one when the client switches to another charset */
+static iconv_t getTextConverter(Connection *c, const char *charset)
+{
+  if (c->textConverter.iconv != (iconv_t)(-1)) {
+    if (strcmp(charset, c->textConverter.charset) == 0) {
+      c->textConversions.cached += 1;
+      return c->textConverter.iconv;
+    }
+
+    iconv_close(c->textConverter.iconv);
+    c->textConverter.iconv = (iconv_t)(-1);
+
+    free(c->textConverter.charset);
+    c->textConverter.charset = NULL;
+  }
+
+  {
+    iconv_t conv = iconv_open(getWcharCharset(), charset);
+    if (conv == (iconv_t)(-1)) return conv;
+    c->textConversions.opened += 1;
+
+    if ((c->textConverter.charset = strdup(charset))) {
+      c->textConverter.iconv = conv;
+    } else {
+      /* still usable for this write (the caller closes it), just not cached */
+      logMallocError();
+    }
+
+    return conv;
+  }
+}
+#endif /* HAVE_ICONV_H */
+
+/* Function : getUtf8Character */
+/* Decodes one well-formed UTF-8 sequence: truncated and overlong */
+/* sequences, 5 and 6 byte forms, surrogates, and values beyond U+10FFFF */
+/* are all rejected */
+static int getUtf8Character(const unsigned char **text, size_t *size, wchar_t *character)
+{
+  const unsigned char *byte = *text;
+  uint32_t value = *byte;
+  uint32_t minimum;
+  size_t length;
+  size_t i;
+
+  if (!(value & 0X80)) {
+    length = 1;
+    minimum = 0;
+  } else if ((value & 0XE0) == 0XC0) {
+    length = 2;
+    minimum = 0X80;
+    value &= 0X1F;
+  } else if ((value & 0XF0) == 0XE0) {
+    length = 3;
+    minimum = 0X800;
+    value &= 0X0F;
+  } else if ((value & 0XF8) == 0XF0) {
+    length = 4;
+    minimum = 0X10000;
+    value &= 0X07;
+  } else {
+    return 0;
+  }
+
+  if (*size < length) return 0;
+
+  for (i=1; i<length; i++) {
+    if ((byte[i] & 0XC0) != 0X80) return 0;
+    value = (value << 6) | (byte[i] & 0X3F);
+  }
+
+  if (value < minimum) return 0;
+  if (value > UNICODE_LAST_CHARACTER) return 0;
+  if ((value >= UNICODE_SURROGATE_BEGIN) && (value <= UNICODE_SURROGATE_END)) return 0;
+  if (value > WCHAR_MAX) value = UNICODE_REPLACEMENT_CHARACTER;
+
+  *character = value;
+  *text += length;
+  *size -= length;
+  return 1;
+}
+
+/* Function : convertText */
+/* Converts the text of a write request to wchar_t, without iconv for */
+/* latin1 (also assumed when no charset is known) and well-formed UTF-8 */
+/* Returns 1 on success, 0 on a conversion error, and -1 if the charset */
+/* isn't supported; *left is set to the number of unconverted bytes and */
+/* *count to the number of characters produced */
+static int convertText(
+  Connection *c, const char *charset,
+  const unsigned char *text, size_t size,
+  wchar_t *characters, size_t limit,
+  size_t *left, size_t *count
+) {
+  if (!charset || isLatin1Charset(charset)) {
+    size_t i;
+
+    *count = MIN(size, limit);
+    for (i=0; i<*count; i++) characters[i] = text[i];
+
+    *left = size - *count;
+    c->textConversions.direct += 1;
+    return 1;
+  }
+
+  if (isUtf8Charset(charset)) {
+    const unsigned char *in = text;
+    size_t sin = size;
+
+    *count = 0;
+
+    while (sin && (*count < limit)) {
+      if (!getUtf8Character(&in, &sin, &characters[*count])) break;
+      *count += 1;
+    }
+
+    if (!sin || (*count == limit)) {
+      *left = sin;
+      c->textConversions.direct += 1;
+      return 1;
+    }
+
+    /* let iconv decide what to do with anything else so that the result */
+    /* doesn't depend on which path converted the text */
+#ifndef HAVE_ICONV_H
+    return 0;
+#endif /* HAVE_ICONV_H */
+  }
+
+#ifdef HAVE_ICONV_H
+  {
+    iconv_t conv = getTextConverter(c, charset);
+
+    if (conv != (iconv_t)(-1)) {
+      char *in = (char *) text, *out = (char *) characters;
+      size_t sin = size, sout = limit * sizeof(*characters);
+      size_t res;
+
+      iconv(conv, NULL, NULL, NULL, NULL); /* reset the shift state */
+      res = iconv(conv, &in, &sin, &out, &sout);
+      if (conv != c->textConverter.iconv) iconv_close(conv);
+      if ((res == (size_t) -1) && (errno != E2BIG)) return 0;
+
+      *left = sin;
+      *count = limit - (sout / sizeof(*characters));
+      return 1;
+    }
+  }
+#endif /* HAVE_ICONV_H */
+
+  return -1;
+}
+
 static int handleWrite(Connection *c, brlapi_packetType_t type, brlapi_packet_t *packet, size_t size)
 {
   brlapi_writeArgumentsPacket_t *wa = &packet->writeArguments;
@@ -879,7 +1145,7 @@ static int handleWrite(Connection *c, brlapi_packetType_t type, brlapi_packet_t
   char *charset = NULL;
   unsigned int charsetLen = 0;
 #ifdef HAVE_ICONV_H
-  char *coreCharset = NULL;
+  char coreCharset[0X80];
 #endif /* HAVE_ICONV_H */
   CHECKEXC(remaining>=sizeof(wa->flags), BRLAPI_ERROR_INVALID_PACKET, "packet too small for flags");
   CHECKERR(!c->raw,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed in raw mode");
@@ -954,47 +1220,44 @@ static int handleWrite(Connection *c, brlapi_packetType_t type, brlapi_packet_t
   CHECKEXC(remaining==0, BRLAPI_ERROR_INVALID_PACKET, "packet too big");
   /* Here the whole packet has been checked */
   if (text) {
+    wchar_t textBuf[rsiz];
+    size_t left, count;
+    int res;
+
     if (charset) {
       charset[charsetLen] = 0; /* we have room for this */
-#ifndef HAVE_ICONV_H
-      CHECKEXC(!strcasecmp(charset, "iso-8859-1"), BRLAPI_ERROR_OPNOTSUPP, "charset conversion not supported (enable iconv?)");
-#endif /* !HAVE_ICONV_H */
+      logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" charset %s",c->fd,charset);
     }
 #ifdef HAVE_ICONV_H
     else {
+      /* only hold the lock long enough to copy the name */
       lockCharset(0);
-      charset = coreCharset = (char *) getCharset();
-      if (!coreCharset) {
-        unlockCharset();
+      {
+        const char *name = getCharset();
+
+        if (name) {
+          snprintf(coreCharset, sizeof(coreCharset), "%s", name);
+          charset = coreCharset;
+        }
       }
+      unlockCharset();
     }
-    if (charset) {
-      iconv_t conv;
-      wchar_t textBuf[rsiz];
-      char *in = (char *) text, *out = (char *) textBuf;
-      size_t sin = textLen, sout = sizeof(textBuf), res;
-      logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" charset %s",c->fd,charset);
-      CHECKEXC((conv = iconv_open(getWcharCharset(),charset)) != (iconv_t)(-1), BRLAPI_ERROR_INVALID_PACKET, "invalid charset");
-      res = iconv(conv,&in,&sin,&out,&sout);
-      iconv_close(conv);
-      CHECKEXC(res != (size_t) -1, BRLAPI_ERROR_INVALID_PACKET, "invalid charset conversion");
-      CHECKEXC(!sin, BRLAPI_ERROR_INVALID_PACKET, "text too big");
-      CHECKEXC(!sout, BRLAPI_ERROR_INVALID_PACKET, "text too small");
-      if (coreCharset) unlockCharset();
-      lockMutex(&c->brailleWindowMutex);
-      memcpy(c->brailleWindow.text+rbeg-1,textBuf,rsiz*sizeof(wchar_t));
-      logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" wrote %d characters %d bytes",c->fd,rsiz,textLen);
-    } else
 #endif /* HAVE_ICONV_H */
-    {
-      int i;
-      lockMutex(&c->brailleWindowMutex);
-      for (i=0; i<rsiz; i++) {
-	/* assume latin1 */
-        c->brailleWindow.text[rbeg-1+i] = text[i];
-      }
-      logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" wrote %d characters %d bytes",c->fd,rsiz,rsiz);
-    }
+
+    res = convertText(c, charset, text, textLen, textBuf, rsiz, &left, &count);
+#ifdef HAVE_ICONV_H
+    CHECKEXC(res != -1, BRLAPI_ERROR_INVALID_PACKET, "invalid charset");
+#else /* HAVE_ICONV_H */
+    CHECKEXC(res != -1, BRLAPI_ERROR_OPNOTSUPP, "charset conversion not supported (enable iconv?)");
+#endif /* HAVE_ICONV_H */
+    CHECKEXC(res, BRLAPI_ERROR_INVALID_PACKET, "invalid charset conversion");
+    CHECKEXC(!left, BRLAPI_ERROR_INVALID_PACKET, "text too big");
+    CHECKEXC(count == rsiz, BRLAPI_ERROR_INVALID_PACKET, "text too small");
+
+    lockMutex(&c->brailleWindowMutex);
+    memcpy(c->brailleWindow.text+rbeg-1,textBuf,rsiz*sizeof(wchar_t));
+    logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" wrote %d characters %d bytes",c->fd,rsiz,textLen);
+
     if (!andAttr) memset(c->brailleWindow.andAttr+rbeg-1,0xFF,rsiz);
     if (!orAttr)  memset(c->brailleWindow.orAttr+rbeg-1,0x00,rsiz);
   } else lockMutex(&c->brailleWindowMutex);
@@ -2022,6 +2285,136 @@ static void handleTtyFds(fd_set *fds, time_t currentTime, Tty *tty) {
   }
 }
 
+#ifdef SERVER_USE_EPOLL
+/* Function: startServerEpoll */
+/* creates the server's interest list, the select() loop is used if it fails */
+static void startServerEpoll(void) {
+  int i;
+
+  if ((serverEpoll = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+    logSystemError("epoll_create1");
+  }
+
+  ttysChanged = 0;
+
+  for (i=0;i<serverSocketCount;i++) {
+    socketInfo[i].polled = 0;
+    socketInfo[i].ready = 0;
+  }
+}
+
+/* Function: stopServerEpoll */
+static void stopServerEpoll(void) {
+  if (serverEpoll != -1) {
+    close(serverEpoll);
+    serverEpoll = -1;
+  }
+}
+
+/* Function: pollServerDescriptor */
+/* adds a listening socket or a connection to the interest list */
+static int pollServerDescriptor(FileDescriptor fd, void *data) {
+  struct epoll_event event = {
+    .events = EPOLLIN,
+    .data.ptr = data
+  };
+
+  if (epoll_ctl(serverEpoll, EPOLL_CTL_ADD, fd, &event) != -1) return 1;
+  logSystemError("epoll_ctl[EPOLL_CTL_ADD]");
+  return 0;
+}
+
+/* Function: pollServerSockets */
+/* adds the listening sockets which have been created since the last call */
+static void pollServerSockets(void) {
+  int i;
+
+  for (i=0;i<serverSocketCount;i++) {
+    struct socketInfo *info = &socketInfo[i];
+
+    if ((info->fd >= 0) && !info->polled) {
+      if (pollServerDescriptor(info->fd, info)) info->polled = 1;
+    }
+  }
+}
+
+/* Function: getServerSocketInfo */
+/* returns the socketInfo entry referred to by an event, or NULL if the */
+/* event is for a connection */
+static struct socketInfo *getServerSocketInfo(const struct epoll_event *event) {
+  const struct socketInfo *info = event->data.ptr;
+
+  if ((info >= socketInfo) && (info < (socketInfo + serverSocketCount))) {
+    return (struct socketInfo *)info;
+  }
+
+  return NULL;
+}
+
+/* Function: pruneTtys */
+/* recursively frees ttys which have neither connections nor children */
+static void pruneTtys(Tty *tty) {
+  {
+    Tty *t,*next;
+    for (t = tty->subttys; t; t = next) {
+      next = t->next;
+      pruneTtys(t);
+    }
+  }
+
+  if (tty!=&ttys && tty!=&notty
+      && tty->connections->next == tty->connections && !tty->subttys) {
+    logMessage(LOG_CATEGORY(SERVER_EVENTS), "freeing tty %#010x",tty->number);
+    lockMutex(&apiConnectionsMutex);
+    removeTty(tty);
+    freeTty(tty);
+    unlockMutex(&apiConnectionsMutex);
+  }
+}
+
+/* Function: expireUnauthConnections */
+/* unauthenticated connections never leave notty, so only it needs a scan */
+static void expireUnauthConnections(time_t currentTime) {
+  Connection *c,*next;
+
+  for (c = notty.connections->next; c != notty.connections; c = next) {
+    next = c->next;
+
+    if ((c->auth != 1) && ((currentTime - c->upTime) > UNAUTH_TIMEOUT)) {
+      removeFreeConnection(c);
+    }
+  }
+}
+
+/* Function: handleEpollConnections */
+/* handles the connections which are ready, i.e. without scanning them all */
+static void handleEpollConnections(const struct epoll_event *events, int count, time_t currentTime) {
+  static time_t lastExpiryCheck = 0;
+  const struct epoll_event *event = events;
+  const struct epoll_event *end = event + count;
+
+  while (event < end) {
+    if (!getServerSocketInfo(event)) {
+      Connection *c = event->data.ptr;
+
+      if (processRequest(c, &packetHandlers)) removeFreeConnection(c);
+    }
+
+    event += 1;
+  }
+
+  if (unauthConnections && (currentTime != lastExpiryCheck)) {
+    lastExpiryCheck = currentTime;
+    expireUnauthConnections(currentTime);
+  }
+
+  if (ttysChanged) {
+    ttysChanged = 0;
+    pruneTtys(&ttys);
+  }
+}
+#endif /* SERVER_USE_EPOLL */
+
 #ifndef __MINGW32__
 static sigset_t blockedSignalsMask;
 
@@ -2086,6 +2479,11 @@ THREAD_FUNCTION(runServer) {
   int nbHandles = 0;
 #else /* __MINGW32__ */
   int fdmax;
+
+#ifdef SERVER_USE_EPOLL
+  struct epoll_event events[0X40];
+  int eventCount = 0;
+#endif /* SERVER_USE_EPOLL */
 #endif /* __MINGW32__ */
 
   logMessage(LOG_CATEGORY(SERVER_EVENTS), "server thread started");
@@ -2181,6 +2579,10 @@ THREAD_FUNCTION(runServer) {
   unauthConnections = 0;
   unauthConnLog = 0;
 
+#ifdef SERVER_USE_EPOLL
+  startServerEpoll();
+#endif /* SERVER_USE_EPOLL */
+
   while (running) {
 #ifdef __MINGW32__
     lpHandles = malloc(nbAlloc * sizeof(*lpHandles));
@@ -2214,42 +2616,65 @@ THREAD_FUNCTION(runServer) {
 
     free(lpHandles);
 #else /* __MINGW32__ */
-    /* Compute sockets set and fdmax */
-    FD_ZERO(&sockset);
-    fdmax=0;
+#ifdef SERVER_USE_EPOLL
+    if (serverEpoll != -1) {
+      int timeout;
 
-    lockMutex(&apiConnectionsMutex);
-    addTtyFds(&sockset, &fdmax, &notty);
-    addTtyFds(&sockset, &fdmax, &ttys);
-    unlockMutex(&apiConnectionsMutex);
+      lockMutex(&serverSocketsMutex);
+        pollServerSockets();
+        timeout = (unauthConnections || serverSocketsPending)? SERVER_SELECT_TIMEOUT*1000: -1;
+      unlockMutex(&serverSocketsMutex);
 
+      if ((eventCount = epoll_wait(serverEpoll, events, ARRAY_COUNT(events), timeout)) == -1) {
+        if (errno == EINTR) continue;
+        logSystemError("epoll_wait");
+        break;
+      }
+
+      for (i=0;i<eventCount;i++) {
+        struct socketInfo *info = getServerSocketInfo(&events[i]);
+        if (info) info->ready = 1;
+      }
+    } else
+#endif /* SERVER_USE_EPOLL */
     {
-      struct timeval tv, *timeout;
+      /* Compute sockets set and fdmax */
+      FD_ZERO(&sockset);
+      fdmax=0;
 
-      lockMutex(&serverSocketsMutex);
-	for (i=0;i<serverSocketCount;i++) {
-	  if (socketInfo[i].fd>=0) {
-	    FD_SET(socketInfo[i].fd, &sockset);
+      lockMutex(&apiConnectionsMutex);
+      addTtyFds(&sockset, &fdmax, &notty);
+      addTtyFds(&sockset, &fdmax, &ttys);
+      unlockMutex(&apiConnectionsMutex);
 
-	    if (socketInfo[i].fd>fdmax) {
-	      fdmax = socketInfo[i].fd;
+      {
+        struct timeval tv, *timeout;
+
+        lockMutex(&serverSocketsMutex);
+	  for (i=0;i<serverSocketCount;i++) {
+	    if (socketInfo[i].fd>=0) {
+	      FD_SET(socketInfo[i].fd, &sockset);
+
+	      if (socketInfo[i].fd>fdmax) {
+	        fdmax = socketInfo[i].fd;
+	      }
 	    }
 	  }
-	}
 
-        if (unauthConnections || serverSocketsPending) {
-          memset(&tv, 0, sizeof(tv));
-          tv.tv_sec = SERVER_SELECT_TIMEOUT;
-          timeout = &tv;
-        } else {
-          timeout = NULL;
-        }
-      unlockMutex(&serverSocketsMutex);
+          if (unauthConnections || serverSocketsPending) {
+            memset(&tv, 0, sizeof(tv));
+            tv.tv_sec = SERVER_SELECT_TIMEOUT;
+            timeout = &tv;
+          } else {
+            timeout = NULL;
+          }
+        unlockMutex(&serverSocketsMutex);
 
-      if (select(fdmax+1, &sockset, NULL, NULL, timeout) < 0) {
-        if (fdmax==0) continue; /* still no server socket */
-        logMessage(LOG_WARNING,"select: %s",strerror(errno));
-        break;
+        if (select(fdmax+1, &sockset, NULL, NULL, timeout) < 0) {
+          if (fdmax==0) continue; /* still no server socket */
+          logMessage(LOG_WARNING,"select: %s",strerror(errno));
+          break;
+        }
       }
     }
 #endif /* __MINGW32__ */
@@ -2280,7 +2705,20 @@ THREAD_FUNCTION(runServer) {
             logWindowsSystemError("ResetEvent in server loop");
           }
 #else /* __MINGW32__ */
-      if (socketInfo[i].fd>=0 && FD_ISSET(socketInfo[i].fd, &sockset)) {
+#ifdef SERVER_USE_EPOLL
+      int ready;
+
+      if (serverEpoll != -1) {
+        ready = socketInfo[i].ready;
+        socketInfo[i].ready = 0;
+      } else {
+        ready = (socketInfo[i].fd>=0) && FD_ISSET(socketInfo[i].fd, &sockset);
+      }
+#else /* SERVER_USE_EPOLL */
+      int ready = (socketInfo[i].fd>=0) && FD_ISSET(socketInfo[i].fd, &sockset);
+#endif /* SERVER_USE_EPOLL */
+
+      if (ready) {
 #endif /* __MINGW32__ */
           addrlen = sizeof(addr);
           resfd = (FileDescriptor)accept((SocketDescriptor)socketInfo[i].fd, (struct sockaddr *) &addr, &addrlen);
@@ -2318,6 +2756,11 @@ THREAD_FUNCTION(runServer) {
           if (c==NULL) {
             logMessage(LOG_WARNING,"Failed to create connection structure");
             closeFileDescriptor(resfd);
+#ifdef SERVER_USE_EPOLL
+          } else if ((serverEpoll != -1) && !(c->polled = pollServerDescriptor(resfd, c))) {
+            unauthConnections++;
+            freeConnection(c);
+#endif /* SERVER_USE_EPOLL */
           } else {
 	    unauthConnections++;
 	    addConnection(c, notty.connections);
@@ -2327,10 +2770,21 @@ THREAD_FUNCTION(runServer) {
       }
     }
 
+#ifdef SERVER_USE_EPOLL
+    if (serverEpoll != -1) {
+      handleEpollConnections(events, eventCount, currentTime);
+      continue;
+    }
+#endif /* SERVER_USE_EPOLL */
+
     handleTtyFds(&sockset,currentTime,&notty);
     handleTtyFds(&sockset,currentTime,&ttys);
   }
 
+#ifdef SERVER_USE_EPOLL
+  stopServerEpoll();
+#endif /* SERVER_USE_EPOLL */
+
   running = 0;
 #ifdef __MINGW32__
   pthread_cleanup_pop(1);
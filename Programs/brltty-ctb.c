@@ -34,6 +34,7 @@
 #include "ascii.h"
 #include "ttb.h"
 #include "ctb.h"
+#include "thread.h"
 
 static char *opt_tablesDirectory;
 static char *opt_contractionTable;
@@ -42,6 +43,7 @@ static char *opt_verificationTable;
 static int opt_reformatText;
 static char *opt_outputWidth;
 static int opt_forceOutput;
+static char *opt_jobCount;
 
 BEGIN_OPTION_TABLE(programOptions)
   { .letter = 'T',
@@ -95,6 +97,14 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.flag = &opt_forceOutput,
     .description = strtext("Force immediate output.")
   },
+
+  { .letter = 'j',
+    .word = "jobs",
+    .argument = strtext("count"),
+    .setting.string = &opt_jobCount,
+    .internal.setting = "1",
+    .description = strtext("Number of threads to translate with.")
+  },
 END_OPTION_TABLE
 
 static wchar_t *inputBuffer;
@@ -102,9 +112,9 @@ static size_t inputSize;
 static size_t inputLength;
 
 static FILE *outputStream;
-static unsigned char *outputBuffer;
 static int outputWidth;
 static int outputExtend;
+static int jobCount;
 
 #define VERIFICATION_TABLE_EXTENSION ".cvb"
 #define VERIFICATION_SUBTABLE_EXTENSION ".cvi"
@@ -116,10 +126,98 @@ static FILE *verificationTableStream;
 static int (*processInputCharacters) (const wchar_t *characters, size_t length, void *data);
 static int (*putCell) (unsigned char cell, void *data);
 
+typedef struct TranslationJobStruct TranslationJob;
+
 typedef struct {
   ProgramExitStatus exitStatus;
+  ContractionContext *contractionContext;
+
+  struct {
+    unsigned char *cells;
+    int width;
+  } braille;
+
+  TranslationJob *job; /* the one being translated by a pool thread */
 } LineProcessingData;
 
+typedef struct {
+  char *bytes;
+  size_t size;
+  size_t length;
+} OutputText;
+
+static int
+appendOutputText (OutputText *text, const void *bytes, size_t count) {
+  size_t newLength = text->length + count;
+
+  if (newLength > text->size) {
+    size_t newSize = MAX(newLength, (text->size << 1)) | 0XFF;
+    char *newBytes = realloc(text->bytes, newSize);
+
+    if (!newBytes) return 0;
+    text->bytes = newBytes;
+    text->size = newSize;
+  }
+
+  memcpy(&text->bytes[text->length], bytes, count);
+  text->length = newLength;
+  return 1;
+}
+
+#ifdef GOT_PTHREADS
+#define TRANSLATION_JOBS_PER_THREAD 0X10
+
+struct TranslationJobStruct {
+  TranslationJob *next;
+
+  const wchar_t *characters;
+  size_t length;
+
+  OutputText translation; /* written by the thread which translates it */
+  OutputText trailer; /* what the main thread writes after it */
+
+  ProgramExitStatus exitStatus;
+  unsigned finished:1;
+};
+
+typedef struct {
+  pthread_t thread;
+  LineProcessingData lpd;
+} TranslationThread;
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t added;
+  pthread_cond_t finished;
+
+  TranslationThread *threads;
+  unsigned int threadCount;
+
+  TranslationJob *first;
+  TranslationJob *last;
+  TranslationJob *unclaimed;
+  unsigned int pending;
+
+  unsigned stop:1;
+} translationPool = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .added = PTHREAD_COND_INITIALIZER,
+  .finished = PTHREAD_COND_INITIALIZER
+};
+#endif /* GOT_PTHREADS */
+
+static OutputText *
+getOutputText (LineProcessingData *lpd) {
+#ifdef GOT_PTHREADS
+  if (lpd->job) return &lpd->job->translation;
+
+  /* anything else has to wait for the translations which are still queued */
+  if (translationPool.last) return &translationPool.last->trailer;
+#endif /* GOT_PTHREADS */
+
+  return NULL;
+}
+
 static void
 noMemory (void *data) {
   LineProcessingData *lpd = data;
@@ -141,16 +239,37 @@ checkOutputStream (void *data) {
   return 1;
 }
 
+static int
+writeOutputStream (const void *bytes, size_t count, void *data) {
+  fwrite(bytes, 1, count, outputStream);
+  return checkOutputStream(data);
+}
+
+static int
+writeOutput (const void *bytes, size_t count, void *data) {
+  OutputText *text = getOutputText(data);
+
+  if (text) {
+    if (appendOutputText(text, bytes, count)) return 1;
+    noMemory(data);
+    return 0;
+  }
+
+  return writeOutputStream(bytes, count, data);
+}
+
+static int writeTranslatedJobs (unsigned int limit, void *data);
+
 static int
 flushOutputStream (void *data) {
+  if (!writeTranslatedJobs(0, data)) return 0;
   fflush(outputStream);
   return checkOutputStream(data);
 }
 
 static int
 putCharacter (unsigned char character, void *data) {
-  fputc(character, outputStream);
-  return checkOutputStream(data);
+  return writeOutput(&character, 1, data);
 }
 
 static int
@@ -158,8 +277,7 @@ putCellCharacter (wchar_t character, void *data) {
   Utf8Buffer utf8;
   size_t utfs = convertWcharToUtf8(character, utf8);
 
-  fprintf(outputStream, "%.*s", (int)utfs, utf8);
-  return checkOutputStream(data);
+  return writeOutput(utf8, utfs, data);
 }
 
 static int
@@ -173,35 +291,36 @@ putBrailleCell (unsigned char cell, void *data) {
 }
 
 static int
-writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
+translateCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
+  LineProcessingData *lpd = data;
   const wchar_t *inputBuffer = inputLine;
 
   while (inputLength) {
     int inputCount = inputLength;
-    int outputCount = outputWidth;
+    int outputCount = lpd->braille.width;
 
-    if (!outputBuffer) {
-      if (!(outputBuffer = malloc(outputWidth))) {
+    if (!lpd->braille.cells) {
+      if (!(lpd->braille.cells = malloc(lpd->braille.width))) {
         noMemory(data);
         return 0;
       }
     }
 
-    contractText(contractionTable,
-                 inputBuffer, &inputCount,
-                 outputBuffer, &outputCount,
-                 NULL, CTB_NO_CURSOR);
+    contractTextInContext(lpd->contractionContext,
+                          inputBuffer, &inputCount,
+                          lpd->braille.cells, &outputCount,
+                          NULL, CTB_NO_CURSOR);
 
     if ((inputCount < inputLength) && outputExtend) {
-      free(outputBuffer);
-      outputBuffer = NULL;
-      outputWidth <<= 1;
+      free(lpd->braille.cells);
+      lpd->braille.cells = NULL;
+      lpd->braille.width <<= 1;
     } else {
       {
         int index;
 
         for (index=0; index<outputCount; index+=1)
-          if (!putCell(outputBuffer[index], data))
+          if (!putCell(lpd->braille.cells[index], data))
             return 0;
       }
 
@@ -217,6 +336,221 @@ writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
   return 1;
 }
 
+#ifdef GOT_PTHREADS
+THREAD_FUNCTION(runTranslationThread) {
+  TranslationThread *thread = argument;
+  LineProcessingData *lpd = &thread->lpd;
+
+  pthread_mutex_lock(&translationPool.mutex);
+
+  while (1) {
+    TranslationJob *job = translationPool.unclaimed;
+
+    if (!job) {
+      if (translationPool.stop) break;
+      pthread_cond_wait(&translationPool.added, &translationPool.mutex);
+      continue;
+    }
+
+    translationPool.unclaimed = job->next;
+    pthread_mutex_unlock(&translationPool.mutex);
+
+    lpd->exitStatus = PROG_EXIT_SUCCESS;
+    lpd->job = job;
+    translateCharacters(job->characters, job->length, lpd);
+    lpd->job = NULL;
+    job->exitStatus = lpd->exitStatus;
+
+    pthread_mutex_lock(&translationPool.mutex);
+    job->finished = 1;
+    pthread_cond_signal(&translationPool.finished);
+  }
+
+  pthread_mutex_unlock(&translationPool.mutex);
+  return NULL;
+}
+
+static void
+deallocateTranslationJob (TranslationJob *job) {
+  if (job->translation.bytes) free(job->translation.bytes);
+  if (job->trailer.bytes) free(job->trailer.bytes);
+  free(job);
+}
+
+static int
+addTranslationJob (const wchar_t *characters, size_t length, void *data) {
+  TranslationJob *job;
+
+  /* the translator looks one character beyond the end */
+  if (!(job = malloc(sizeof(*job) + ARRAY_SIZE(characters, length+1)))) {
+    noMemory(data);
+    return 0;
+  }
+
+  memset(job, 0, sizeof(*job));
+  job->next = NULL;
+
+  {
+    wchar_t *buffer = (wchar_t *)(job + 1);
+
+    wmemcpy(buffer, characters, length);
+    buffer[length] = 0;
+
+    job->characters = buffer;
+    job->length = length;
+  }
+
+  job->exitStatus = PROG_EXIT_SUCCESS;
+  job->finished = 0;
+
+  pthread_mutex_lock(&translationPool.mutex);
+
+  if (translationPool.last) {
+    translationPool.last->next = job;
+  } else {
+    translationPool.first = job;
+  }
+
+  translationPool.last = job;
+  translationPool.pending += 1;
+  if (!translationPool.unclaimed) translationPool.unclaimed = job;
+
+  pthread_cond_signal(&translationPool.added);
+  pthread_mutex_unlock(&translationPool.mutex);
+
+  return writeTranslatedJobs(translationPool.threadCount * TRANSLATION_JOBS_PER_THREAD, data);
+}
+
+static TranslationJob *
+removeTranslationJob (void) {
+  TranslationJob *job = translationPool.first;
+
+  pthread_mutex_lock(&translationPool.mutex);
+  if (!(translationPool.first = job->next)) translationPool.last = NULL;
+  translationPool.pending -= 1;
+  pthread_mutex_unlock(&translationPool.mutex);
+
+  return job;
+}
+
+static void
+stopTranslationThreads (void) {
+  if (translationPool.threadCount) {
+    pthread_mutex_lock(&translationPool.mutex);
+    translationPool.stop = 1;
+    pthread_cond_broadcast(&translationPool.added);
+    pthread_mutex_unlock(&translationPool.mutex);
+
+    while (translationPool.threadCount) {
+      TranslationThread *thread = &translationPool.threads[--translationPool.threadCount];
+
+      pthread_join(thread->thread, NULL);
+      destroyContractionContext(thread->lpd.contractionContext);
+      if (thread->lpd.braille.cells) free(thread->lpd.braille.cells);
+    }
+
+    free(translationPool.threads);
+    translationPool.threads = NULL;
+  }
+
+  while (translationPool.first) deallocateTranslationJob(removeTranslationJob());
+}
+
+static int
+startTranslationThreads (unsigned int count) {
+  if (!(translationPool.threads = calloc(count, sizeof(*translationPool.threads)))) {
+    logMallocError();
+    return 0;
+  }
+
+  translationPool.stop = 0;
+
+  while (translationPool.threadCount < count) {
+    TranslationThread *thread = &translationPool.threads[translationPool.threadCount];
+
+    thread->lpd.exitStatus = PROG_EXIT_SUCCESS;
+    thread->lpd.braille.cells = NULL;
+    thread->lpd.braille.width = outputWidth;
+    thread->lpd.job = NULL;
+    if (!(thread->lpd.contractionContext = newContractionContext(contractionTable))) break;
+
+    {
+      int error = createThread("ctb-translator", &thread->thread, NULL,
+                               runTranslationThread, thread);
+
+      if (error) {
+        logActionError(error, "pthread_create");
+        destroyContractionContext(thread->lpd.contractionContext);
+        break;
+      }
+    }
+
+    translationPool.threadCount += 1;
+  }
+
+  if (translationPool.threadCount < count) {
+    stopTranslationThreads();
+    return 0;
+  }
+
+  return 1;
+}
+#endif /* GOT_PTHREADS */
+
+/* Translations are written in the order they were queued. Those which have
+ * finished are written right away, but only as many as the limit may remain
+ * queued.
+ */
+static int
+writeTranslatedJobs (unsigned int limit, void *data) {
+#ifdef GOT_PTHREADS
+  while (translationPool.first) {
+    TranslationJob *job = translationPool.first;
+    int finished;
+
+    pthread_mutex_lock(&translationPool.mutex);
+
+    while (!job->finished && (translationPool.pending > limit)) {
+      pthread_cond_wait(&translationPool.finished, &translationPool.mutex);
+    }
+
+    finished = job->finished;
+    pthread_mutex_unlock(&translationPool.mutex);
+    if (!finished) break;
+
+    {
+      LineProcessingData *lpd = data;
+      int ok = 1;
+
+      removeTranslationJob();
+
+      if (job->exitStatus != PROG_EXIT_SUCCESS) {
+        lpd->exitStatus = job->exitStatus;
+        ok = 0;
+      } else if (job->translation.length && !writeOutputStream(job->translation.bytes, job->translation.length, data)) {
+        ok = 0;
+      } else if (job->trailer.length && !writeOutputStream(job->trailer.bytes, job->trailer.length, data)) {
+        ok = 0;
+      }
+
+      deallocateTranslationJob(job);
+      if (!ok) return 0;
+    }
+  }
+#endif /* GOT_PTHREADS */
+
+  return 1;
+}
+
+static int
+writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
+#ifdef GOT_PTHREADS
+  if (translationPool.threadCount) return addTranslationJob(inputLine, inputLength, data);
+#endif /* GOT_PTHREADS */
+
+  return translateCharacters(inputLine, inputLength, data);
+}
+
 static int
 flushCharacters (wchar_t end, void *data) {
   if (inputLength) {
@@ -455,7 +789,6 @@ main (int argc, char *argv[]) {
   inputLength = 0;
 
   outputStream = stdout;
-  outputBuffer = NULL;
 
   if ((outputExtend = !*opt_outputWidth)) {
     outputWidth = 0X80;
@@ -468,6 +801,23 @@ main (int argc, char *argv[]) {
     }
   }
 
+  {
+    static const int minimum = 1;
+    static const int maximum = 0X100;
+
+    if (!validateInteger(&jobCount, opt_jobCount, &minimum, &maximum)) {
+      logMessage(LOG_ERR, "%s: %s", "invalid job count", opt_jobCount);
+      return PROG_EXIT_SYNTAX;
+    }
+
+#ifndef GOT_PTHREADS
+    if (jobCount > 1) {
+      logMessage(LOG_WARNING, "threads not supported - translating serially");
+      jobCount = 1;
+    }
+#endif /* GOT_PTHREADS */
+  }
+
   {
     char *contractionTablePath;
 
@@ -510,7 +860,15 @@ main (int argc, char *argv[]) {
             exitStatus = processVerificationTable();
           } else {
             LineProcessingData lpd = {
-              .exitStatus = PROG_EXIT_SUCCESS
+              .exitStatus = PROG_EXIT_SUCCESS,
+              .contractionContext = newContractionContext(contractionTable),
+
+              .braille = {
+                .cells = NULL,
+                .width = outputWidth
+              },
+
+              .job = NULL
             };
 
             const InputFilesProcessingParameters parameters = {
@@ -521,11 +879,34 @@ main (int argc, char *argv[]) {
               }
             };
 
-            if ((exitStatus = processInputFiles(argv, argc, &parameters)) == PROG_EXIT_SUCCESS) {
-              if (!(flushCharacters('\n', &lpd) && flushOutputStream(&lpd))) {
-                exitStatus = lpd.exitStatus;
+            if (!lpd.contractionContext) {
+              exitStatus = PROG_EXIT_FATAL;
+            }
+
+#ifdef GOT_PTHREADS
+            if (exitStatus == PROG_EXIT_SUCCESS) {
+              if ((jobCount > 1) && (processInputCharacters == writeContractedBraille)) {
+                if (!startTranslationThreads(jobCount)) {
+                  exitStatus = PROG_EXIT_FATAL;
+                }
               }
             }
+#endif /* GOT_PTHREADS */
+
+            if (exitStatus == PROG_EXIT_SUCCESS) {
+              if ((exitStatus = processInputFiles(argv, argc, &parameters)) == PROG_EXIT_SUCCESS) {
+                if (!(flushCharacters('\n', &lpd) && flushOutputStream(&lpd))) {
+                  exitStatus = lpd.exitStatus;
+                }
+              }
+            }
+
+#ifdef GOT_PTHREADS
+            stopTranslationThreads();
+#endif /* GOT_PTHREADS */
+
+            if (lpd.contractionContext) destroyContractionContext(lpd.contractionContext);
+            if (lpd.braille.cells) free(lpd.braille.cells);
           }
 
           if (textTable) destroyTextTable(textTable);
@@ -553,7 +934,6 @@ main (int argc, char *argv[]) {
     verificationTablePath = NULL;
   }
 
-  if (outputBuffer) free(outputBuffer);
   if (inputBuffer) free(inputBuffer);
   return exitStatus;
 }
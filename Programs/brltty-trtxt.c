@@ -30,12 +30,14 @@
 #include "charset.h"
 #include "brl_dots.h"
 #include "ttb.h"
+#include "timing.h"
 
 static char *opt_tablesDirectory;
 static char *opt_inputTable;
 static char *opt_outputTable;
 static int opt_sixDots;
 static int opt_noBaseCharacters;
+static int opt_reportThroughput;
 
 static const char tableName_autoselect[] = "auto";
 static const char tableName_unicode[] = "unicode";
@@ -82,6 +84,12 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.flag = &opt_noBaseCharacters,
     .description = strtext("Don't fall back to the Unicode base character.")
   },
+
+  { .letter = 's',
+    .word = "statistics",
+    .setting.flag = &opt_reportThroughput,
+    .description = strtext("Report the throughput when done.")
+  },
 END_OPTION_TABLE
 
 static TextTable *inputTable;
@@ -115,20 +123,238 @@ toCharacter_unicode (unsigned char dots) {
   return UNICODE_BRAILLE_ROW | dots;
 }
 
+#define INPUT_BUFFER_SIZE 0X10000
+#define OUTPUT_BUFFER_SIZE 0X10000
+#define CHARACTER_MAP_SIZE 0X10000
+
+static wchar_t characterMap[CHARACTER_MAP_SIZE];
+static Utf8Buffer asciiTranslations[0X80];
+static unsigned char asciiTranslationLengths[0X80];
+
+static char outputBuffer[OUTPUT_BUFFER_SIZE];
+static size_t outputLength;
+
+static struct {
+  unsigned long long int bytes;
+  unsigned long long int characters;
+} inputTotals;
+
+static wchar_t
+translateCharacter (wchar_t character) {
+  if (!iswcntrl(character)) {
+    unsigned char dots = toDots(character);
+
+    if (dots || !iswspace(character)) {
+      if (opt_sixDots) dots &= ~(BRL_DOT_7 | BRL_DOT_8);
+      character = toCharacter(dots);
+    }
+  }
+
+  return character;
+}
+
+static inline wchar_t
+getTranslatedCharacter (wchar_t character) {
+  if ((uint32_t)character < CHARACTER_MAP_SIZE) {
+    wchar_t *translated = &characterMap[character];
+
+    /* only a null character translates to 0, and it's cheap to redo */
+    if (!*translated) *translated = translateCharacter(character);
+    return *translated;
+  }
+
+  return translateCharacter(character);
+}
+
+static void
+prepareAsciiTranslations (void) {
+  unsigned int character;
+
+  for (character=0; character<ARRAY_COUNT(asciiTranslations); character+=1) {
+    asciiTranslationLengths[character] = convertWcharToUtf8(getTranslatedCharacter(character), asciiTranslations[character]);
+  }
+}
+
+static int
+flushOutput (void) {
+  if (outputLength) {
+    fwrite(outputBuffer, 1, outputLength, outputStream);
+    outputLength = 0;
+    if (ferror(outputStream)) return 0;
+  }
+
+  return 1;
+}
+
+static inline int
+ensureOutputSpace (size_t size) {
+  if ((sizeof(outputBuffer) - outputLength) < size) return flushOutput();
+  return 1;
+}
+
+static inline void
+putAsciiTranslation (unsigned char character) {
+  memcpy(&outputBuffer[outputLength], asciiTranslations[character], UTF8_LEN_MAX);
+  outputLength += asciiTranslationLengths[character];
+}
+
+/* Returns 1 if a character was decoded, 0 if the sequence is incomplete,
+ * and -1 if it's invalid. What's accepted is the same as what mbrtowc()
+ * accepts in a UTF-8 locale: overlong forms and surrogates are rejected.
+ */
+static int
+decodeUtf8Character (const unsigned char **bytes, const unsigned char *end, wchar_t *character) {
+  const unsigned char *byte = *bytes;
+  unsigned char lead = *byte++;
+  unsigned int count;
+  uint32_t value;
+  uint32_t minimum;
+
+  if (lead < 0XC2) {
+    return -1;
+  } else if (lead < 0XE0) {
+    count = 1;
+    value = lead & 0X1F;
+    minimum = 0X80;
+  } else if (lead < 0XF0) {
+    count = 2;
+    value = lead & 0X0F;
+    minimum = 0X800;
+  } else if (lead < 0XF8) {
+    count = 3;
+    value = lead & 0X07;
+    minimum = 0X10000;
+  } else if (lead < 0XFC) {
+    count = 4;
+    value = lead & 0X03;
+    minimum = 0X200000;
+  } else if (lead < 0XFE) {
+    count = 5;
+    value = lead & 0X01;
+    minimum = 0X4000000;
+  } else {
+    return -1;
+  }
+
+  while (count) {
+    if (byte == end) return 0;
+    if ((*byte & 0XC0) != 0X80) return -1;
+
+    value = (value << 6) | (*byte++ & 0X3F);
+    count -= 1;
+  }
+
+  if (value < minimum) return -1;
+  if ((value >= 0XD800) && (value <= 0XDFFF)) return -1;
+
+  *character = value;
+  *bytes = byte;
+  return 1;
+}
+
+static int
+processUtf8Stream (FILE *inputStream, const char *inputName) {
+  static unsigned char inputBuffer[INPUT_BUFFER_SIZE];
+  size_t carried = 0;
+
+  while (1) {
+    size_t inputCount = fread(&inputBuffer[carried], 1, sizeof(inputBuffer)-carried, inputStream);
+
+    if (ferror(inputStream)) goto inputError;
+    if (!inputCount) break;
+    inputTotals.bytes += inputCount;
+
+    {
+      const unsigned char *byte = inputBuffer;
+      const unsigned char *end = byte + carried + inputCount;
+
+      while (byte < end) {
+        if (!ensureOutputSpace(8 * UTF8_LEN_MAX)) goto outputError;
+
+        if (!(*byte & 0X80)) {
+          /* translate runs of ASCII characters eight at a time */
+          if ((end - byte) >= 8) {
+            uint64_t bytes;
+
+            memcpy(&bytes, byte, sizeof(bytes));
+
+            if (!(bytes & UINT64_C(0X8080808080808080))) {
+              const unsigned char *next = byte + 8;
+
+              while (byte < next) putAsciiTranslation(*byte++);
+              inputTotals.characters += 8;
+              continue;
+            }
+          }
+
+          putAsciiTranslation(*byte++);
+          inputTotals.characters += 1;
+        } else {
+          wchar_t character;
+          int result = decodeUtf8Character(&byte, end, &character);
+
+          if (!result) break;
+
+          if (result < 0) {
+#ifdef EILSEQ
+            errno = EILSEQ;
+#else /* EILSEQ */
+            errno = EINVAL;
+#endif /* EILSEQ */
+            goto inputError;
+          }
+
+          outputLength += convertWcharToUtf8(getTranslatedCharacter(character), &outputBuffer[outputLength]);
+          inputTotals.characters += 1;
+        }
+      }
+
+      carried = end - byte;
+      memmove(inputBuffer, byte, carried);
+    }
+  }
+
+  if (!flushOutput()) goto outputError;
+  fflush(outputStream);
+  if (ferror(outputStream)) goto outputError;
+
+  if (carried) {
+#ifdef EILSEQ
+    errno = EILSEQ;
+#else /* EILSEQ */
+    errno = EINVAL;
+#endif /* EILSEQ */
+    goto inputError;
+  }
+
+  return 1;
+
+inputError:
+  logMessage(LOG_ERR, "input error: %s: %s", inputName, strerror(errno));
+  flushOutput();
+  return 0;
+
+outputError:
+  logMessage(LOG_ERR, "output error: %s: %s", outputName, strerror(errno));
+  return 0;
+}
+
 static int
-writeCharacter (const wchar_t *character, mbstate_t *state) {
-  char bytes[0X1000];
-  size_t result = wcrtomb(bytes, (character? *character: WC_C('\0')), state);
+putMultibyteCharacter (const wchar_t *character, mbstate_t *state) {
+  size_t result;
+
+  if (!ensureOutputSpace(MB_CUR_MAX)) return 0;
+  result = wcrtomb(&outputBuffer[outputLength], (character? *character: WC_C('\0')), state);
 
   if (result == (size_t)-1) return 0;
   if (!character) result -= 1;
 
-  fwrite(bytes, 1, result, outputStream);
-  return !ferror(outputStream);
+  outputLength += result;
+  return 1;
 }
 
 static int
-processStream (FILE *inputStream, const char *inputName) {
+processMultibyteStream (FILE *inputStream, const char *inputName) {
   mbstate_t inputState;
   memset(&inputState, 0, sizeof(inputState));
 
@@ -136,12 +362,13 @@ processStream (FILE *inputStream, const char *inputName) {
   memset(&outputState, 0, sizeof(outputState));
 
   while (!feof(inputStream)) {
-    char inputBuffer[0X1000];
+    static char inputBuffer[INPUT_BUFFER_SIZE];
     size_t inputCount = fread(inputBuffer, 1, sizeof(inputBuffer)-1, inputStream);
 
     if (ferror(inputStream)) goto inputError;
     if (!inputCount) break;
     inputBuffer[inputCount] = 0;
+    inputTotals.bytes += inputCount;
 
     {
       char *byte = inputBuffer;
@@ -160,21 +387,16 @@ processStream (FILE *inputStream, const char *inputName) {
           inputCount -= result;
         }
 
-        if (!iswcntrl(character)) {
-          unsigned char dots = toDots(character);
+        character = getTranslatedCharacter(character);
+        inputTotals.characters += 1;
 
-          if (dots || !iswspace(character)) {
-            if (opt_sixDots) dots &= ~(BRL_DOT_7 | BRL_DOT_8);
-            character = toCharacter(dots);
-          }
-        }
-
-        if (!writeCharacter(&character, &outputState)) goto outputError;
+        if (!putMultibyteCharacter(&character, &outputState)) goto outputError;
       }
     }
   }
 
-  if (!writeCharacter(NULL, &outputState)) goto outputError;
+  if (!putMultibyteCharacter(NULL, &outputState)) goto outputError;
+  if (!flushOutput()) goto outputError;
   fflush(outputStream);
   if (ferror(outputStream)) goto outputError;
 
@@ -191,13 +413,37 @@ processStream (FILE *inputStream, const char *inputName) {
 
 inputError:
   logMessage(LOG_ERR, "input error: %s: %s", inputName, strerror(errno));
+  flushOutput();
   return 0;
 
 outputError:
   logMessage(LOG_ERR, "output error: %s: %s", outputName, strerror(errno));
+  flushOutput();
   return 0;
 }
 
+static int (*processStream) (FILE *inputStream, const char *inputName);
+
+static int
+isUtf8Locale (void) {
+  const char *charset = getLocaleCharset();
+
+  return (strcasecmp(charset, "UTF-8") == 0) ||
+         (strcasecmp(charset, "UTF8") == 0);
+}
+
+static void
+reportThroughput (const TimeValue *start) {
+  long int elapsed = getMonotonicElapsed(start);
+  double seconds = (double)MAX(elapsed, 1) / MSECS_PER_SEC;
+
+  logMessage(LOG_NOTICE,
+             "%llu bytes, %llu characters, %ld ms: %.1f MB/s, %.0f characters/s",
+             inputTotals.bytes, inputTotals.characters, elapsed,
+             ((double)inputTotals.bytes / 1000000.0 / seconds),
+             ((double)inputTotals.characters / seconds));
+}
+
 static int
 getTable (TextTable **table, const char *name) {
   const char *directory = opt_tablesDirectory;
@@ -252,6 +498,16 @@ main (int argc, char *argv[]) {
       toDots = inputTable? toDots_mapped: toDots_unicode;
       toCharacter = outputTable? toCharacter_mapped: toCharacter_unicode;
 
+      if (isUtf8Locale()) {
+        processStream = processUtf8Stream;
+        prepareAsciiTranslations();
+      } else {
+        processStream = processMultibyteStream;
+      }
+
+      TimeValue start;
+      getMonotonicTime(&start);
+
       if (argc) {
         do {
           const char *file = argv[0];
@@ -277,6 +533,8 @@ main (int argc, char *argv[]) {
         exitStatus = PROG_EXIT_SUCCESS;
       }
 
+      if (opt_reportThroughput) reportThroughput(&start);
+
       if (outputTable) destroyTextTable(outputTable);
     }
 
@@ -25,10 +25,12 @@
 #include <locale.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include "parameters.h"
 #include "embed.h"
 #include "log.h"
+#include "log_history.h"
 #include "report.h"
 #include "strfmt.h"
 #include "activity.h"
@@ -155,6 +157,9 @@ static int opt_noDaemon;
 static int opt_standardError;
 static char *opt_logLevel;
 static char *opt_logFile;
+static char *opt_logFlushInterval;
+static int logFlushInterval = 0;
+static char *opt_logHistorySize;
 static int opt_bootParameters = 1;
 static int opt_environmentVariables;
 static char *opt_messageHoldTimeout;
@@ -197,6 +202,7 @@ char *opt_attributesTable;
 #ifdef ENABLE_CONTRACTED_BRAILLE
 char *opt_contractionTable;
 ContractionTable *contractionTable = NULL;
+static char *opt_contractionCache;
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
 char *opt_keyboardTable;
@@ -483,6 +489,14 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.string = &opt_contractionTable,
     .description = strtext("Name of or path to contraction table.")
   },
+
+  { .letter = 'z',
+    .word = "contraction-cache",
+    .flags = OPT_Hidden | OPT_Config | OPT_Environ,
+    .argument = strtext("lines,kbytes"),
+    .setting.string = &opt_contractionCache,
+    .description = strtext("How many lines, and how many kilobytes, of contracted braille to cache.")
+  },
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
   { .letter = 'k',
@@ -614,6 +628,22 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Path to log file.")
   },
 
+  { .letter = 'G',
+    .word = "log-flush",
+    .flags = OPT_Hidden | OPT_Config | OPT_Environ,
+    .argument = strtext("msecs"),
+    .setting.string = &opt_logFlushInterval,
+    .description = strtext("Log file flush interval (in milliseconds) - 0 writes each record immediately.")
+  },
+
+  { .letter = 'J',
+    .word = "log-history",
+    .flags = OPT_Hidden | OPT_Config | OPT_Environ,
+    .argument = strtext("count"),
+    .setting.string = &opt_logHistorySize,
+    .description = strtext("Maximum number of messages to keep in the log message history.")
+  },
+
   { .letter = 'v',
     .word = "verify",
     .setting.flag = &opt_verify,
@@ -750,7 +780,28 @@ brlttyPrepare (int argc, char *argv[]) {
   setLogLevels();
   onProgramExit("log", exitLog, NULL);
 
+  if (*opt_logHistorySize) {
+    static const int minimum = 1;
+    int size;
+
+    if (validateInteger(&size, opt_logHistorySize, &minimum, NULL)) {
+      setLogMessageHistorySize(size);
+    } else {
+      logMessage(LOG_ERR, "%s: %s", gettext("invalid log history size"), opt_logHistorySize);
+    }
+  }
+
   if (*opt_logFile) {
+    if (*opt_logFlushInterval) {
+      static const int minimum = 0;
+
+      if (!validateInteger(&logFlushInterval, opt_logFlushInterval, &minimum, NULL)) {
+        logMessage(LOG_ERR, "%s: %s", gettext("invalid log flush interval"), opt_logFlushInterval);
+        logFlushInterval = 0;
+      }
+    }
+
+    setLogFileFlushInterval(logFlushInterval);
     openLogFile(opt_logFile);
   } else {
     openSystemLog();
@@ -2579,6 +2630,9 @@ brlttyStart (void) {
 #endif
      ) {
     background();
+
+    /* the log file writer isn't inherited by a child process */
+    setLogFileFlushInterval(logFlushInterval);
   }
 
   if (*opt_pidFile) {
@@ -2697,6 +2751,36 @@ brlttyStart (void) {
   onProgramExit("attributes-table", exitAttributesTable, NULL);
 
 #ifdef ENABLE_CONTRACTED_BRAILLE
+  if (*opt_contractionCache) {
+    int count;
+    char **limits = splitString(opt_contractionCache, ',', &count);
+
+    if (limits) {
+      static const int minimum = 0;
+      static const int maximumKilobytes = INT_MAX / 0X400;
+
+      int entries = CONTRACTION_CACHE_ENTRY_LIMIT;
+      int kilobytes = CONTRACTION_CACHE_SIZE_LIMIT / 0X400;
+      int ok = count <= 2;
+
+      if (ok && (count > 0) && *limits[0]) {
+        if (!validateInteger(&entries, limits[0], &minimum, NULL)) ok = 0;
+      }
+
+      if (ok && (count > 1) && *limits[1]) {
+        if (!validateInteger(&kilobytes, limits[1], &minimum, &maximumKilobytes)) ok = 0;
+      }
+
+      if (ok) {
+        setContractionCacheLimits(entries, kilobytes * 0X400);
+      } else {
+        logMessage(LOG_ERR, "%s: %s", gettext("invalid contraction cache limits"), opt_contractionCache);
+      }
+
+      deallocateStrings(limits);
+    }
+  }
+
   /* handle contraction table option */
   onProgramExit("contraction-table", exitContractionTable, NULL);
   if (*opt_contractionTable) changeContractionTable(opt_contractionTable);
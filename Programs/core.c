@@ -1075,6 +1075,23 @@ getContractedLength (unsigned int outputLimit) {
                NULL, getContractedCursor());
   return inputLength;
 }
+
+void
+prefetchContractedRow (int row, unsigned int outputLimit) {
+  if (!canPrefetchContractedText(contractionTable)) return;
+
+  if ((row >= 0) && (row < scr.rows)) {
+    int inputLength = scr.cols - ses->winx;
+    wchar_t inputBuffer[inputLength];
+
+    int cursorOffset = ((scr.posy == row) && (scr.posx >= ses->winx) && (scr.posx < scr.cols) && !ses->hideScreenCursor)?
+                       (scr.posx - ses->winx):
+                       CTB_NO_CURSOR;
+
+    readScreenText(ses->winx, row, inputLength, 1, inputBuffer);
+    prefetchContractedText(contractionTable, inputBuffer, inputLength, outputLimit, cursorOffset);
+  }
+}
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
 int
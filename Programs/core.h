@@ -134,6 +134,7 @@ extern int isContracting (void);
 extern int getUncontractedCursorOffset (int x, int y);
 extern int getContractedCursor (void);
 extern int getContractedLength (unsigned int outputLimit);
+extern void prefetchContractedRow (int row, unsigned int outputLimit);
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
 extern ContractionTable *contractionTable;
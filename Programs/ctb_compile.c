@@ -29,6 +29,7 @@
 #include "ctb_internal.h"
 #include "datafile.h"
 #include "dataarea.h"
+#include "tblcache.h"
 #include "brl_dots.h"
 #include "hostcmd.h"
 
@@ -531,45 +532,69 @@ static DATA_OPERANDS_PROCESSOR(processContractionTableOperands) {
 }
 
 static void
-initializeCommonFields (ContractionTable *table) {
-  table->characters.array = NULL;
-  table->characters.size = 0;
-  table->characters.count = 0;
-
-  table->cache.input.characters = NULL;
-  table->cache.input.size = 0;
-  table->cache.input.count = 0;
+initializeContractionContext (ContractionContext *context, ContractionTable *table) {
+  context->table = table;
 
-  table->cache.output.cells = NULL;
-  table->cache.output.size = 0;
-  table->cache.output.count = 0;
+  context->characters.array = NULL;
+  context->characters.size = 0;
+  context->characters.count = 0;
 
-  table->cache.offsets.array = NULL;
-  table->cache.offsets.size = 0;
-  table->cache.offsets.count = 0;
+  context->cache.newest = NULL;
+  context->cache.oldest = NULL;
+  context->cache.count = 0;
+  context->cache.size = 0;
 }
 
 static void
-destroyCommonFields (ContractionTable *table) {
-  if (table->characters.array) {
-    free(table->characters.array);
-    table->characters.array = NULL;
+clearContractionContext (ContractionContext *context) {
+  if (context->characters.array) {
+    free(context->characters.array);
+    context->characters.array = NULL;
   }
 
-  if (table->cache.input.characters) {
-    free(table->cache.input.characters);
-    table->cache.input.characters = NULL;
-  }
+  context->characters.size = 0;
+  context->characters.count = 0;
 
-  if (table->cache.output.cells) {
-    free(table->cache.output.cells);
-    table->cache.output.cells = NULL;
+  while (context->cache.newest) {
+    ContractionCacheEntry *entry = context->cache.newest;
+
+    context->cache.newest = entry->older;
+    free(entry);
   }
 
-  if (table->cache.offsets.array) {
-    free(table->cache.offsets.array);
-    table->cache.offsets.array = NULL;
+  context->cache.oldest = NULL;
+  context->cache.count = 0;
+  context->cache.size = 0;
+}
+
+ContractionContext *
+newContractionContext (ContractionTable *table) {
+  ContractionContext *context;
+
+  if ((context = malloc(sizeof(*context)))) {
+    initializeContractionContext(context, table);
+    return context;
+  } else {
+    logMallocError();
   }
+
+  return NULL;
+}
+
+void
+destroyContractionContext (ContractionContext *context) {
+  clearContractionContext(context);
+  free(context);
+}
+
+static void
+initializeCommonFields (ContractionTable *table) {
+  initializeContractionContext(&table->context, table);
+}
+
+static void
+destroyCommonFields (ContractionTable *table) {
+  clearContractionContext(&table->context);
 }
 
 static void
@@ -577,7 +602,12 @@ destroyContractionTable_native (ContractionTable *table) {
   destroyCommonFields(table);
 
   if (table->data.internal.size) {
-    free(table->data.internal.header.fields);
+    if (table->data.internal.fromCache) {
+      releaseTableCacheImage(table->data.internal.header.fields, table->data.internal.size);
+    } else {
+      free(table->data.internal.header.fields);
+    }
+
     free(table);
   }
 }
@@ -586,9 +616,56 @@ static const ContractionTableManagementMethods nativeManagementMethods = {
   .destroy = destroyContractionTable_native
 };
 
+static ContractionTable *
+newContractionTable_native (ContractionTableHeader *header, size_t size) {
+  ContractionTable *table;
+
+  if ((table = malloc(sizeof(*table)))) {
+    memset(table, 0, sizeof(*table));
+
+    table->managementMethods = &nativeManagementMethods;
+    table->translationMethods = getContractionTableTranslationMethods_native();
+    initializeCommonFields(table);
+
+    table->data.internal.header.fields = header;
+    table->data.internal.size = size;
+  } else {
+    logMallocError();
+  }
+
+  return table;
+}
+
+static ContractionTable *
+loadContractionTable_native (TableCache *cache) {
+  size_t size;
+  void *image = loadTableCacheImage(cache, &size);
+
+  if (image) {
+    ContractionTable *table = newContractionTable_native(image, size);
+
+    if (table) {
+      table->data.internal.fromCache = 1;
+      return table;
+    }
+
+    releaseTableCacheImage(image, size);
+  }
+
+  return NULL;
+}
+
 static ContractionTable *
 compileContractionTable_native (const char *fileName) {
   ContractionTable *table = NULL;
+  TableCache *cache = beginTableCache(CONTRACTION_TABLE_EXTENSION, fileName, sizeof(ContractionTableHeader));
+
+  if (cache) {
+    if ((table = loadContractionTable_native(cache))) {
+      endTableCache(cache);
+      return table;
+    }
+  }
 
   if (setTableDataVariables(CONTRACTION_TABLE_EXTENSION, CONTRACTION_SUBTABLE_EXTENSION)) {
     ContractionTableData ctd;
@@ -618,16 +695,9 @@ compileContractionTable_native (const char *fileName) {
 
           if (processDataFile(fileName, &parameters)) {
             if (saveCharacterTable(&ctd)) {
-              if ((table = malloc(sizeof(*table)))) {
-                table->managementMethods = &nativeManagementMethods;
-                table->translationMethods = getContractionTableTranslationMethods_native();
-                initializeCommonFields(table);
-
-                table->data.internal.header.fields = getContractionTableHeader(&ctd);
-                table->data.internal.size = getDataSize(ctd.area);
+              if ((table = newContractionTable_native(getContractionTableHeader(&ctd), getDataSize(ctd.area)))) {
                 resetDataArea(ctd.area);
-              } else {
-                logMallocError();
+                if (cache) saveTableCacheImage(cache, table->data.internal.header.bytes, table->data.internal.size);
               }
             }
           }
@@ -642,6 +712,7 @@ compileContractionTable_native (const char *fileName) {
     if (ctd.characterTable) free(ctd.characterTable);
   }
 
+  if (cache) endTableCache(cache);
   return table;
 }
 
@@ -661,6 +732,8 @@ startContractionCommand (ContractionTable *table) {
     logMessage(LOG_DEBUG, "external contraction table started: %s", table->data.external.command);
 
     table->data.external.commandStarted = 1;
+    table->data.external.protocolOffered = 0;
+    table->data.external.binaryProtocol = 0;
   }
 
   return 1;
@@ -675,6 +748,18 @@ stopContractionCommand (ContractionTable *table) {
     logMessage(LOG_DEBUG, "external contraction table stopped: %s", table->data.external.command);
     table->data.external.commandStarted = 0;
   }
+
+  discardContractionPrefetches(table);
+}
+
+void
+discardContractionPrefetches (ContractionTable *table) {
+  while (table->data.external.prefetch.count) {
+    ExternalPrefetchEntry *entry = &table->data.external.prefetch.entries[--table->data.external.prefetch.count];
+
+    free(entry->request);
+    if (entry->response) free(entry->response);
+  }
 }
 
 static void
@@ -704,6 +789,8 @@ compileContractionTable_external (const char *fileName) {
       initializeCommonFields(table);
 
       table->data.external.commandStarted = 0;
+      table->data.external.requestIdentifier = 0;
+      table->data.external.prefetch.count = 0;
 
       table->data.external.input.buffer = NULL;
       table->data.external.input.size = 0;
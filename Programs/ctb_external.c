@@ -20,6 +20,7 @@
 
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "log.h"
 #include "ctb_translate.h"
@@ -27,6 +28,34 @@
 #include "file.h"
 #include "parse.h"
 #include "charset.h"
+#include "thread.h"
+
+/* The binary protocol is offered by sending protocol=binary along with the
+ * first textual request. A command which supports it says so by including
+ * protocol=binary in its response to that request. From then on, each
+ * request and each response is a frame of big-endian 32-bit integers whose
+ * first integer is the number of bytes which follow it:
+ *
+ * request: length, identifier, cursor position (1-based, or 0 if none),
+ *          expand current word, capitalization mode, maximum length,
+ *          character count, characters (Unicode code points)
+ *
+ * response: length, identifier, consumed length (or 0 if all),
+ *           offset count, cell count, offsets, cells (one byte each)
+ *
+ * The identifier lets a command have a second request in flight. Text which
+ * is likely to be needed soon (e.g. the next line) is sent ahead of time, and
+ * a response which arrives while waiting for another one is kept until that
+ * text is asked for. Any other response is skipped. Responses are only read
+ * when text is contracted, so nothing more is sent ahead of time until the
+ * previous such response has been read - otherwise a command whose output
+ * is never read could fill its pipe and then block us when we write to it.
+ */
+#define EXTERNAL_PROTOCOL_BINARY "binary"
+#define EXTERNAL_FRAME_SIZE_LIMIT 0X100000
+
+/* there's only one command per table so requests can't overlap */
+static CriticalSectionLock commandLock = CRITICAL_SECTION_LOCK_INITIALIZER;
 
 static int
 putExternalRequests (BrailleContractionData *bcd) {
@@ -84,6 +113,11 @@ putExternalRequests (BrailleContractionData *bcd) {
   FILE *stream = bcd->table->data.external.standardInput;
   const ExternalRequestEntry *req = externalRequestTable;
 
+  if (!bcd->table->data.external.protocolOffered) {
+    if (fputs("protocol=" EXTERNAL_PROTOCOL_BINARY "\n", stream) == EOF) goto outputError;
+    bcd->table->data.external.protocolOffered = 1;
+  }
+
   while (req->name) {
     if (fputs(req->name, stream) == EOF) goto outputError;
     if (fputc('=', stream) == EOF) goto outputError;
@@ -226,6 +260,16 @@ handleExternalResponse_consumedLength (BrailleContractionData *bcd, const char *
   return 1;
 }
 
+static int
+setExternalOutputOffset (BrailleContractionData *bcd, unsigned int index, int offset, int *previous) {
+  if (offset < ((index == 0)? 0: *previous)) return 0;
+  if (offset >= getOutputCount(bcd)) return 0;
+
+  bcd->input.offsets[index] = (offset == *previous)? CTB_NO_OFFSET: offset;
+  *previous = offset;
+  return 1;
+}
+
 static int
 handleExternalResponse_outputOffsets (BrailleContractionData *bcd, const char *value) {
   if (bcd->input.offsets) {
@@ -258,17 +302,22 @@ handleExternalResponse_outputOffsets (BrailleContractionData *bcd, const char *v
         }
       }
 
-      if (offset < ((index == 0)? 0: previous)) return 0;
-      if (offset >= getOutputCount(bcd)) return 0;
-
-      bcd->input.offsets[index++] = (offset == previous)? CTB_NO_OFFSET: offset;
-      previous = offset;
+      if (!setExternalOutputOffset(bcd, index++, offset, &previous)) return 0;
     }
   }
 
   return 1;
 }
 
+static int
+handleExternalResponse_protocol (BrailleContractionData *bcd, const char *value) {
+  if (strcmp(value, EXTERNAL_PROTOCOL_BINARY) != 0) return 0;
+
+  bcd->table->data.external.binaryProtocol = 1;
+  logMessage(LOG_DEBUG, "external contraction protocol: %s: %s", bcd->table->data.external.command, value);
+  return 1;
+}
+
 typedef struct {
   const char *name;
   int (*handler) (BrailleContractionData *bcd, const char *value);
@@ -289,6 +338,10 @@ static const ExternalResponseEntry externalResponseTable[] = {
     .handler = handleExternalResponse_outputOffsets
   },
 
+  { .name = "protocol",
+    .handler = handleExternalResponse_protocol
+  },
+
   { .name = NULL }
 };
 
@@ -329,13 +382,274 @@ getExternalResponses (BrailleContractionData *bcd) {
   return 0;
 }
 
+static void
+putExternalInteger (unsigned char **bytes, uint32_t value) {
+  unsigned char *byte = *bytes;
+
+  *byte++ = value >> 24;
+  *byte++ = value >> 16;
+  *byte++ = value >> 8;
+  *byte++ = value;
+
+  *bytes = byte;
+}
+
+static uint32_t
+getExternalInteger (const unsigned char **bytes) {
+  const unsigned char *byte = *bytes;
+  uint32_t value = 0;
+
+  value |= *byte++ << 24;
+  value |= *byte++ << 16;
+  value |= *byte++ << 8;
+  value |= *byte++;
+
+  *bytes = byte;
+  return value;
+}
+
+static inline size_t
+getBinaryExternalRequestSize (BrailleContractionData *bcd) {
+  return (5 + getInputCount(bcd)) * 4;
+}
+
+static void
+makeBinaryExternalRequest (BrailleContractionData *bcd, unsigned char *request) {
+  unsigned int count = getInputCount(bcd);
+  unsigned char *byte = request;
+
+  putExternalInteger(&byte, bcd->input.cursor? bcd->input.cursor-bcd->input.begin+1: 0);
+  putExternalInteger(&byte, prefs.expandCurrentWord);
+  putExternalInteger(&byte, prefs.capitalizationMode);
+  putExternalInteger(&byte, getOutputCount(bcd));
+  putExternalInteger(&byte, count);
+
+  {
+    const wchar_t *character = bcd->input.begin;
+    const wchar_t *end = character + count;
+
+    while (character < end) putExternalInteger(&byte, *character++);
+  }
+}
+
 static int
-contractText_external (BrailleContractionData *bcd) {
+putBinaryExternalRequest (BrailleContractionData *bcd, const unsigned char *request, size_t size) {
+  FILE *stream = bcd->table->data.external.standardInput;
+  unsigned char header[2 * 4];
+  unsigned char *byte = header;
+
+  putExternalInteger(&byte, size + 4);
+  putExternalInteger(&byte, ++bcd->table->data.external.requestIdentifier);
+
+  if (fwrite(header, 1, sizeof(header), stream) != sizeof(header)) goto outputError;
+  if (fwrite(request, 1, size, stream) != size) goto outputError;
+  if (fflush(stream) == EOF) goto outputError;
+  return 1;
+
+outputError:
+  logMessage(LOG_WARNING, "external contraction output error: %s: %s", bcd->table->data.external.command, strerror(errno));
+  return 0;
+}
+
+static int
+handleBinaryExternalResponse (BrailleContractionData *bcd, const unsigned char *byte, size_t length) {
+  const unsigned char *end = byte + length;
+  uint32_t consumed;
+  uint32_t offsetCount;
+  uint32_t cellCount;
+
+  if (length < (3 * 4)) return 0;
+  consumed = getExternalInteger(&byte);
+  offsetCount = getExternalInteger(&byte);
+  cellCount = getExternalInteger(&byte);
+
+  if (offsetCount > ((end - byte) / 4)) return 0;
+  if (cellCount != ((end - byte) - (offsetCount * 4))) return 0;
+
+  if (consumed) {
+    if (consumed > getInputCount(bcd)) return 0;
+    bcd->input.current = bcd->input.begin + consumed;
+  }
+
+  if (bcd->input.offsets) {
+    unsigned int count = MIN(offsetCount, getInputCount(bcd));
+    unsigned int index = 0;
+    int previous = CTB_NO_OFFSET;
+
+    while (index < count) {
+      uint32_t offset = getExternalInteger(&byte);
+
+      if (offset > INT_MAX) return 0;
+      if (!setExternalOutputOffset(bcd, index++, offset, &previous)) return 0;
+    }
+
+    byte += (offsetCount - count) * 4;
+  } else {
+    byte += offsetCount * 4;
+  }
+
+  {
+    size_t count = MIN(cellCount, (bcd->output.end - bcd->output.current));
+
+    memcpy(bcd->output.current, byte, count);
+    bcd->output.current += count;
+  }
+
+  return 1;
+}
+
+static ExternalPrefetchEntry *
+findExternalPrefetch (ContractionTable *table, const unsigned char *request, size_t size) {
+  ExternalPrefetchEntry *entry = table->data.external.prefetch.entries;
+  const ExternalPrefetchEntry *end = entry + table->data.external.prefetch.count;
+
+  while (entry < end) {
+    if ((entry->requestSize == size) && (memcmp(entry->request, request, size) == 0)) return entry;
+    entry += 1;
+  }
+
+  return NULL;
+}
+
+static ExternalPrefetchEntry *
+getExternalPrefetch (ContractionTable *table, uint32_t identifier) {
+  ExternalPrefetchEntry *entry = table->data.external.prefetch.entries;
+  const ExternalPrefetchEntry *end = entry + table->data.external.prefetch.count;
+
+  while (entry < end) {
+    if (entry->identifier == identifier) return entry;
+    entry += 1;
+  }
+
+  return NULL;
+}
+
+static int
+haveUnreadExternalPrefetch (ContractionTable *table) {
+  const ExternalPrefetchEntry *entry = table->data.external.prefetch.entries;
+  const ExternalPrefetchEntry *end = entry + table->data.external.prefetch.count;
+
+  while (entry < end) {
+    if (!entry->response) return 1;
+    entry += 1;
+  }
+
+  return 0;
+}
+
+static void
+removeExternalPrefetch (ContractionTable *table, ExternalPrefetchEntry *entry) {
+  ExternalPrefetchEntry *end = table->data.external.prefetch.entries + --table->data.external.prefetch.count;
+
+  free(entry->request);
+  if (entry->response) free(entry->response);
+
+  memmove(entry, entry+1, ((end - entry) * sizeof(*entry)));
+}
+
+static int
+getBinaryExternalResponse (BrailleContractionData *bcd, uint32_t expected) {
+  FILE *stream = bcd->table->data.external.standardOutput;
+
+  while (1) {
+    unsigned char header[2 * 4];
+    const unsigned char *byte = header;
+    uint32_t length;
+    uint32_t identifier;
+
+    if (fread(header, 1, sizeof(header), stream) != sizeof(header)) break;
+    length = getExternalInteger(&byte);
+    identifier = getExternalInteger(&byte);
+
+    if ((length < 4) || (length > EXTERNAL_FRAME_SIZE_LIMIT)) {
+      logMessage(LOG_WARNING, "invalid external contraction response length: %s: %" PRIu32, bcd->table->data.external.command, length);
+      return 0;
+    }
+
+    length -= 4;
+
+    if (length > bcd->table->data.external.input.size) {
+      char *buffer = realloc(bcd->table->data.external.input.buffer, length);
+
+      if (!buffer) {
+        logMallocError();
+        return 0;
+      }
+
+      bcd->table->data.external.input.buffer = buffer;
+      bcd->table->data.external.input.size = length;
+    }
+
+    if (fread(bcd->table->data.external.input.buffer, 1, length, stream) != length) break;
+
+    if (identifier != expected) {
+      ExternalPrefetchEntry *prefetch = getExternalPrefetch(bcd->table, identifier);
+
+      if (prefetch && !prefetch->response) {
+        if (!(prefetch->response = malloc(length))) {
+          logMallocError();
+          return 0;
+        }
+
+        memcpy(prefetch->response, bcd->table->data.external.input.buffer, length);
+        prefetch->responseSize = length;
+      } else {
+        logMessage(LOG_DEBUG, "skipping external contraction response: %s: %" PRIu32, bcd->table->data.external.command, identifier);
+      }
+
+      continue;
+    }
+
+    if (handleBinaryExternalResponse(bcd, (unsigned char *)bcd->table->data.external.input.buffer, length)) return 1;
+    logMessage(LOG_WARNING, "malformed external contraction response: %s", bcd->table->data.external.command);
+    return 0;
+  }
+
+  logMessage(LOG_WARNING, "incomplete external contraction response: %s", bcd->table->data.external.command);
+  return 0;
+}
+
+static int
+contractWithBinaryProtocol (BrailleContractionData *bcd) {
+  ContractionTable *table = bcd->table;
+  size_t size = getBinaryExternalRequestSize(bcd);
+  unsigned char request[size];
+  ExternalPrefetchEntry *prefetch;
+
+  makeBinaryExternalRequest(bcd, request);
+
+  if ((prefetch = findExternalPrefetch(table, request, size))) {
+    uint32_t identifier = prefetch->identifier;
+
+    if (prefetch->response) {
+      int ok = handleBinaryExternalResponse(bcd, prefetch->response, prefetch->responseSize);
+
+      removeExternalPrefetch(table, prefetch);
+      if (ok) return 1;
+
+      logMessage(LOG_WARNING, "malformed external contraction response: %s", table->data.external.command);
+      return 0;
+    }
+
+    removeExternalPrefetch(table, prefetch);
+    return getBinaryExternalResponse(bcd, identifier);
+  }
+
+  if (!putBinaryExternalRequest(bcd, request, size)) return 0;
+  return getBinaryExternalResponse(bcd, table->data.external.requestIdentifier);
+}
+
+static int
+contractWithCommand (BrailleContractionData *bcd) {
   setOffset(bcd);
   while (++bcd->input.current < bcd->input.end) clearOffset(bcd);
 
   if (startContractionCommand(bcd->table)) {
-    if (putExternalRequests(bcd)) {
+    if (bcd->table->data.external.binaryProtocol) {
+      if (contractWithBinaryProtocol(bcd)) {
+        return 1;
+      }
+    } else if (putExternalRequests(bcd)) {
       if (getExternalResponses(bcd)) {
         return 1;
       }
@@ -346,12 +660,75 @@ contractText_external (BrailleContractionData *bcd) {
   return 0;
 }
 
+static int
+contractText_external (BrailleContractionData *bcd) {
+  int contracted;
+
+  enterCriticalSection(&commandLock);
+  contracted = contractWithCommand(bcd);
+  leaveCriticalSection(&commandLock);
+
+  return contracted;
+}
+
+static void
+prefetchWithBinaryProtocol (BrailleContractionData *bcd) {
+  ContractionTable *table = bcd->table;
+  size_t size = getBinaryExternalRequestSize(bcd);
+  unsigned char *request;
+
+  if (size > EXTERNAL_FRAME_SIZE_LIMIT) return;
+  if (haveUnreadExternalPrefetch(table)) return;
+
+  if (!(request = malloc(size))) {
+    logMallocError();
+    return;
+  }
+
+  makeBinaryExternalRequest(bcd, request);
+
+  if (!findExternalPrefetch(table, request, size)) {
+    if (table->data.external.prefetch.count == ARRAY_COUNT(table->data.external.prefetch.entries)) {
+      /* its response has already been read */
+      removeExternalPrefetch(table, table->data.external.prefetch.entries);
+    }
+
+    if (putBinaryExternalRequest(bcd, request, size)) {
+      ExternalPrefetchEntry *entry = &table->data.external.prefetch.entries[table->data.external.prefetch.count++];
+
+      entry->identifier = table->data.external.requestIdentifier;
+      entry->request = request;
+      entry->requestSize = size;
+      entry->response = NULL;
+      entry->responseSize = 0;
+      return;
+    }
+
+    stopContractionCommand(table);
+  }
+
+  free(request);
+}
+
+static void
+prefetchText_external (BrailleContractionData *bcd) {
+  enterCriticalSection(&commandLock);
+
+  /* only a running command which has agreed to the binary protocol can match responses */
+  if (bcd->table->data.external.commandStarted && bcd->table->data.external.binaryProtocol) {
+    prefetchWithBinaryProtocol(bcd);
+  }
+
+  leaveCriticalSection(&commandLock);
+}
+
 static void
 finishCharacterEntry_external (BrailleContractionData *bcd, CharacterEntry *entry) {
 }
 
 static const ContractionTableTranslationMethods externalTranslationMethods = {
   .contractText = contractText_external,
+  .prefetchText = prefetchText_external,
   .finishCharacterEntry = finishCharacterEntry_external
 };
 
@@ -21,6 +21,8 @@
 
 #include <stdio.h>
 
+#include "parameters.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -129,9 +131,36 @@ extern GetContractionTableTranslationMethodsFunction getContractionTableTranslat
 extern GetContractionTableTranslationMethodsFunction getContractionTableTranslationMethods_external;
 extern GetContractionTableTranslationMethodsFunction getContractionTableTranslationMethods_louis;
 
-struct ContractionTableStruct {
-  const ContractionTableManagementMethods *managementMethods;
-  const ContractionTableTranslationMethods *translationMethods;
+typedef struct ContractionCacheEntryStruct ContractionCacheEntry;
+
+struct ContractionCacheEntryStruct {
+  ContractionCacheEntry *newer;
+  ContractionCacheEntry *older;
+  size_t size;
+  uint32_t hash;
+
+  int cursorOffset;
+  unsigned char expandCurrentWord;
+  unsigned char capitalizationMode;
+  unsigned char hasOffsets;
+
+  struct {
+    const wchar_t *characters;
+    unsigned int count;
+    unsigned int consumed;
+  } input;
+
+  struct {
+    const unsigned char *cells;
+    unsigned int count;
+    unsigned int maximum;
+  } output;
+
+  const int *offsets;
+};
+
+struct ContractionContextStruct {
+  ContractionTable *table;
 
   struct {
     CharacterEntry *array;
@@ -140,30 +169,28 @@ struct ContractionTableStruct {
   } characters;
 
   struct {
-    struct {
-      wchar_t *characters;
-      unsigned int size;
-      unsigned int count;
-      unsigned int consumed;
-    } input;
+    ContractionCacheEntry *newest;
+    ContractionCacheEntry *oldest;
+    unsigned int count;
+    size_t size;
+  } cache;
+};
 
-    struct {
-      unsigned char *cells;
-      unsigned int size;
-      unsigned int count;
-      unsigned int maximum;
-    } output;
+typedef struct {
+  uint32_t identifier;
 
-    struct {
-      int *array;
-      unsigned int size;
-      unsigned int count;
-    } offsets;
-
-    int cursorOffset;
-    unsigned char expandCurrentWord;
-    unsigned char capitalizationMode;
-  } cache;
+  unsigned char *request;
+  size_t requestSize;
+
+  unsigned char *response; /* NULL until it has arrived */
+  size_t responseSize;
+} ExternalPrefetchEntry;
+
+struct ContractionTableStruct {
+  const ContractionTableManagementMethods *managementMethods;
+  const ContractionTableTranslationMethods *translationMethods;
+
+  ContractionContext context; /* the one used by contractText() */
 
   union {
     struct {
@@ -173,6 +200,7 @@ struct ContractionTableStruct {
       } header;
 
       size_t size;
+      unsigned fromCache:1;
     } internal;
 
     struct {
@@ -180,11 +208,19 @@ struct ContractionTableStruct {
       FILE *standardInput;
       FILE *standardOutput;
       unsigned commandStarted:1;
+      unsigned protocolOffered:1;
+      unsigned binaryProtocol:1;
+      uint32_t requestIdentifier;
 
       struct {
         char *buffer;
         size_t size;
       } input;
+
+      struct {
+        ExternalPrefetchEntry entries[CONTRACTION_PREFETCH_LIMIT];
+        unsigned int count;
+      } prefetch;
     } external;
 
 #ifdef LOUIS_TABLES_DIRECTORY
@@ -197,6 +233,7 @@ struct ContractionTableStruct {
 
 extern int startContractionCommand (ContractionTable *table);
 extern void stopContractionCommand (ContractionTable *table);
+extern void discardContractionPrefetches (ContractionTable *table);
 
 #ifdef __cplusplus
 }
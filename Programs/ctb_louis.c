@@ -23,6 +23,7 @@
 #include "log.h"
 #include "ctb_translate.h"
 #include "prefs.h"
+#include "thread.h"
 
 static void
 initialize (void) {
@@ -40,8 +41,7 @@ initialize (void) {
 }
 
 static int
-contractText_louis (BrailleContractionData *bcd) {
-  initialize();
+contractWithLibLouis (BrailleContractionData *bcd) {
 
   int inputLength = getInputCount(bcd);
   widechar inputBuffer[inputLength];
@@ -113,6 +113,20 @@ contractText_louis (BrailleContractionData *bcd) {
   return translated;
 }
 
+static int
+contractText_louis (BrailleContractionData *bcd) {
+  /* LibLouis isn't reentrant */
+  static CriticalSectionLock louisLock = CRITICAL_SECTION_LOCK_INITIALIZER;
+  int contracted;
+
+  enterCriticalSection(&louisLock);
+  initialize();
+  contracted = contractWithLibLouis(bcd);
+  leaveCriticalSection(&louisLock);
+
+  return contracted;
+}
+
 static void
 finishCharacterEntry_louis (BrailleContractionData *bcd, CharacterEntry *entry) {
 }
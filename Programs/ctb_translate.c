@@ -24,6 +24,7 @@
 #include "ctb_translate.h"
 #include "ttb.h"
 #include "prefs.h"
+#include "parameters.h"
 
 #ifdef HAVE_ICU
 #include <unicode/uchar.h>
@@ -68,12 +69,9 @@ normalizeText (
     UErrorCode error = U_ZERO_ERROR;
 
 #ifdef HAVE_UNICODE_UNORM2_H
-    static const UNormalizer2 *normalizer = NULL;
-
-    if (!normalizer) {
-      normalizer = unorm2_getNFCInstance(&error);
-      if (!U_SUCCESS(error)) return 0;
-    }
+    /* ICU keeps the instance so it needn't be saved (which wouldn't be thread-safe) */
+    const UNormalizer2 *normalizer = unorm2_getNFCInstance(&error);
+    if (!U_SUCCESS(error)) return 0;
 
     count = unorm2_normalize(normalizer,
                              source, ARRAY_COUNT(source),
@@ -130,12 +128,13 @@ normalizeText (
 
 CharacterEntry *
 getCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
+  ContractionContext *context = bcd->context;
   int first = 0;
-  int last = bcd->table->characters.count - 1;
+  int last = context->characters.count - 1;
 
   while (first <= last) {
     int current = (first + last) / 2;
-    CharacterEntry *entry = &bcd->table->characters.array[current];
+    CharacterEntry *entry = &context->characters.array[current];
 
     if (entry->value < character) {
       first = current + 1;
@@ -146,30 +145,30 @@ getCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
     }
   }
 
-  if (bcd->table->characters.count == bcd->table->characters.size) {
-    int newSize = bcd->table->characters.size;
+  if (context->characters.count == context->characters.size) {
+    int newSize = context->characters.size;
     newSize = newSize? newSize<<1: 0X80;
 
     {
-      CharacterEntry *newArray = realloc(bcd->table->characters.array, (newSize * sizeof(*newArray)));
+      CharacterEntry *newArray = realloc(context->characters.array, (newSize * sizeof(*newArray)));
 
       if (!newArray) {
         logMallocError();
         return NULL;
       }
 
-      bcd->table->characters.array = newArray;
-      bcd->table->characters.size = newSize;
+      context->characters.array = newArray;
+      context->characters.size = newSize;
     }
   }
 
-  memmove(&bcd->table->characters.array[first+1],
-          &bcd->table->characters.array[first],
-          (bcd->table->characters.count - first) * sizeof(*bcd->table->characters.array));
-  bcd->table->characters.count += 1;
+  memmove(&context->characters.array[first+1],
+          &context->characters.array[first],
+          (context->characters.count - first) * sizeof(*context->characters.array));
+  context->characters.count += 1;
 
   {
-    CharacterEntry *entry = &bcd->table->characters.array[first];
+    CharacterEntry *entry = &context->characters.array[first];
     memset(entry, 0, sizeof(*entry));
     entry->value = entry->uppercase = entry->lowercase = character;
 
@@ -198,119 +197,194 @@ getCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
   }
 }
 
+static struct {
+  unsigned int entries;
+  size_t size;
+} cacheLimits = {
+  .entries = CONTRACTION_CACHE_ENTRY_LIMIT,
+  .size = CONTRACTION_CACHE_SIZE_LIMIT
+};
+
+void
+setContractionCacheLimits (unsigned int entries, size_t size) {
+  cacheLimits.entries = entries;
+  cacheLimits.size = size;
+}
+
 static inline int
 makeCachedCursorOffset (BrailleContractionData *bcd) {
   return bcd->input.cursor? (bcd->input.cursor - bcd->input.begin): CTB_NO_CURSOR;
 }
 
-static int
-checkCache (BrailleContractionData *bcd) {
-  if (!bcd->table->cache.input.characters) return 0;
-  if (!bcd->table->cache.output.cells) return 0;
-  if (bcd->input.offsets && !bcd->table->cache.offsets.count) return 0;
-  if (bcd->table->cache.output.maximum != getOutputCount(bcd)) return 0;
-  if (bcd->table->cache.cursorOffset != makeCachedCursorOffset(bcd)) return 0;
-  if (bcd->table->cache.expandCurrentWord != prefs.expandCurrentWord) return 0;
-  if (bcd->table->cache.capitalizationMode != prefs.capitalizationMode) return 0;
+static uint32_t
+makeCacheHash (const wchar_t *characters, unsigned int count) {
+  const wchar_t *end = characters + count;
+  uint32_t hash = UINT32_C(0X811C9DC5);
 
-  {
-    unsigned int count = getInputCount(bcd);
-    if (bcd->table->cache.input.count != count) return 0;
-    if (wmemcmp(bcd->input.begin, bcd->table->cache.input.characters, count) != 0) return 0;
+  while (characters < end) {
+    hash ^= *characters++;
+    hash *= UINT32_C(0X01000193);
   }
 
-  return 1;
+  return hash;
 }
 
 static void
-updateCache (BrailleContractionData *bcd) {
-  {
-    unsigned int count = getInputCount(bcd);
+unlinkCacheEntry (ContractionContext *context, ContractionCacheEntry *entry) {
+  if (entry->newer) {
+    entry->newer->older = entry->older;
+  } else {
+    context->cache.newest = entry->older;
+  }
 
-    if (count > bcd->table->cache.input.size) {
-      unsigned int newSize = count | 0X7F;
-      wchar_t *newCharacters = malloc(ARRAY_SIZE(newCharacters, newSize));
+  if (entry->older) {
+    entry->older->newer = entry->newer;
+  } else {
+    context->cache.oldest = entry->newer;
+  }
+}
 
-      if (!newCharacters) {
-        logMallocError();
-        bcd->table->cache.input.count = 0;
-        goto inputDone;
-      }
+static void
+linkCacheEntry (ContractionContext *context, ContractionCacheEntry *entry) {
+  entry->newer = NULL;
+
+  if ((entry->older = context->cache.newest)) {
+    entry->older->newer = entry;
+  } else {
+    context->cache.oldest = entry;
+  }
+
+  context->cache.newest = entry;
+}
 
-      if (bcd->table->cache.input.characters) free(bcd->table->cache.input.characters);
-      bcd->table->cache.input.characters = newCharacters;
-      bcd->table->cache.input.size = newSize;
+static void
+removeCacheEntry (ContractionContext *context, ContractionCacheEntry *entry) {
+  unlinkCacheEntry(context, entry);
+  context->cache.count -= 1;
+  context->cache.size -= entry->size;
+  free(entry);
+}
+
+static ContractionCacheEntry *
+findCacheEntry (BrailleContractionData *bcd, uint32_t hash) {
+  ContractionCacheEntry *entry = bcd->context->cache.newest;
+  unsigned int count = getInputCount(bcd);
+  unsigned int maximum = getOutputCount(bcd);
+  int cursorOffset = makeCachedCursorOffset(bcd);
+
+  while (entry) {
+    if ((entry->hash == hash) &&
+        (entry->input.count == count) &&
+        (entry->output.maximum == maximum) &&
+        (entry->cursorOffset == cursorOffset) &&
+        (entry->expandCurrentWord == prefs.expandCurrentWord) &&
+        (entry->capitalizationMode == prefs.capitalizationMode) &&
+        (wmemcmp(bcd->input.begin, entry->input.characters, count) == 0)) {
+      return entry;
     }
 
-    wmemcpy(bcd->table->cache.input.characters, bcd->input.begin, count);
-    bcd->table->cache.input.count = count;
-    bcd->table->cache.input.consumed = getInputConsumed(bcd);
+    entry = entry->older;
+  }
+
+  return NULL;
+}
+
+static void
+addCacheEntry (BrailleContractionData *bcd, uint32_t hash) {
+  ContractionContext *context = bcd->context;
+  unsigned int inputCount = getInputCount(bcd);
+  unsigned int outputCount = getOutputConsumed(bcd);
+  unsigned int offsetsCount = bcd->input.offsets? inputCount: 0;
+
+  size_t size = sizeof(ContractionCacheEntry)
+              + ARRAY_SIZE(bcd->input.offsets, offsetsCount)
+              + ARRAY_SIZE(bcd->input.begin, inputCount)
+              + ARRAY_SIZE(bcd->output.begin, outputCount);
+
+  if (!cacheLimits.entries) return;
+  if (size > cacheLimits.size) return;
+
+  while ((context->cache.count >= cacheLimits.entries) ||
+         ((context->cache.size + size) > cacheLimits.size)) {
+    removeCacheEntry(context, context->cache.oldest);
   }
-inputDone:
 
   {
-    unsigned int count = getOutputConsumed(bcd);
+    ContractionCacheEntry *entry = malloc(size);
 
-    if (count > bcd->table->cache.output.size) {
-      unsigned int newSize = count | 0X7F;
-      unsigned char *newCells = malloc(ARRAY_SIZE(newCells, newSize));
+    if (!entry) {
+      logMallocError();
+      return;
+    }
 
-      if (!newCells) {
-        logMallocError();
-        bcd->table->cache.output.count = 0;
-        goto outputDone;
-      }
+    entry->size = size;
+    entry->hash = hash;
 
-      if (bcd->table->cache.output.cells) free(bcd->table->cache.output.cells);
-      bcd->table->cache.output.cells = newCells;
-      bcd->table->cache.output.size = newSize;
+    entry->cursorOffset = makeCachedCursorOffset(bcd);
+    entry->expandCurrentWord = prefs.expandCurrentWord;
+    entry->capitalizationMode = prefs.capitalizationMode;
+    entry->hasOffsets = !!bcd->input.offsets;
+
+    {
+      int *offsets = (int *)(entry + 1);
+      wchar_t *characters = (wchar_t *)(offsets + offsetsCount);
+      unsigned char *cells = (unsigned char *)(characters + inputCount);
+
+      memcpy(offsets, bcd->input.offsets, ARRAY_SIZE(offsets, offsetsCount));
+      entry->offsets = offsets;
+
+      wmemcpy(characters, bcd->input.begin, inputCount);
+      entry->input.characters = characters;
+      entry->input.count = inputCount;
+      entry->input.consumed = getInputConsumed(bcd);
+
+      memcpy(cells, bcd->output.begin, outputCount);
+      entry->output.cells = cells;
+      entry->output.count = outputCount;
+      entry->output.maximum = getOutputCount(bcd);
     }
 
-    memcpy(bcd->table->cache.output.cells, bcd->output.begin, count);
-    bcd->table->cache.output.count = count;
-    bcd->table->cache.output.maximum = getOutputCount(bcd);
+    linkCacheEntry(context, entry);
+    context->cache.count += 1;
+    context->cache.size += size;
   }
-outputDone:
+}
 
-  if (bcd->input.offsets) {
-    unsigned int count = getInputCount(bcd);
+static void
+useNormalizedText (BrailleContractionData *bcd, const wchar_t *buffer, size_t length, const unsigned int *map) {
+  const wchar_t *oldBegin = bcd->input.begin;
 
-    if (count > bcd->table->cache.offsets.size) {
-      unsigned int newSize = count | 0X7F;
-      int *newArray = malloc(ARRAY_SIZE(newArray, newSize));
+  bcd->input.begin = buffer;
+  bcd->input.current = bcd->input.begin + (bcd->input.current - oldBegin);
+  bcd->input.end = bcd->input.begin + length;
 
-      if (!newArray) {
-        logMallocError();
-        bcd->table->cache.offsets.count = 0;
-        goto offsetsDone;
-      }
+  if (bcd->input.cursor) {
+    ptrdiff_t offset = bcd->input.cursor - oldBegin;
+    unsigned int mapIndex;
 
-      if (bcd->table->cache.offsets.array) free(bcd->table->cache.offsets.array);
-      bcd->table->cache.offsets.array = newArray;
-      bcd->table->cache.offsets.size = newSize;
-    }
+    bcd->input.cursor = NULL;
 
-    memcpy(bcd->table->cache.offsets.array, bcd->input.offsets, ARRAY_SIZE(bcd->input.offsets, count));
-    bcd->table->cache.offsets.count = count;
-  } else {
-    bcd->table->cache.offsets.count = 0;
-  }
-offsetsDone:
+    for (mapIndex=0; mapIndex<=length; mapIndex+=1) {
+      unsigned int mappedIndex = map[mapIndex];
 
-  bcd->table->cache.cursorOffset = makeCachedCursorOffset(bcd);
-  bcd->table->cache.expandCurrentWord = prefs.expandCurrentWord;
-  bcd->table->cache.capitalizationMode = prefs.capitalizationMode;
+      if (mappedIndex > offset) break;
+      bcd->input.cursor = &bcd->input.begin[mappedIndex];
+    }
+  }
 }
 
 void
-contractText (
-  ContractionTable *contractionTable,
+contractTextInContext (
+  ContractionContext *context,
   const wchar_t *inputBuffer, int *inputLength,
   BYTE *outputBuffer, int *outputLength,
   int *offsetsMap, const int cursorOffset
 ) {
+  ContractionTable *contractionTable = context->table;
+
   BrailleContractionData bcd = {
     .table = contractionTable,
+    .context = context,
 
     .input = {
       .begin = inputBuffer,
@@ -327,17 +401,28 @@ contractText (
     }
   };
 
-  if (checkCache(&bcd)) {
-    bcd.input.current = bcd.input.begin + bcd.table->cache.input.consumed;
+  uint32_t hash = makeCacheHash(bcd.input.begin, getInputCount(&bcd));
+  ContractionCacheEntry *entry = findCacheEntry(&bcd, hash);
+
+  if (entry && bcd.input.offsets && !entry->hasOffsets) {
+    removeCacheEntry(bcd.context, entry);
+    entry = NULL;
+  }
+
+  if (entry) {
+    unlinkCacheEntry(bcd.context, entry);
+    linkCacheEntry(bcd.context, entry);
+
+    bcd.input.current = bcd.input.begin + entry->input.consumed;
 
     if (bcd.input.offsets) {
-      memcpy(bcd.input.offsets, bcd.table->cache.offsets.array,
-             ARRAY_SIZE(bcd.input.offsets, bcd.table->cache.offsets.count));
+      memcpy(bcd.input.offsets, entry->offsets,
+             ARRAY_SIZE(bcd.input.offsets, entry->input.count));
     }
 
-    bcd.output.current = bcd.output.begin + bcd.table->cache.output.count;
-    memcpy(bcd.output.begin, bcd.table->cache.output.cells,
-           ARRAY_SIZE(bcd.output.begin, bcd.table->cache.output.count));
+    bcd.output.current = bcd.output.begin + entry->output.count;
+    memcpy(bcd.output.begin, entry->output.cells,
+           ARRAY_SIZE(bcd.output.begin, entry->output.count));
   } else {
     int contracted;
 
@@ -351,24 +436,7 @@ contractText (
         const wchar_t *oldBegin = bcd.input.begin;
         const wchar_t *oldEnd = bcd.input.end;
 
-        bcd.input.begin = buffer;
-        bcd.input.current = bcd.input.begin + (bcd.input.current - oldBegin);
-        bcd.input.end = bcd.input.begin + length;
-
-        if (bcd.input.cursor) {
-          ptrdiff_t offset = bcd.input.cursor - oldBegin;
-          unsigned int mapIndex;
-
-          bcd.input.cursor = NULL;
-
-          for (mapIndex=0; mapIndex<=length; mapIndex+=1) {
-            unsigned int mappedIndex = map[mapIndex];
-
-            if (mappedIndex > offset) break;
-            bcd.input.cursor = &bcd.input.begin[mappedIndex];
-          }
-        }
-
+        useNormalizedText(&bcd, buffer, length, map);
         contracted = contractionTable->translationMethods->contractText(&bcd);
 
         if (bcd.input.offsets) {
@@ -428,9 +496,76 @@ contractText (
       if (!done) bcd.input.current = srcorig;
     }
 
-    updateCache(&bcd);
+    addCacheEntry(&bcd, hash);
   }
 
   *inputLength = getInputConsumed(&bcd);
   *outputLength = getOutputConsumed(&bcd);
 }
+
+void
+contractText (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int *inputLength,
+  BYTE *outputBuffer, int *outputLength,
+  int *offsetsMap, const int cursorOffset
+) {
+  contractTextInContext(&contractionTable->context,
+                        inputBuffer, inputLength,
+                        outputBuffer, outputLength,
+                        offsetsMap, cursorOffset);
+}
+
+int
+canPrefetchContractedText (ContractionTable *contractionTable) {
+  return !!contractionTable->translationMethods->prefetchText;
+}
+
+void
+prefetchContractedText (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int inputLength,
+  int outputLength, int cursorOffset
+) {
+  if (contractionTable->translationMethods->prefetchText) {
+    BYTE outputBuffer[outputLength];
+
+    BrailleContractionData bcd = {
+      .table = contractionTable,
+      .context = &contractionTable->context,
+
+      .input = {
+        .begin = inputBuffer,
+        .current = inputBuffer,
+        .end = inputBuffer + inputLength,
+        .cursor = (cursorOffset == CTB_NO_CURSOR)? NULL: &inputBuffer[cursorOffset],
+        .offsets = NULL
+      },
+
+      .output = {
+        .begin = outputBuffer,
+        .end = outputBuffer + outputLength,
+        .current = outputBuffer
+      }
+    };
+
+    {
+      ContractionCacheEntry *entry = findCacheEntry(&bcd, makeCacheHash(bcd.input.begin, getInputCount(&bcd)));
+
+      if (entry && entry->hasOffsets) return;
+    }
+
+    {
+      const size_t size = getInputCount(&bcd);
+      wchar_t buffer[size];
+      unsigned int map[size + 1];
+      size_t length;
+
+      if (normalizeText(&bcd, bcd.input.begin, bcd.input.end, buffer, &length, map)) {
+        useNormalizedText(&bcd, buffer, length, map);
+      }
+
+      contractionTable->translationMethods->prefetchText(&bcd);
+    }
+  }
+}
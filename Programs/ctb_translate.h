@@ -29,6 +29,7 @@ extern "C" {
 
 typedef struct {
   ContractionTable *const table;
+  ContractionContext *const context;
 
   struct {
     const wchar_t *begin;
@@ -60,6 +61,7 @@ typedef struct {
 
 struct ContractionTableTranslationMethodsStruct {
   int (*contractText) (BrailleContractionData *bcd);
+  void (*prefetchText) (BrailleContractionData *bcd);
   void (*finishCharacterEntry) (BrailleContractionData *bcd, CharacterEntry *entry);
 };
 
@@ -29,6 +29,7 @@
 #include "file.h"
 #include "queue.h"
 #include "datafile.h"
+#include "tblcache.h"
 #include "variables.h"
 #include "charset.h"
 #include "unicode.h"
@@ -206,6 +207,12 @@ getBaseDataVariables (void) {
   return baseDataVariables;
 }
 
+static const Variable *
+findDataVariable (const wchar_t *name, int length) {
+  disableTableCache();
+  return findReadableVariable(currentDataVariables, name, length);
+}
+
 int
 setBaseDataVariables (const VariableInitializer *initializers) {
   VariableNestingLevel *variables = getBaseDataVariables();
@@ -424,7 +431,7 @@ parseDataString (DataFile *file, DataString *string, const wchar_t *characters,
               int count = end - first;
               index += count;
 
-              const Variable *variable = findReadableVariable(currentDataVariables, first, count);
+              const Variable *variable = findDataVariable(first, count);
 
               if (variable) {
                 getVariableValue(variable, &substitution.characters, &substitution.length);
@@ -996,7 +1003,7 @@ processConditionOperands (
 }
 
 static DATA_CONDITION_TESTER(testVariableDefined) {
-  return !!findReadableVariable(currentDataVariables, identifier->characters, identifier->length);
+  return !!findDataVariable(identifier->characters, identifier->length);
 }
 
 static int
@@ -1043,7 +1050,7 @@ processVariableAssignmentOperands (DataFile *file, int ifNotSet, void *data) {
     }
 
     if (ifNotSet) {
-      const Variable *variable = findReadableVariable(currentDataVariables, name.characters, name.length);
+      const Variable *variable = findDataVariable(name.characters, name.length);
 
       if (variable) return 1;
     }
@@ -1283,6 +1290,9 @@ processDataStream (
     if (fstat(fileno(stream), &info) != -1) {
       file.identity.device = info.st_dev;
       file.identity.file = info.st_ino;
+      addTableCacheSource(name, &info);
+    } else {
+      disableTableCache();
     }
   }
 
@@ -326,6 +326,25 @@ gioReadByte (GioEndpoint *endpoint, unsigned char *byte, int wait) {
   return 0;
 }
 
+size_t
+gioPeekInput (GioEndpoint *endpoint, const unsigned char **bytes, int wait) {
+  if (endpoint->input.to == endpoint->input.from) {
+    unsigned char byte;
+    if (gioReadData(endpoint, &byte, 1, wait) != 1) return 0;
+
+    /* gioReadData() always goes through the input buffer */
+    endpoint->input.from -= 1;
+  }
+
+  *bytes = &endpoint->input.buffer[endpoint->input.from];
+  return endpoint->input.to - endpoint->input.from;
+}
+
+void
+gioConsumeInput (GioEndpoint *endpoint, size_t count) {
+  endpoint->input.from += MIN(count, endpoint->input.to - endpoint->input.from);
+}
+
 int
 gioDiscardInput (GioEndpoint *endpoint) {
   unsigned char byte;
@@ -187,6 +187,10 @@ getKeyContext (KeyTableData *ktd, unsigned char context) {
       ctx->keyBindings.size = 0;
       ctx->keyBindings.count = 0;
 
+      ctx->keyBindingIndex.table = NULL;
+      ctx->keyBindingIndex.size = 0;
+      ctx->keyBindingIndex.anyKeyCounts = 0;
+
       ctx->hotkeys.table = NULL;
       ctx->hotkeys.size = 0;
       ctx->hotkeys.count = 0;
@@ -1521,6 +1525,70 @@ addIncompleteBindings (KeyContext *ctx) {
   return 1;
 }
 
+static unsigned int
+hashKeyValue (const KeyValue *value) {
+  unsigned int hash = ((value->group << 8) | value->number) * 0X9E3779B1U;
+  return hash ^ (hash >> 15);
+}
+
+unsigned int
+hashKeyCombination (
+  const KeyValue *immediate,
+  const KeyValue *modifiers, unsigned int count
+) {
+  /* The modifiers are summed so that their order doesn't matter,
+   * which allows a lookup without sorting them first.
+   */
+  unsigned int hash = count;
+
+  if (immediate) hash ^= hashKeyValue(immediate) * 0X1F;
+  while (count) hash += hashKeyValue(&modifiers[--count]);
+
+  return hash;
+}
+
+static int
+indexKeyBindings (KeyContext *ctx) {
+  unsigned int size = 0X10;
+
+  while (size < (ctx->keyBindings.count * 2)) size <<= 1;
+
+  {
+    const KeyBinding **table = calloc(size, sizeof(*table));
+
+    if (!table) {
+      logMallocError();
+      return 0;
+    }
+
+    ctx->keyBindingIndex.table = table;
+    ctx->keyBindingIndex.size = size;
+    ctx->keyBindingIndex.anyKeyCounts = 0;
+  }
+
+  for (unsigned int index=0; index<ctx->keyBindings.count; index+=1) {
+    const KeyBinding *binding = &ctx->keyBindings.table[index];
+    const KeyCombination *combination = &binding->keyCombination;
+    unsigned int anyKeyCount = 0;
+
+    unsigned int slot = hashKeyCombination(
+      ((combination->flags & KCF_IMMEDIATE_KEY)? &combination->immediateKey: NULL),
+      combination->modifierKeys, combination->modifierCount
+    );
+
+    for (unsigned int modifier=0; modifier<combination->modifierCount; modifier+=1) {
+      if (combination->modifierKeys[modifier].number == KTB_KEY_ANY) anyKeyCount += 1;
+    }
+
+    ctx->keyBindingIndex.anyKeyCounts |= 1 << anyKeyCount;
+
+    while (ctx->keyBindingIndex.table[slot &= size - 1]) slot += 1;
+    ctx->keyBindingIndex.table[slot] = binding;
+  }
+
+  return 1;
+}
+
 static int
 prepareKeyBindings (KeyContext *ctx) {
   if (!addIncompleteBindings(ctx)) return 0;
@@ -1543,6 +1611,10 @@ prepareKeyBindings (KeyContext *ctx) {
     ctx->keyBindings.size = ctx->keyBindings.count;
   }
 
+  if (ctx->keyBindings.count) {
+    if (!indexKeyBindings(ctx)) return 0;
+  }
+
   return 1;
 }
 
@@ -1694,6 +1766,7 @@ destroyKeyTable (KeyTable *table) {
     if (ctx->title) free(ctx->title);
 
     if (ctx->keyBindings.table) free(ctx->keyBindings.table);
+    if (ctx->keyBindingIndex.table) free(ctx->keyBindingIndex.table);
     if (ctx->hotkeys.table) free(ctx->hotkeys.table);
     if (ctx->mappedKeys.table) free(ctx->mappedKeys.table);
   }
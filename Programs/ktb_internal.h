@@ -104,6 +104,12 @@ typedef struct {
     unsigned int count;
   } keyBindings;
 
+  struct {
+    const KeyBinding **table; /* hashed by key combination */
+    unsigned int size; /* a power of two */
+    unsigned int anyKeyCounts; /* bit n: a binding has n any-key modifiers */
+  } keyBindingIndex;
+
   struct {
     HotkeyEntry *table;
     unsigned int size;
@@ -192,6 +198,11 @@ extern void removeKeyValue (KeyValue *values, unsigned int *count, unsigned int
 extern int deleteKeyValue (KeyValue *values, unsigned int *count, const KeyValue *value);
 
 extern int compareKeyBindings (const KeyBinding *binding1, const KeyBinding *binding2);
+
+extern unsigned int hashKeyCombination (
+  const KeyValue *immediate,
+  const KeyValue *modifiers, unsigned int count
+);
 extern int compareHotkeyEntries (const HotkeyEntry *hotkey1, const HotkeyEntry *hotkey2);
 extern int compareMappedKeyEntries (const MappedKeyEntry *map1, const MappedKeyEntry *map2);
 
@@ -88,17 +88,51 @@ setKeyAutoreleaseTime (KeyTable *table, unsigned char setting) {
 }
 
 static int
-sortModifierKeys (const void *element1, const void *element2) {
-  const KeyValue *modifier1 = element1;
-  const KeyValue *modifier2 = element2;
-  return compareKeyValues(modifier1, modifier2);
+isKeyCombination (
+  const KeyCombination *combination, const KeyValue *immediate,
+  const KeyValue *modifiers, unsigned int count
+) {
+  if (immediate) {
+    if (!(combination->flags & KCF_IMMEDIATE_KEY)) return 0;
+    if (compareKeyValues(immediate, &combination->immediateKey) != 0) return 0;
+  } else if (combination->flags & KCF_IMMEDIATE_KEY) {
+    return 0;
+  }
+
+  if (count != combination->modifierCount) return 0;
+
+  /* the modifiers aren't sorted, and any-key values may be repeated */
+  for (unsigned int index=0; index<count; index+=1) {
+    const KeyValue *modifier = &modifiers[index];
+    unsigned int expected = 0;
+    unsigned int actual = 0;
+
+    for (unsigned int other=0; other<count; other+=1) {
+      if (compareKeyValues(modifier, &modifiers[other]) == 0) expected += 1;
+      if (compareKeyValues(modifier, &combination->modifierKeys[other]) == 0) actual += 1;
+    }
+
+    if (actual != expected) return 0;
+  }
+
+  return 1;
 }
 
-static int
-searchKeyBinding (const void *target, const void *element) {
-  const KeyBinding *reference = target;
-  const KeyBinding *binding = element;
-  return compareKeyBindings(reference, binding);
+static const KeyBinding *
+getIndexedKeyBinding (
+  const KeyContext *ctx, const KeyValue *immediate,
+  const KeyValue *modifiers, unsigned int count
+) {
+  unsigned int mask = ctx->keyBindingIndex.size - 1;
+  unsigned int slot = hashKeyCombination(immediate, modifiers, count);
+  const KeyBinding *binding;
+
+  while ((binding = ctx->keyBindingIndex.table[slot &= mask])) {
+    if (isKeyCombination(&binding->keyCombination, immediate, modifiers, count)) return binding;
+    slot += 1;
+  }
+
+  return NULL;
 }
 
 static const KeyBinding *
@@ -106,44 +140,42 @@ findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediat
   const KeyContext *ctx = getKeyContext(table, context);
 
   if (!ctx) return NULL;
-  if (!ctx->keyBindings.table) return NULL;
+  if (!ctx->keyBindingIndex.table) return NULL;
   if (table->pressedKeys.count > MAX_MODIFIERS_PER_COMBINATION) return NULL;
 
-  KeyBinding target = {
-    .keyCombination.modifierCount = table->pressedKeys.count
-  };
+  KeyValue modifiers[MAX_MODIFIERS_PER_COMBINATION];
+  unsigned int count = table->pressedKeys.count;
+  KeyValue immediateKey;
 
   if (immediate) {
-    target.keyCombination.immediateKey = *immediate;
-    target.keyCombination.flags |= KCF_IMMEDIATE_KEY;
+    immediateKey = *immediate;
+    immediate = &immediateKey;
   }
 
   while (1) {
-    unsigned int all = (1 << table->pressedKeys.count) - 1;
+    unsigned int all = (1 << count) - 1;
 
     for (unsigned int bits=0; bits<=all; bits+=1) {
+      unsigned int anyKeyCount = 0;
+
       {
         unsigned int index;
         unsigned int bit;
 
-        for (index=0, bit=1; index<table->pressedKeys.count; index+=1, bit<<=1) {
-          KeyValue *modifier = &target.keyCombination.modifierKeys[index];
+        for (index=0, bit=1; index<count; index+=1, bit<<=1) {
+          KeyValue *modifier = &modifiers[index];
 
           *modifier = table->pressedKeys.table[index];
-          if (bits & bit) modifier->number = KTB_KEY_ANY;
+
+          if (bits & bit) {
+            modifier->number = KTB_KEY_ANY;
+            anyKeyCount += 1;
+          }
         }
       }
 
-      qsort(
-        target.keyCombination.modifierKeys, table->pressedKeys.count,
-        sizeof(*target.keyCombination.modifierKeys), sortModifierKeys
-      );
-
-      {
-        const KeyBinding *binding = bsearch(&target, ctx->keyBindings.table,
-                                            ctx->keyBindings.count,
-                                            sizeof(*ctx->keyBindings.table),
-                                            searchKeyBinding);
+      if (ctx->keyBindingIndex.anyKeyCounts & (1 << anyKeyCount)) {
+        const KeyBinding *binding = getIndexedKeyBinding(ctx, immediate, modifiers, count);
 
         if (binding) {
           if (binding->primaryCommand.value != EOF) return binding;
@@ -152,9 +184,9 @@ findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediat
       }
     }
 
-    if (!(target.keyCombination.flags & KCF_IMMEDIATE_KEY)) break;
-    if (target.keyCombination.immediateKey.number == KTB_KEY_ANY) break;
-    target.keyCombination.immediateKey.number = KTB_KEY_ANY;
+    if (!immediate) break;
+    if (immediateKey.number == KTB_KEY_ANY) break;
+    immediateKey.number = KTB_KEY_ANY;
   }
 
   return NULL;
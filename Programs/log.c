@@ -105,6 +105,12 @@ static const LogCategoryEntry logCategoryTable[LOG_CATEGORY_COUNT] = {
     .prefix = "update"
   },
 
+  [LOG_CATEGORY_INDEX(TEXT_TABLES)] = {
+    .name = "ttb",
+    .title = strtext("Text Table Events"),
+    .prefix = "text table"
+  },
+
   [LOG_CATEGORY_INDEX(SPEECH_EVENTS)] = {
     .name = "speech",
     .title = strtext("Speech Events"),
@@ -268,8 +274,276 @@ popLogPrefix (void) {
   return popLogEntry(&logPrefixStack);
 }
 
+static void
+writeLogFileRecord (const char *prefix, size_t prefixLength, const char *record) {
+  lockStream(logFile);
+  fwrite(prefix, 1, prefixLength, logFile);
+  fputs(record, logFile);
+  fputc('\n', logFile);
+  flushStream(logFile);
+  unlockStream(logFile);
+}
+
+#ifdef GOT_PTHREADS
+#define LOG_FILE_BUFFER_SIZE 0X10000
+
+typedef struct {
+  char *characters;
+  size_t length;
+} LogFileBuffer;
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t pending;
+  pthread_cond_t written;
+  pthread_t thread;
+
+  LogFileBuffer buffers[2];
+  LogFileBuffer *filling;
+  int interval;
+
+  unsigned started:1;
+  unsigned starting:1;
+  unsigned stop:1;
+  unsigned flush:1;
+  unsigned writing:1;
+} logFileWriter = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .pending = PTHREAD_COND_INITIALIZER,
+  .written = PTHREAD_COND_INITIALIZER,
+  .interval = 0
+};
+
+static void
+writeLogFileBuffer (LogFileBuffer *buffer) {
+  lockStream(logFile);
+  fwrite(buffer->characters, 1, buffer->length, logFile);
+  flushStream(logFile);
+  unlockStream(logFile);
+
+  buffer->length = 0;
+}
+
+THREAD_FUNCTION(runLogFileWriter) {
+  pthread_mutex_lock(&logFileWriter.mutex);
+
+  while (1) {
+    LogFileBuffer *buffer = logFileWriter.filling;
+
+    if (!buffer->length) {
+      if (logFileWriter.stop) break;
+      pthread_cond_wait(&logFileWriter.pending, &logFileWriter.mutex);
+      continue;
+    }
+
+    if (!(logFileWriter.stop || logFileWriter.flush) &&
+        (buffer->length < (LOG_FILE_BUFFER_SIZE / 2))) {
+      TimeValue deadline;
+      struct timespec time;
+
+      getCurrentTime(&deadline);
+      adjustTimeValue(&deadline, logFileWriter.interval);
+      time.tv_sec = deadline.seconds;
+      time.tv_nsec = deadline.nanoseconds;
+
+      pthread_cond_timedwait(&logFileWriter.pending, &logFileWriter.mutex, &time);
+    }
+
+    logFileWriter.filling = (buffer == &logFileWriter.buffers[0])?
+                            &logFileWriter.buffers[1]:
+                            &logFileWriter.buffers[0];
+
+    logFileWriter.flush = 0;
+    logFileWriter.writing = 1;
+    pthread_mutex_unlock(&logFileWriter.mutex);
+
+    writeLogFileBuffer(buffer);
+
+    pthread_mutex_lock(&logFileWriter.mutex);
+    logFileWriter.writing = 0;
+    pthread_cond_broadcast(&logFileWriter.written);
+  }
+
+  pthread_mutex_unlock(&logFileWriter.mutex);
+  return NULL;
+}
+
+static void
+waitForLogFileWriter (void) {
+  while (logFileWriter.started &&
+         (logFileWriter.filling->length || logFileWriter.writing)) {
+    logFileWriter.flush = 1;
+    pthread_cond_signal(&logFileWriter.pending);
+    pthread_cond_wait(&logFileWriter.written, &logFileWriter.mutex);
+  }
+}
+
+#ifdef HAVE_POSIX_THREADS
+static void
+prepareLogFileFork (void) {
+  pthread_mutex_lock(&logFileWriter.mutex);
+  waitForLogFileWriter();
+}
+
+static void
+resumeLogFileParent (void) {
+  pthread_mutex_unlock(&logFileWriter.mutex);
+}
+
+/* A child might leave via _exit(), which would lose any pending records,
+ * so it writes synchronously until its flush interval is set again.
+ */
+static void
+resumeLogFileChild (void) {
+  logFileWriter.started = 0;
+  logFileWriter.starting = 0;
+  logFileWriter.interval = 0;
+
+  pthread_cond_init(&logFileWriter.pending, NULL);
+  pthread_cond_init(&logFileWriter.written, NULL);
+  pthread_mutex_init(&logFileWriter.mutex, NULL);
+}
+#endif /* HAVE_POSIX_THREADS */
+
+static int
+startLogFileWriter (void) {
+  if (!logFileWriter.buffers[0].characters) {
+    char *characters;
+
+    if (!(characters = malloc(LOG_FILE_BUFFER_SIZE * 2))) return 0;
+    logFileWriter.buffers[0].characters = characters;
+    logFileWriter.buffers[1].characters = characters + LOG_FILE_BUFFER_SIZE;
+  }
+
+  logFileWriter.buffers[0].length = 0;
+  logFileWriter.buffers[1].length = 0;
+  logFileWriter.filling = &logFileWriter.buffers[0];
+
+#ifdef HAVE_POSIX_THREADS
+  {
+    static int registered = 0;
+
+    if (!registered) {
+      if (pthread_atfork(prepareLogFileFork, resumeLogFileParent, resumeLogFileChild)) return 0;
+      registered = 1;
+    }
+  }
+#endif /* HAVE_POSIX_THREADS */
+
+  return !createThread("log-writer", &logFileWriter.thread, NULL,
+                       runLogFileWriter, NULL);
+}
+
+static int
+enqueueLogFileRecord (const char *prefix, size_t prefixLength, const char *record) {
+  int handled = 0;
+
+  pthread_mutex_lock(&logFileWriter.mutex);
+
+  if (logFileWriter.interval > 0) {
+    if (!(logFileWriter.started || logFileWriter.starting)) {
+      int started;
+
+      logFileWriter.starting = 1;
+      pthread_mutex_unlock(&logFileWriter.mutex);
+      started = startLogFileWriter();
+      pthread_mutex_lock(&logFileWriter.mutex);
+      logFileWriter.starting = 0;
+
+      if (started) {
+        logFileWriter.started = 1;
+      } else {
+        logFileWriter.interval = 0;
+      }
+    }
+
+    if (logFileWriter.started && !logFileWriter.stop) {
+      size_t recordLength = strlen(record);
+      size_t size = prefixLength + recordLength + 1;
+
+      if (size <= LOG_FILE_BUFFER_SIZE) {
+        LogFileBuffer *buffer;
+
+        while ((buffer = logFileWriter.filling)->length + size > LOG_FILE_BUFFER_SIZE) {
+          if (logFileWriter.stop) break;
+          logFileWriter.flush = 1;
+          pthread_cond_signal(&logFileWriter.pending);
+          pthread_cond_wait(&logFileWriter.written, &logFileWriter.mutex);
+        }
+
+        if (!logFileWriter.stop) {
+          char *next = buffer->characters + buffer->length;
+          int wasEmpty = !buffer->length;
+
+          memcpy(next, prefix, prefixLength);
+          next += prefixLength;
+
+          memcpy(next, record, recordLength);
+          next += recordLength;
+
+          *next++ = '\n';
+          buffer->length = next - buffer->characters;
+
+          if (wasEmpty || (buffer->length >= (LOG_FILE_BUFFER_SIZE / 2))) {
+            pthread_cond_signal(&logFileWriter.pending);
+          }
+
+          handled = 1;
+        }
+      }
+    }
+  }
+
+  /* Records which couldn't be queued are written while the mutex is still
+   * held, and only after those already queued, so that they can't overtake
+   * them and so that no newer record can be queued ahead of them.
+   */
+  if (!handled && logFileWriter.started) {
+    waitForLogFileWriter();
+    writeLogFileRecord(prefix, prefixLength, record);
+    handled = 1;
+  }
+
+  pthread_mutex_unlock(&logFileWriter.mutex);
+  return handled;
+}
+
+static void
+stopLogFileWriter (void) {
+  pthread_mutex_lock(&logFileWriter.mutex);
+
+  if (logFileWriter.started) {
+    logFileWriter.stop = 1;
+    pthread_cond_signal(&logFileWriter.pending);
+    pthread_cond_broadcast(&logFileWriter.written);
+    pthread_mutex_unlock(&logFileWriter.mutex);
+
+    pthread_join(logFileWriter.thread, NULL);
+
+    pthread_mutex_lock(&logFileWriter.mutex);
+    logFileWriter.started = 0;
+    logFileWriter.stop = 0;
+  }
+
+  pthread_mutex_unlock(&logFileWriter.mutex);
+}
+#endif /* GOT_PTHREADS */
+
+void
+setLogFileFlushInterval (int milliseconds) {
+#ifdef GOT_PTHREADS
+  pthread_mutex_lock(&logFileWriter.mutex);
+  logFileWriter.interval = milliseconds;
+  pthread_mutex_unlock(&logFileWriter.mutex);
+#endif /* GOT_PTHREADS */
+}
+
 void
 closeLogFile (void) {
+#ifdef GOT_PTHREADS
+  stopLogFileWriter();
+#endif /* GOT_PTHREADS */
+
   if (logFile) {
     fclose(logFile);
     logFile = NULL;
@@ -285,32 +559,33 @@ openLogFile (const char *path) {
 static void
 writeLogRecord (const char *record) {
   if (logFile) {
-    lockStream(logFile);
+    char prefix[0X80];
+    size_t length;
+
+    STR_BEGIN(prefix, sizeof(prefix));
 
     {
       TimeValue now;
-      char buffer[0X20];
-      size_t length;
-      unsigned int milliseconds;
 
       getCurrentTime(&now);
-      length = formatSeconds(buffer, sizeof(buffer), "%Y-%m-%d@%H:%M:%S", now.seconds);
-      milliseconds = now.nanoseconds / NSECS_PER_MSEC;
-
-      fprintf(logFile, "%.*s.%03u ", (int)length, buffer, milliseconds);
+      STR_FORMAT(formatSeconds, "%Y-%m-%d@%H:%M:%S", now.seconds);
+      STR_PRINTF(".%03u ", (unsigned int)(now.nanoseconds / NSECS_PER_MSEC));
     }
 
     {
       char name[0X40];
-      size_t length = formatThreadName(name, sizeof(name));
 
-      if (length) fprintf(logFile, "[%s] ", name);
+      if (formatThreadName(name, sizeof(name))) STR_PRINTF("[%s] ", name);
     }
 
-    fputs(record, logFile);
-    fputc('\n', logFile);
-    flushStream(logFile);
-    unlockStream(logFile);
+    length = STR_LENGTH;
+    STR_END;
+
+#ifdef GOT_PTHREADS
+    if (enqueueLogFileRecord(prefix, length, record)) return;
+#endif /* GOT_PTHREADS */
+
+    writeLogFileRecord(prefix, length, record);
   }
 }
 
@@ -24,10 +24,13 @@
 #include "log_history.h"
 #include "timing.h"
 
+#define LOG_MESSAGE_HISTORY_SIZE 0X100
+
 struct LogEntryStruct {
   struct LogEntryStruct *previous;
   TimeValue time;
   unsigned int count;
+  unsigned int sequence;
   unsigned noSquash:1;
   char text[0];
 };
@@ -87,6 +90,11 @@ pushLogEntry (LogEntry **head, const char *text, LogEntryPushOptions options) {
   return 1;
 }
 
+void
+deallocateLogEntry (const LogEntry *entry) {
+  free((void *)entry);
+}
+
 int
 popLogEntry (LogEntry **head) {
   if (!*head) return 0;
@@ -108,12 +116,74 @@ unlockLogMessages (void) {
   leaveCriticalSection(&logMessageLock);
 }
 
-static LogEntry *logMessageStack = NULL;
+/* The message history is bounded: once the ring is full, each new message
+ * evicts (and frees) the oldest one.
+ */
+static LogEntry *defaultLogMessageEntries[LOG_MESSAGE_HISTORY_SIZE];
+
+static struct {
+  LogEntry **entries;
+  unsigned int size;
+
+  LogEntry *newest;
+  unsigned int next; /* where the next new message goes */
+  unsigned int count;
+  unsigned int sequence;
+} logMessageRing = {
+  .entries = defaultLogMessageEntries,
+  .size = ARRAY_COUNT(defaultLogMessageEntries)
+};
+
+unsigned int
+getLogMessageHistorySize (void) {
+  return logMessageRing.size;
+}
+
+int
+setLogMessageHistorySize (unsigned int size) {
+  LogEntry **entries;
+  LogEntry **oldEntries;
+  LogEntry *evicted;
+
+  if (!size) size = 1;
+
+  if (!(entries = malloc(ARRAY_SIZE(entries, size)))) {
+    logMallocError();
+    return 0;
+  }
+
+  lockLogMessages();
+
+  {
+    unsigned int count = MIN(logMessageRing.count, size);
+    unsigned int index = count;
+
+    evicted = logMessageRing.newest;
+    while (index > 0) {
+      entries[--index] = evicted;
+      evicted = evicted->previous;
+    }
+
+    if (count) entries[0]->previous = NULL;
+
+    oldEntries = logMessageRing.entries;
+    logMessageRing.entries = entries;
+    logMessageRing.size = size;
+    logMessageRing.count = count;
+    logMessageRing.next = count % size;
+  }
+
+  unlockLogMessages();
+
+  while (popLogEntry(&evicted));
+  if (oldEntries != defaultLogMessageEntries) free(oldEntries);
+  return 1;
+}
 
 const LogEntry *
 getNewestLogMessage (int freeze) {
   lockLogMessages();
-  LogEntry *message = logMessageStack;
+  LogEntry *message = logMessageRing.newest;
   if (freeze && message) message->noSquash = 1;
   unlockLogMessages();
   return message;
@@ -122,6 +192,82 @@ getNewestLogMessage (int freeze) {
 void
 pushLogMessage (const char *message) {
   lockLogMessages();
-  pushLogEntry(&logMessageStack, message, (LPO_NOLOG | LPO_SQUASH));
+
+  {
+    LogEntry *newest = logMessageRing.newest;
+
+    if (pushLogEntry(&logMessageRing.newest, message, (LPO_NOLOG | LPO_SQUASH))) {
+      if (logMessageRing.newest != newest) {
+        LogEntry **entry = &logMessageRing.entries[logMessageRing.next];
+        int full = logMessageRing.count == logMessageRing.size;
+
+        if (full) {
+          free(*entry);
+        } else {
+          logMessageRing.count += 1;
+        }
+
+        *entry = logMessageRing.newest;
+        (*entry)->sequence = ++logMessageRing.sequence;
+        logMessageRing.next = (logMessageRing.next + 1) % logMessageRing.size;
+
+        /* the next slot now holds the oldest message */
+        if (full) logMessageRing.entries[logMessageRing.next]->previous = NULL;
+      }
+    }
+  }
+
+  unlockLogMessages();
+}
+
+static LogEntry *
+copyLogEntry (const LogEntry *entry) {
+  const size_t size = sizeof(*entry) + strlen(entry->text) + 1;
+  LogEntry *copy = malloc(size);
+
+  if (copy) {
+    memcpy(copy, entry, size);
+    copy->previous = NULL;
+  }
+
+  return copy;
+}
+
+/* Returns a private copy (newest first) of the messages which have been
+ * added since *sequence, and then advances *sequence past them.
+ */
+const LogEntry *
+copyNewLogMessages (unsigned int *sequence) {
+  LogEntry *newest = NULL;
+  LogEntry **previous = &newest;
+  int copied = 1;
+
+  lockLogMessages();
+
+  {
+    LogEntry *message = logMessageRing.newest;
+
+    if (message) {
+      unsigned int oldest = *sequence;
+
+      message->noSquash = 1;
+      *sequence = message->sequence;
+
+      while (message && (message->sequence > oldest)) {
+        /* don't log a failure while the lock is held */
+        if (!(*previous = copyLogEntry(message))) {
+          copied = 0;
+          break;
+        }
+
+        previous = &(*previous)->previous;
+        message = message->previous;
+      }
+    }
+  }
+
   unlockLogMessages();
+
+  if (!copied) logMallocError();
+  return newest;
 }
@@ -516,43 +516,137 @@ makeMidiInstrumentMenuStrings (void) {
 #endif /* HAVE_MIDI_SUPPORT */
 
 static Menu *logMessagesMenu = NULL;
-static const LogEntry *newestLogMessage = NULL;
-
-static int
-addNewLogMessages (const LogEntry *message) {
-  if (message == newestLogMessage) return 1;
-  if (!addNewLogMessages(getPreviousLogEntry(message))) return 0;
+static unsigned int newestLogMessage = 0;
 
+/* The submenu owns the copies of the messages which its items present, and
+ * keeps no more of them than the log message history does.
+ */
+typedef struct {
+  const LogEntry *message;
   MenuString name;
+} LogMessageItem;
+
+static struct {
+  LogMessageItem *array;
+  unsigned int size;
+  unsigned int count;
+} logMessageItems = {
+  .array = NULL,
+  .size = 0,
+  .count = 0
+};
+
+static void
+deallocateLogMessageItems (LogMessageItem *item, unsigned int count) {
+  const LogMessageItem *end = item + count;
+
+  while (item < end) {
+    deallocateLogEntry(item->message);
+    if (item->name.label) free((void *)item->name.label);
+    if (item->name.comment) free((void *)item->name.comment);
+    item += 1;
+  }
+}
+
+static int
+addLogMessageItem (LogMessageItem *lmi) {
+  const LogEntry *message = lmi->message;
   const TimeValue *time = getLogEntryTime(message);
   unsigned int count = getLogEntryCount(message);
 
   if (time) {
     char buffer[0X20];
     formatSeconds(buffer, sizeof(buffer), "%Y-%m-%d@%H:%M:%S", time->seconds);
-    name.label = strdup(buffer);
-  } else {
-    name.label = NULL;
+    lmi->name.label = strdup(buffer);
   }
 
   if (count > 1) {
     char buffer[0X10];
     snprintf(buffer, sizeof(buffer), "(%u)", count);
-    name.comment = strdup(buffer);
-  } else {
-    name.comment = NULL;
+    lmi->name.comment = strdup(buffer);
   }
 
-  MenuItem *item = newTextMenuItem(logMessagesMenu, &name, getLogEntryText(message));
-  if (!item) return 0;
-
-  newestLogMessage = message;
-  return 1;
+  return !!newTextMenuItem(logMessagesMenu, &lmi->name, getLogEntryText(message));
 }
 
 int
 updateLogMessagesSubmenu (void) {
-  return addNewLogMessages(getNewestLogMessage(1));
+  const LogEntry *messages = copyNewLogMessages(&newestLogMessage);
+  unsigned int count = 0;
+
+  {
+    const LogEntry *message = messages;
+
+    while (message) {
+      count += 1;
+      message = getPreviousLogEntry(message);
+    }
+  }
+
+  if (!count) return 1;
+
+  {
+    unsigned int newCount = logMessageItems.count + count;
+
+    if (newCount > logMessageItems.size) {
+      LogMessageItem *newArray = realloc(logMessageItems.array, ARRAY_SIZE(newArray, newCount));
+
+      if (!newArray) {
+        logMallocError();
+
+        while (messages) {
+          const LogEntry *message = messages;
+          messages = getPreviousLogEntry(message);
+          deallocateLogEntry(message);
+        }
+
+        return 0;
+      }
+
+      logMessageItems.array = newArray;
+      logMessageItems.size = newCount;
+    }
+
+    {
+      LogMessageItem *item = &logMessageItems.array[newCount];
+
+      while (messages) {
+        item -= 1;
+        memset(item, 0, sizeof(*item));
+        item->message = messages;
+        messages = getPreviousLogEntry(messages);
+      }
+    }
+
+    while (logMessageItems.count < newCount) {
+      LogMessageItem *item = &logMessageItems.array[logMessageItems.count];
+
+      if (!addLogMessageItem(item)) {
+        deallocateLogMessageItems(item, (newCount - logMessageItems.count));
+        return 0;
+      }
+
+      logMessageItems.count += 1;
+    }
+  }
+
+  {
+    unsigned int limit = getLogMessageHistorySize();
+
+    if (logMessageItems.count > limit) {
+      unsigned int excess = logMessageItems.count - limit;
+
+      /* the first item of a submenu is the one which closes it */
+      deleteMenuItems(logMessagesMenu, 1, excess);
+      deallocateLogMessageItems(logMessageItems.array, excess);
+
+      logMessageItems.count -= excess;
+      memmove(logMessageItems.array, &logMessageItems.array[excess],
+              ARRAY_SIZE(logMessageItems.array, logMessageItems.count));
+    }
+  }
+
+  return 1;
 }
 
 static Menu *
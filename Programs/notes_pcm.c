@@ -21,6 +21,7 @@
 #include <string.h>
 #include <errno.h>
 
+#include "parameters.h"
 #include "prefs.h"
 #include "log.h"
 #include "pcm.h"
@@ -28,6 +29,20 @@
 
 char *opt_pcmDevice;
 
+typedef struct PcmToneEntryStruct PcmToneEntry;
+
+struct PcmToneEntryStruct {
+  PcmToneEntry *newer;
+  PcmToneEntry *older;
+
+  unsigned int duration;
+  NoteFrequency frequency;
+  unsigned char volume;
+
+  size_t size;
+  unsigned char bytes[];
+};
+
 struct NoteDeviceStruct {
   PcmDevice *pcm;
 
@@ -40,8 +55,43 @@ struct NoteDeviceStruct {
   int blockUsed;
 
   PcmSampleMaker makeSample;
+  PcmSampleSize sampleSize;
+  int frameSize;
+
+  struct {
+    PcmToneEntry *newest;
+    PcmToneEntry *oldest;
+    unsigned int count;
+    size_t size;
+  } tones;
 };
 
+/* The calculations for triangle wave generation work out nicely and
+ * efficiently if we map a full period onto a 32-bit unsigned range.
+ */
+
+/* The two high-order bits specify which quarter wave a sample is for.
+ *   00 -> ascending from the negative peak to zero
+ *   01 -> ascending from zero to the positive peak
+ *   10 -> descending from the positive peak to zero
+ *   11 -> descending from zero to the negative peak
+ * The higher bit is 0 for the ascending segment and 1 for the
+ * descending segment. The lower bit is 0 when going from a peak to
+ * zero and 1 when going from zero to a peak.
+ */
+#define PCM_WAVE_MAGNITUDE_WIDTH (32 - 2)
+
+/* The amplitude is 0 when the lower bit of the quarter wave indicator
+ * is 1 and the rest of the (magnitude) bits are all 0.
+ */
+#define PCM_WAVE_ZERO_VALUE (UINT32_C(1) << PCM_WAVE_MAGNITUDE_WIDTH)
+
+typedef struct {
+  int32_t currentValue;
+  uint32_t stepsPerSample;
+  int32_t maximumAmplitude;
+} PcmWave;
+
 static int
 pcmFlushBytes (NoteDevice *device) {
   int ok = writePcmData(device->pcm, device->blockAddress, device->blockUsed);
@@ -79,6 +129,257 @@ pcmFlushBlock (NoteDevice *device) {
   return 1;
 }
 
+static int
+pcmWriteBytes (NoteDevice *device, const unsigned char *bytes, size_t count) {
+  if (device->blockUsed) {
+    size_t size = MIN(count, device->blockSize - device->blockUsed);
+
+    memcpy(&device->blockAddress[device->blockUsed], bytes, size);
+    device->blockUsed += size;
+    bytes += size;
+    count -= size;
+
+    if (device->blockUsed == device->blockSize) {
+      if (!pcmFlushBytes(device)) {
+        return 0;
+      }
+    }
+  }
+
+  {
+    size_t size = count - (count % device->blockSize);
+
+    if (size) {
+      if (!writePcmData(device->pcm, bytes, size)) return 0;
+      bytes += size;
+      count -= size;
+    }
+  }
+
+  if (count) {
+    memcpy(&device->blockAddress[device->blockUsed], bytes, count);
+    device->blockUsed += count;
+  }
+
+  return 1;
+}
+
+static int32_t
+pcmPrepareWave (NoteDevice *device, PcmWave *wave, int32_t sampleCount, NoteFrequency frequency) {
+  /* A triangle waveform sounds nice, is lightweight, and avoids
+   * relying too much on floating-point performance and/or on
+   * expensive math functions like sin(). Considerations like
+   * these are especially important on PDAs without any FPU.
+   */ 
+
+  /* We need to know the maximum amplitude based on the currently set
+   * volume percentage. This percentage then needs to be squared because
+   * we perceive loudness exponentially.
+   */
+  const unsigned char fullVolume = 100;
+  const unsigned char currentVolume = MIN(fullVolume, prefs.pcmVolume);
+  wave->maximumAmplitude = INT16_MAX
+                         * (currentVolume * currentVolume)
+                         / (fullVolume * fullVolume);
+
+  /* We need to know how many steps to make from one sample to the next.
+   * stepsPerSample = stepsPerWave * wavesPerSecond / samplesPerSecond
+   *                = stepsPerWave * frequency / sampleRate
+   *                = stepsPerWave / sampleRate * frequency
+   */
+  wave->stepsPerSample = (NoteFrequency)UINT32_MAX 
+                       / (NoteFrequency)device->sampleRate
+                       * frequency;
+
+  /* The current value needs to be a signed value so that the >> operator
+   * will extend its sign bit. We start by initializing it to the value
+   * that corresponds to the start of the first logical quarter wave
+   * (the one that ascends from zero to the positive peak).
+   */
+  wave->currentValue = PCM_WAVE_ZERO_VALUE;
+
+  /* Round the number of samples up to a whole number of periods:
+   * partialSteps = (sampleCount * stepsPerSample) % stepsPerWave
+   *
+   * With stepsPerWave being (1 << 32), we simply let the product
+   * overflow. The modulus corresponds to the remaining 32 low bits:
+   * partialSteps = (uint32_t)(sampleCount * stepsPerSample)
+   *
+   * missingSteps = stepsPerWave - partialSteps
+   *              = (uint32_t) -partialSteps
+
+   * extraSamples = missingSteps / stepsPerSample
+   */
+  if (wave->stepsPerSample) {
+    sampleCount += (uint32_t)(sampleCount * -wave->stepsPerSample) / wave->stepsPerSample;
+  }
+
+  return sampleCount;
+}
+
+static inline int16_t
+pcmNextAmplitude (PcmWave *wave) {
+  /* Convert the current 32-bit unsigned linear value to a 31-bit
+   * triangular amplitude by inverting its low-order 31 bits if its
+   * high-order (sign) bit is set.
+   */
+  int32_t amplitude = wave->currentValue ^ (wave->currentValue >> 31);
+
+  /* Convert the 31-bit amplitude from unsigned to signed. */
+  amplitude -= PCM_WAVE_ZERO_VALUE;
+
+  /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
+  amplitude >>= PCM_WAVE_MAGNITUDE_WIDTH - 16;
+
+  /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
+   * the currently set volume (15-bit value):
+   * (16-bit value) * (15-bit value) + (sign bit) = 32-bit signed value
+   */
+  amplitude *= wave->maximumAmplitude;
+
+  /* Convert the signed amplitude from 32 bits to 16 bits. */
+  amplitude >>= 16;
+
+  wave->currentValue += wave->stepsPerSample;
+  return amplitude;
+}
+
+static void
+pcmRenderFrames (NoteDevice *device, PcmWave *wave, unsigned char *bytes, int32_t count) {
+  /* Each frame is built in place: the sample for the first channel is made
+   * directly in the output and then replicated for the other channels.
+   */
+  const PcmSampleSize sampleSize = device->sampleSize;
+  const int frameSize = device->frameSize;
+  unsigned char *end = bytes + (count * frameSize);
+
+  while (bytes < end) {
+    int16_t amplitude = wave? pcmNextAmplitude(wave): 0;
+    device->makeSample((PcmSample *)bytes, amplitude);
+
+    for (int offset=sampleSize; offset<frameSize; offset+=sampleSize) {
+      memcpy(&bytes[offset], bytes, sampleSize);
+    }
+
+    bytes += frameSize;
+  }
+}
+
+static int
+pcmStreamFrames (NoteDevice *device, PcmWave *wave, int32_t count) {
+  while (count > 0) {
+    int32_t frames = MIN(count, (device->blockSize - device->blockUsed) / device->frameSize);
+
+    pcmRenderFrames(device, wave, &device->blockAddress[device->blockUsed], frames);
+    device->blockUsed += frames * device->frameSize;
+    count -= frames;
+
+    if (device->blockUsed == device->blockSize) {
+      if (!pcmFlushBytes(device)) {
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+static void
+pcmUnlinkTone (NoteDevice *device, PcmToneEntry *tone) {
+  if (tone->newer) {
+    tone->newer->older = tone->older;
+  } else {
+    device->tones.newest = tone->older;
+  }
+
+  if (tone->older) {
+    tone->older->newer = tone->newer;
+  } else {
+    device->tones.oldest = tone->newer;
+  }
+
+  tone->newer = tone->older = NULL;
+}
+
+static void
+pcmLinkTone (NoteDevice *device, PcmToneEntry *tone) {
+  tone->older = device->tones.newest;
+  tone->newer = NULL;
+
+  if (device->tones.newest) {
+    device->tones.newest->newer = tone;
+  } else {
+    device->tones.oldest = tone;
+  }
+
+  device->tones.newest = tone;
+}
+
+static void
+pcmRemoveTone (NoteDevice *device, PcmToneEntry *tone) {
+  pcmUnlinkTone(device, tone);
+  device->tones.count -= 1;
+  device->tones.size -= tone->size;
+  free(tone);
+}
+
+static void
+pcmClearTones (NoteDevice *device) {
+  while (device->tones.oldest) pcmRemoveTone(device, device->tones.oldest);
+}
+
+static PcmToneEntry *
+pcmFindTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency, unsigned char volume) {
+  PcmToneEntry *tone = device->tones.newest;
+
+  while (tone) {
+    if ((tone->duration == duration) && (tone->frequency == frequency) && (tone->volume == volume)) {
+      if (tone != device->tones.newest) {
+        pcmUnlinkTone(device, tone);
+        pcmLinkTone(device, tone);
+      }
+
+      return tone;
+    }
+
+    tone = tone->older;
+  }
+
+  return NULL;
+}
+
+static PcmToneEntry *
+pcmAddTone (
+  NoteDevice *device, PcmWave *wave, int32_t frames,
+  unsigned int duration, NoteFrequency frequency, unsigned char volume
+) {
+  size_t size = frames * device->frameSize;
+  PcmToneEntry *tone;
+
+  if (size > (PCM_TONE_CACHE_SIZE_LIMIT / 4)) return NULL;
+
+  while ((device->tones.count >= PCM_TONE_CACHE_ENTRY_LIMIT) ||
+         ((device->tones.size + size) > PCM_TONE_CACHE_SIZE_LIMIT)) {
+    pcmRemoveTone(device, device->tones.oldest);
+  }
+
+  if (!(tone = malloc(sizeof(*tone) + size))) {
+    logMallocError();
+    return NULL;
+  }
+
+  tone->duration = duration;
+  tone->frequency = frequency;
+  tone->volume = volume;
+  tone->size = size;
+  pcmRenderFrames(device, wave, tone->bytes, frames);
+
+  pcmLinkTone(device, tone);
+  device->tones.count += 1;
+  device->tones.size += size;
+  return tone;
+}
+
 static NoteDevice *
 pcmConstruct (int errorLevel) {
   NoteDevice *device;
@@ -95,12 +396,17 @@ pcmConstruct (int errorLevel) {
       device->blockUsed = 0;
       device->makeSample = getPcmSampleMaker(device->amplitudeFormat);
 
+      device->tones.newest = NULL;
+      device->tones.oldest = NULL;
+      device->tones.count = 0;
+      device->tones.size = 0;
+
       PcmSample sample;
-      PcmSampleSize sampleSize = device->makeSample(&sample, 0);
-      sampleSize *= device->channelCount;
+      device->sampleSize = device->makeSample(&sample, 0);
+      device->frameSize = device->sampleSize * device->channelCount;
 
-      if (sampleSize && device->blockSize &&
-          !(device->blockSize % sampleSize)) {
+      if (device->frameSize && device->blockSize &&
+          !(device->blockSize % device->frameSize)) {
         if ((device->blockAddress = malloc(device->blockSize))) {
           logMessage(LOG_DEBUG, "PCM enabled: BlkSz:%d Rate:%d ChnCt:%d Fmt:%d",
                      device->blockSize, device->sampleRate, device->channelCount, device->amplitudeFormat);
@@ -111,8 +417,8 @@ pcmConstruct (int errorLevel) {
       } else {
         logMessage(LOG_ERR,
                    "PCM block size not multiple of sample size:"
-                   " BlkSz:%d" " SmpSz:%u",
-                   device->blockSize, sampleSize);
+                   " BlkSz:%d" " SmpSz:%d",
+                   device->blockSize, device->frameSize);
       }
 
       closePcmDevice(device->pcm);
@@ -130,6 +436,7 @@ pcmConstruct (int errorLevel) {
 static void
 pcmDestruct (NoteDevice *device) {
   pcmFlushBlock(device);
+  pcmClearTones(device);
   free(device->blockAddress);
   closePcmDevice(device->pcm);
   free(device);
@@ -139,112 +446,31 @@ pcmDestruct (NoteDevice *device) {
 static int
 pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
   int32_t sampleCount = device->sampleRate * duration / 1000;
+  unsigned char volume = prefs.pcmVolume;
 
   logMessage(LOG_DEBUG, "tone: MSecs:%u SmpCt:%"PRId32 " Freq:%"PRIfreq,
              duration, sampleCount, frequency);
 
+  {
+    const PcmToneEntry *tone = pcmFindTone(device, duration, frequency, volume);
+    if (tone) return pcmWriteBytes(device, tone->bytes, tone->size);
+  }
+
   if (frequency) {
-    /* A triangle waveform sounds nice, is lightweight, and avoids
-     * relying too much on floating-point performance and/or on
-     * expensive math functions like sin(). Considerations like
-     * these are especially important on PDAs without any FPU.
-     */ 
-
-    /* We need to know the maximum amplitude based on the currently set
-     * volume percentage. This percentage then needs to be squared because
-     * we perceive loudness exponentially.
-     */
-    const unsigned char fullVolume = 100;
-    const unsigned char currentVolume = MIN(fullVolume, prefs.pcmVolume);
-    const int32_t maximumAmplitude = INT16_MAX
-                                   * (currentVolume * currentVolume)
-                                   / (fullVolume * fullVolume);
-
-    /* The calculations for triangle wave generation work out nicely and
-     * efficiently if we map a full period onto a 32-bit unsigned range.
-     */
-
-    /* The two high-order bits specify which quarter wave a sample is for.
-     *   00 -> ascending from the negative peak to zero
-     *   01 -> ascending from zero to the positive peak
-     *   10 -> descending from the positive peak to zero
-     *   11 -> descending from zero to the negative peak
-     * The higher bit is 0 for the ascending segment and 1 for the
-     * descending segment. The lower bit is 0 when going from a peak to
-     * zero and 1 when going from zero to a peak.
-     */
-    const uint8_t magnitudeWidth = 32 - 2;
-
-    /* The amplitude is 0 when the lower bit of the quarter wave indicator
-     * is 1 and the rest of the (magnitude) bits are all 0.
-     */
-    const uint32_t zeroValue = UINT32_C(1) << magnitudeWidth;
-
-    /* We need to know how many steps to make from one sample to the next.
-     * stepsPerSample = stepsPerWave * wavesPerSecond / samplesPerSecond
-     *                = stepsPerWave * frequency / sampleRate
-     *                = stepsPerWave / sampleRate * frequency
-     */
-    const uint32_t stepsPerSample = (NoteFrequency)UINT32_MAX 
-                                  / (NoteFrequency)device->sampleRate
-                                  * frequency;
-
-    /* The current value needs to be a signed value so that the >> operator
-     * will extend its sign bit. We start by initializing it to the value
-     * that corresponds to the start of the first logical quarter wave
-     * (the one that ascends from zero to the positive peak).
-     */
-    int32_t currentValue = zeroValue;
-
-    /* Round the number of samples up to a whole number of periods:
-     * partialSteps = (sampleCount * stepsPerSample) % stepsPerWave
-     *
-     * With stepsPerWave being (1 << 32), we simply let the product
-     * overflow. The modulus corresponds to the remaining 32 low bits:
-     * partialSteps = (uint32_t)(sampleCount * stepsPerSample)
-     *
-     * missingSteps = stepsPerWave - partialSteps
-     *              = (uint32_t) -partialSteps
-
-     * extraSamples = missingSteps / stepsPerSample
-     */
-    sampleCount += (uint32_t)(sampleCount * -stepsPerSample) / stepsPerSample;
-
-    while (sampleCount > 0) {
-      /* Convert the current 32-bit unsigned linear value to a 31-bit
-       * triangular amplitude by inverting its low-order 31 bits if its
-       * high-order (sign) bit is set.
-       */
-      int32_t amplitude = currentValue ^ (currentValue >> 31);
-
-      /* Convert the 31-bit amplitude from unsigned to signed. */
-      amplitude -= zeroValue;
-
-      /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
-      amplitude >>= magnitudeWidth - 16;
-
-      /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
-       * the currently set volume (15-bit value):
-       * (16-bit value) * (15-bit value) + (sign bit) = 32-bit signed value
-       */
-      amplitude *= maximumAmplitude;
-
-      /* Convert the signed amplitude from 32 bits to 16 bits. */
-      amplitude >>= 16;
-
-      if (!pcmWriteSample(device, amplitude)) break;
-      currentValue += stepsPerSample;
-      sampleCount -= 1;
+    PcmWave wave;
+    sampleCount = pcmPrepareWave(device, &wave, sampleCount, frequency);
+
+    {
+      PcmWave start = wave;
+      const PcmToneEntry *tone = pcmAddTone(device, &start, sampleCount, duration, frequency, volume);
+      if (tone) return pcmWriteBytes(device, tone->bytes, tone->size);
     }
+
+    return pcmStreamFrames(device, &wave, sampleCount);
   } else {
     /* generate silence */
-    while (sampleCount > 0) {
-      if (!pcmWriteSample(device, 0)) break;
-      sampleCount -= 1;
-    }
+    return pcmStreamFrames(device, NULL, sampleCount);
   }
-
-  return (sampleCount > 0) ? 0 : 1;
 }
 
 static int
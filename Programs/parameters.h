@@ -42,6 +42,8 @@ extern "C" {
 #define SPEECH_DRIVER_THREAD_STOP_TIMEOUT 5000
 
 #define SPEECH_RESPONSE_WAIT_TIMEOUT 5000
+#define SPEECH_REQUEST_POOL_SIZE 0X20
+#define SPEECH_REQUEST_POOL_DATA_SIZE 0X400
 
 #define SCREEN_DRIVER_START_RETRY_INTERVAL 5000
 #define SCREEN_FREEZE_REMINDER_INTERVAL 30000
@@ -57,8 +59,15 @@ extern "C" {
 #define TUNE_DEVICE_CLOSE_DELAY 2000
 #define TUNE_TOGGLE_REPEAT_DELAY 100
 
+#define PCM_TONE_CACHE_ENTRY_LIMIT 0X20
+#define PCM_TONE_CACHE_SIZE_LIMIT 0X80000
+
 #define MESSAGE_HOLD_TIMEOUT 4000
 
+#define CONTRACTION_CACHE_ENTRY_LIMIT 0X20
+#define CONTRACTION_CACHE_SIZE_LIMIT 0X20000
+#define CONTRACTION_PREFETCH_LIMIT 4
+
 #define LEARN_MODE_TIMEOUT 10000
 
 #define INPUT_STICKY_MODIFIERS_TIMEOUT 5000
@@ -49,6 +49,7 @@
 #define ROUTING_NICENESS	10	/* niceness of cursor routing subprocess */
 #define ROUTING_INTERVAL	1	/* how often to check for response */
 #define ROUTING_TIMEOUT	2000	/* max wait for response to key press */
+#define ROUTING_MONITOR_INTERVAL	20	/* max wait for a screen update notification */
 
 typedef enum {
   CRR_DONE,
@@ -89,6 +90,16 @@ typedef struct {
     long sum;
     int count;
   } time;
+
+  struct {
+    TimeValue start;
+    unsigned int keys;
+    unsigned int responses;
+    unsigned int updates;
+    unsigned int polls;
+    long int responseSum;
+    long int responseMaximum;
+  } metrics;
 } CursorRoutingData;
 
 typedef enum {
@@ -224,6 +235,30 @@ handleVerticalScrolling (CursorRoutingData *crd, int direction) {
   crd->current.row -= delta;
 }
 
+static int
+awaitScreenUpdate (CursorRoutingData *crd, const TimeValue *start, long int timeout) {
+  TimeValue now;
+  getMonotonicTime(&now);
+
+  long int wait = timeout - millisecondsBetween(start, &now) + 1;
+  if (wait > ROUTING_MONITOR_INTERVAL) wait = ROUTING_MONITOR_INTERVAL;
+  if (wait < 1) wait = 1;
+
+  switch (awaitRoutingScreenUpdate(wait)) {
+    case 1:
+      crd->metrics.updates += 1;
+      return 1;
+
+    case 0:
+      return 0;
+
+    default:
+      crd->metrics.polls += 1;
+      asyncWait(ROUTING_INTERVAL);
+      return 1;
+  }
+}
+
 static int
 awaitCursorMotion (CursorRoutingData *crd, int direction) {
   crd->previous.column = crd->current.column;
@@ -233,10 +268,11 @@ awaitCursorMotion (CursorRoutingData *crd, int direction) {
   getMonotonicTime(&start);
 
   int moved = 0;
+  int updated = 0;
   long int timeout = crd->time.sum / crd->time.count;
 
   while (1) {
-    asyncWait(ROUTING_INTERVAL);
+    if (awaitScreenUpdate(crd, &start, timeout)) updated = 1;
 
     TimeValue now;
     getMonotonicTime(&now);
@@ -256,6 +292,10 @@ awaitCursorMotion (CursorRoutingData *crd, int direction) {
 
         crd->time.sum += time * 8;
         crd->time.count += 1;
+
+        crd->metrics.responses += 1;
+        crd->metrics.responseSum += time;
+        if (time > crd->metrics.responseMaximum) crd->metrics.responseMaximum = time;
       }
 
       if (ROUTING_INTERVAL) {
@@ -269,7 +309,8 @@ awaitCursorMotion (CursorRoutingData *crd, int direction) {
     }
   }
 
-  handleVerticalScrolling(crd, direction);
+  /* If the driver reported no change at all then nothing has scrolled. */
+  if (updated || moved) handleVerticalScrolling(crd, direction);
   return 1;
 }
 
@@ -285,6 +326,7 @@ moveCursor (CursorRoutingData *crd, const CursorDirectionEntry *direction) {
 
   logRouting("move: %s", direction->name);
   insertScreenKey(direction->key);
+  crd->metrics.keys += 1;
 
 #ifdef SIGUSR1
   sigprocmask(SIG_SETMASK, &oldMask, NULL);
@@ -365,6 +407,21 @@ adjustCursorVertically (CursorRoutingData *crd, int where, int row) {
   return adjustCursorPosition(crd, where, row, -1, &cursorAxisTable[CURSOR_AXIS_VERTICAL]);
 }
 
+static void
+logRoutingMetrics (const CursorRoutingData *crd) {
+  TimeValue now;
+  getMonotonicTime(&now);
+
+  logRouting(
+    "metrics: Time:%ldms Keys:%u Responses:%u Average:%ldms Maximum:%ldms Updates:%u Polls:%u",
+    millisecondsBetween(&crd->metrics.start, &now),
+    crd->metrics.keys, crd->metrics.responses,
+    (crd->metrics.responses? (crd->metrics.responseSum / crd->metrics.responses): 0),
+    crd->metrics.responseMaximum,
+    crd->metrics.updates, crd->metrics.polls
+  );
+}
+
 typedef struct {
   int column;
   int row;
@@ -388,6 +445,9 @@ routeCursor (const RoutingParameters *parameters) {
   crd.time.sum = ROUTING_TIMEOUT;
   crd.time.count = 1;
 
+  memset(&crd.metrics, 0, sizeof(crd.metrics));
+  getMonotonicTime(&crd.metrics.start);
+
   if (getCurrentPosition(&crd)) {
     logRouting("from: [%d,%d]", crd.current.column, crd.current.row);
 
@@ -407,6 +467,7 @@ routeCursor (const RoutingParameters *parameters) {
   }
 
   if (crd.vertical.buffer) free(crd.vertical.buffer);
+  logRoutingMetrics(&crd);
 
   if (crd.screen.number != parameters->screen) return ROUTING_ERROR;
   if (crd.current.row != parameters->row) return ROUTING_WRONG_ROW;
@@ -28,6 +28,7 @@
 #include <string.h>
 
 #include "log.h"
+#include "async_wait.h"
 #include "scr.h"
 #include "scr_real.h"
 #include "driver.h"
@@ -101,6 +102,19 @@ describeScreen (ScreenDescription *description) {
   describeBaseScreen(currentScreen, description);
 }
 
+int
+getScreenDamage (ScreenDamage *damage) {
+  static const BaseScreen *damagedScreen = NULL;
+  int known = currentScreen->getDamage(damage);
+
+  if (currentScreen != damagedScreen) {
+    damagedScreen = currentScreen;
+    known = 0;
+  }
+
+  return known;
+}
+
 int
 readScreen (short left, short top, short width, short height, ScreenCharacter *buffer) {
   ScreenBox box;
@@ -192,6 +206,9 @@ getScreenCommandContext (void) {
 }
 
 
+static int routingScreenConstructed = 0;
+static unsigned int routingScreenUpdateCount = 0;
+
 int
 constructRoutingScreen (void) {
   /* This function should be used in a forked process. Though we want to
@@ -199,11 +216,40 @@ constructRoutingScreen (void) {
    * in the main thread.  So we close and reopen the device.
    */
   mainScreen.destruct();
-  return mainScreen.construct();
+  if (!mainScreen.construct()) return 0;
+
+  routingScreenConstructed = 1;
+  routingScreenUpdateCount = 0;
+  return 1;
 }
 
 void
 destructRoutingScreen (void) {
+  routingScreenConstructed = 0;
   mainScreen.destruct();
   mainScreen.releaseParameters();
 }
+
+int
+isRoutingScreen (void) {
+  return routingScreenConstructed;
+}
+
+void
+routingScreenUpdated (void) {
+  routingScreenUpdateCount += 1;
+}
+
+static ASYNC_CONDITION_TESTER(testRoutingScreenUpdated) {
+  const unsigned int *count = data;
+  return routingScreenUpdateCount != *count;
+}
+
+int
+awaitRoutingScreenUpdate (int timeout) {
+  unsigned int count = routingScreenUpdateCount;
+
+  if (!routingScreenConstructed) return -1;
+  if (mainScreen.base.poll()) return -1;
+  return asyncAwaitCondition(timeout, testRoutingScreenUpdated, &count);
+}
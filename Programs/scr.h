@@ -33,6 +33,7 @@ extern int isMainScreen (void);
 extern int pollScreen (void);
 extern int refreshScreen (void);
 extern void describeScreen (ScreenDescription *);		/* get screen status */
+extern int getScreenDamage (ScreenDamage *damage);
 extern int readScreen (short left, short top, short width, short height, ScreenCharacter *buffer);
 extern int readScreenText (short left, short top, short width, short height, wchar_t *buffer);
 extern int insertScreenKey (ScreenKey key);
@@ -67,6 +68,14 @@ readScreenRow (int row, int width, ScreenCharacter *buffer) {
 extern int constructRoutingScreen (void);
 extern void destructRoutingScreen (void);
 
+/* Wait for the screen driver to report that the routing screen has changed.
+ * Returns 1 if it has, 0 if the timeout expired first, and -1 if the driver
+ * can't report changes (the caller must then poll).
+ */
+extern int awaitRoutingScreenUpdate (int timeout);
+extern int isRoutingScreen (void);
+extern void routingScreenUpdated (void);
+
 extern const ScreenDriver *screen;
 extern const ScreenDriver noScreen;
 extern void setNoScreen (void);
@@ -141,6 +141,11 @@ describe_BaseScreen (ScreenDescription *description) {
   description->number = currentVirtualTerminal_BaseScreen();
 }
 
+static int
+getDamage_BaseScreen (ScreenDamage *damage) {
+  return 0;
+}
+
 static int
 readCharacters_BaseScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   ScreenDescription description;
@@ -192,6 +197,7 @@ initializeBaseScreen (BaseScreen *base) {
   base->poll = poll_BaseScreen;
   base->refresh = refresh_BaseScreen;
   base->describe = describe_BaseScreen;
+  base->getDamage = getDamage_BaseScreen;
 
   base->readCharacters = readCharacters_BaseScreen;
   base->insertKey = insertKey_BaseScreen;
@@ -26,10 +26,12 @@
 #include "async_alarm.h"
 #include "alert.h"
 #include "scr.h"
+#include "scr_utils.h"
 #include "scr_frozen.h"
 
 static ScreenDescription screenDescription;
 static ScreenCharacter *screenCharacters;
+static int screenDamageKnown;
 
 static int startFreezeReminderAlarm (void);
 static AsyncHandle freezeReminderAlarm = NULL;
@@ -69,6 +71,7 @@ construct_FrozenScreen (BaseScreen *source) {
     };
 
     if (source->readCharacters(&box, screenCharacters)) {
+      screenDamageKnown = 0;
       startFreezeReminderAlarm();
       return 1;
     }
@@ -97,6 +100,15 @@ describe_FrozenScreen (ScreenDescription *description) {
   *description = screenDescription;
 }
 
+static int
+getDamage_FrozenScreen (ScreenDamage *damage) {
+  int known = screenDamageKnown;
+
+  clearScreenDamage(damage);
+  screenDamageKnown = 1;
+  return known;
+}
+
 static int
 readCharacters_FrozenScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   if (validateScreenBox(box, screenDescription.cols, screenDescription.rows)) {
@@ -120,6 +132,7 @@ void
 initializeFrozenScreen (FrozenScreen *frozen) {
   initializeBaseScreen(&frozen->base);
   frozen->base.describe = describe_FrozenScreen;
+  frozen->base.getDamage = getDamage_FrozenScreen;
   frozen->base.readCharacters = readCharacters_FrozenScreen;
   frozen->base.currentVirtualTerminal = currentVirtualTerminal_FrozenScreen;
   frozen->construct = construct_FrozenScreen;
@@ -69,7 +69,9 @@ initializeMainScreen (MainScreen *main) {
 
 void
 mainScreenUpdated (void) {
-  if (isMainScreen()) {
+  if (isRoutingScreen()) {
+    routingScreenUpdated();
+  } else if (isMainScreen()) {
     scheduleUpdateIn("main screen updated", SCREEN_UPDATE_SCHEDULE_DELAY);
   }
 }
@@ -39,3 +39,24 @@ clearScreenCharacters (ScreenCharacter *characters, size_t count) {
   setScreenCharacterText(characters, WC_C(' '), count);
   setScreenCharacterAttributes(characters, SCR_COLOUR_DEFAULT, count);
 }
+
+void
+clearScreenDamage (ScreenDamage *damage) {
+  damage->top = damage->left = 0;
+  damage->bottom = damage->right = -1;
+}
+
+void
+addScreenDamage (ScreenDamage *damage, int left, int right, int top, int bottom) {
+  if (damage->bottom < damage->top) {
+    damage->left = left;
+    damage->right = right;
+    damage->top = top;
+    damage->bottom = bottom;
+  } else {
+    if (left < damage->left) damage->left = left;
+    if (right > damage->right) damage->right = right;
+    if (top < damage->top) damage->top = top;
+    if (bottom > damage->bottom) damage->bottom = bottom;
+  }
+}
@@ -29,6 +29,7 @@
 #include "spk.h"
 #include "async_wait.h"
 #include "async_event.h"
+#include "timing.h"
 #include "thread.h"
 #include "queue.h"
 
@@ -78,9 +79,25 @@ typedef enum {
   RSP_INTEGER
 } SpeechResponseType;
 
+typedef struct SpeechRequestStruct SpeechRequest;
+
 struct SpeechDriverThreadStruct {
   ThreadState threadState;
   Queue *requestQueue;
+  SpeechRequest *currentRequest;
+
+  struct {
+    unsigned char *slots;
+    SpeechRequest *free;
+  } requestPool;
+
+  struct {
+    unsigned int requests;
+    unsigned int coalesced;
+    unsigned int depthMaximum;
+    long int latencySum;
+    long int latencyMaximum;
+  } metrics;
 
   volatile SpeechSynthesizer *speechSynthesizer;
   char **driverParameters;
@@ -123,7 +140,27 @@ static const char *const speechRequestNames[] = {
   [REQ_SET_PUNCTUATION] = "set punctuation"
 };
 
-typedef struct {
+typedef enum {
+  LANE_CONTROL,
+  LANE_TEXT
+} SpeechRequestLane;
+
+static const SpeechRequestLane speechRequestLanes[] = {
+  [REQ_SAY_TEXT] = LANE_TEXT,
+  [REQ_MUTE_SPEECH] = LANE_CONTROL,
+  [REQ_DRAIN_SPEECH] = LANE_TEXT,
+
+  [REQ_SET_VOLUME] = LANE_CONTROL,
+  [REQ_SET_RATE] = LANE_CONTROL,
+  [REQ_SET_PITCH] = LANE_CONTROL,
+  [REQ_SET_PUNCTUATION] = LANE_CONTROL
+};
+
+struct SpeechRequestStruct {
+  SpeechRequest *next;
+  TimeValue enqueueTime;
+  unsigned isPooled:1;
+
   SpeechRequestType type;
 
   union {
@@ -153,7 +190,9 @@ typedef struct {
   } arguments;
 
   unsigned char data[0];
-} SpeechRequest;
+};
+
+#define SPEECH_REQUEST_SLOT_SIZE (sizeof(SpeechRequest) + SPEECH_REQUEST_POOL_DATA_SIZE)
 
 typedef struct {
   const void *address;
@@ -305,6 +344,80 @@ moveSpeechData (unsigned char *target, SpeechDatum *data) {
   }
 }
 
+static void
+allocateSpeechRequestPool (volatile SpeechDriverThread *sdt) {
+  unsigned char *slots;
+
+  if ((slots = malloc(SPEECH_REQUEST_POOL_SIZE * SPEECH_REQUEST_SLOT_SIZE))) {
+    unsigned int index = SPEECH_REQUEST_POOL_SIZE;
+
+    sdt->requestPool.slots = slots;
+    sdt->requestPool.free = NULL;
+
+    while (index > 0) {
+      SpeechRequest *req = (SpeechRequest *)(slots + (--index * SPEECH_REQUEST_SLOT_SIZE));
+
+      req->next = sdt->requestPool.free;
+      sdt->requestPool.free = req;
+    }
+  } else {
+    logMallocError();
+  }
+}
+
+static void
+deallocateSpeechRequestPool (volatile SpeechDriverThread *sdt) {
+  if (sdt->requestPool.slots) {
+    free(sdt->requestPool.slots);
+    sdt->requestPool.slots = NULL;
+    sdt->requestPool.free = NULL;
+  }
+}
+
+static SpeechRequest *
+newSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequestType type, SpeechDatum *data) {
+  SpeechRequest *req;
+  size_t dataSize = getSpeechDataSize(data);
+  int isPooled = 0;
+
+  if (sdt && sdt->requestPool.free && (dataSize <= SPEECH_REQUEST_POOL_DATA_SIZE)) {
+    req = sdt->requestPool.free;
+    sdt->requestPool.free = req->next;
+    isPooled = 1;
+  } else if (!(req = malloc(sizeof(*req) + dataSize))) {
+    logMallocError();
+    return NULL;
+  }
+
+  memset(req, 0, sizeof(*req));
+  req->isPooled = isPooled;
+  req->type = type;
+  moveSpeechData(req->data, data);
+  return req;
+}
+
+static void
+releaseSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
+  if (req) {
+    if (req->isPooled) {
+      req->next = sdt->requestPool.free;
+      sdt->requestPool.free = req;
+    } else {
+      free(req);
+    }
+  }
+}
+
+static void
+logSpeechMetrics (volatile SpeechDriverThread *sdt) {
+  logMessage(LOG_CATEGORY(SPEECH_EVENTS),
+    "metrics: Requests:%u Coalesced:%u Average:%ldms Maximum:%ldms Depth:%u",
+    sdt->metrics.requests, sdt->metrics.coalesced,
+    (sdt->metrics.requests? (sdt->metrics.latencySum / sdt->metrics.requests): 0),
+    sdt->metrics.latencyMaximum, sdt->metrics.depthMaximum
+  );
+}
+
 static inline void
 setResponsePending (volatile SpeechDriverThread *sdt) {
   sdt->response.type = RSP_PENDING;
@@ -336,6 +449,9 @@ handleSpeechMessage (volatile SpeechDriverThread *sdt, SpeechMessage *msg) {
   if (msg) {
     switch (msg->type) {
       case MSG_REQUEST_FINISHED:
+        releaseSpeechRequest(sdt, sdt->currentRequest);
+        sdt->currentRequest = NULL;
+
         setIntegerResponse(sdt, msg->arguments.requestFinished.result);
         sendSpeechRequest(sdt);
         break;
@@ -546,8 +662,6 @@ handleSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
         sendIntegerResponse(sdt, 0);
         break;
     }
-
-    free(req);
   } else {
     setThreadState(sdt, THD_STOPPING);
     sendIntegerResponse(sdt, 1);
@@ -589,6 +703,49 @@ muteSpeechRequestQueue (volatile SpeechDriverThread *sdt) {
   removeSpeechRequests(sdt, REQ_MUTE_SPEECH);
 }
 
+static int
+coalesceSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
+  Element *element = findSpeechRequestElement(sdt, req->type);
+
+  if (element) {
+    SpeechRequest *queued = getElementItem(element);
+
+    logSpeechRequest(req, "coalescing");
+    queued->arguments = req->arguments;
+    sdt->metrics.coalesced += 1;
+
+    releaseSpeechRequest(sdt, req);
+    return 1;
+  }
+
+  return 0;
+}
+
+static SpeechRequestLane
+getSpeechRequestLane (const SpeechRequest *req) {
+  if (!req) return LANE_CONTROL;
+  if (req->type >= ARRAY_COUNT(speechRequestLanes)) return LANE_TEXT;
+  return speechRequestLanes[req->type];
+}
+
+static int
+compareSpeechRequests (const void *newItem, const void *existingItem, void *queueData) {
+  return getSpeechRequestLane(newItem) < getSpeechRequestLane(existingItem);
+}
+
+static void
+updateSpeechMetrics (volatile SpeechDriverThread *sdt, const SpeechRequest *req) {
+  TimeValue now;
+  long int latency;
+
+  getMonotonicTime(&now);
+  latency = millisecondsBetween(&req->enqueueTime, &now);
+
+  sdt->metrics.requests += 1;
+  sdt->metrics.latencySum += latency;
+  if (latency > sdt->metrics.latencyMaximum) sdt->metrics.latencyMaximum = latency;
+}
+
 static void
 sendSpeechRequest (volatile SpeechDriverThread *sdt) {
   while (getQueueSize(sdt->requestQueue) > 0) {
@@ -597,9 +754,13 @@ sendSpeechRequest (volatile SpeechDriverThread *sdt) {
     logSpeechRequest(req, "sending");
     setResponsePending(sdt);
 
+    if (req) updateSpeechMetrics(sdt, req);
+    sdt->currentRequest = req;
+
 #ifdef GOT_PTHREADS
     if (!asyncSignalEvent(sdt->requestEvent, req)) {
-      if (req) free(req);
+      sdt->currentRequest = NULL;
+      releaseSpeechRequest(sdt, req);
       setIntegerResponse(sdt, 0);
       continue;
     }
@@ -615,10 +776,15 @@ static int
 enqueueSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
   if (testThreadValidity(sdt)) {
     logSpeechRequest(req, "enqueuing");
+    if (req) getMonotonicTime(&req->enqueueTime);
 
     if (enqueueItem(sdt->requestQueue, req)) {
+      unsigned int depth = getQueueSize(sdt->requestQueue);
+
+      if (depth > sdt->metrics.depthMaximum) sdt->metrics.depthMaximum = depth;
+
       if (sdt->response.type != RSP_PENDING) {
-        if (getQueueSize(sdt->requestQueue) == 1) {
+        if (depth == 1) {
           sendSpeechRequest(sdt);
         }
       }
@@ -630,23 +796,6 @@ enqueueSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
   return 0;
 }
 
-static SpeechRequest *
-newSpeechRequest (SpeechRequestType type, SpeechDatum *data) {
-  SpeechRequest *req;
-  size_t size = sizeof(*req) + getSpeechDataSize(data);
-
-  if ((req = malloc(size))) {
-    memset(req, 0, sizeof(*req));
-    req->type = type;
-    moveSpeechData(req->data, data);
-    return req;
-  } else {
-    logMallocError();
-  }
-
-  return NULL;
-}
-
 int
 speechRequest_sayText (
   volatile SpeechDriverThread *sdt,
@@ -661,7 +810,7 @@ speechRequest_sayText (
     {.address=attributes, .size=count},
   END_SPEECH_DATA
 
-  if ((req = newSpeechRequest(REQ_SAY_TEXT, data))) {
+  if ((req = newSpeechRequest(sdt, REQ_SAY_TEXT, data))) {
     req->arguments.sayText.text = data[0].address;
     req->arguments.sayText.length = length;
     req->arguments.sayText.count = count;
@@ -671,7 +820,7 @@ speechRequest_sayText (
     if (options & SAY_OPT_MUTE_FIRST) muteSpeechRequestQueue(sdt);
     if (enqueueSpeechRequest(sdt, req)) return 1;
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -683,11 +832,11 @@ speechRequest_muteSpeech (
 ) {
   SpeechRequest *req;
 
-  if ((req = newSpeechRequest(REQ_MUTE_SPEECH, NULL))) {
+  if ((req = newSpeechRequest(sdt, REQ_MUTE_SPEECH, NULL))) {
     muteSpeechRequestQueue(sdt);
     if (enqueueSpeechRequest(sdt, req)) return 1;
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -699,13 +848,13 @@ speechRequest_drainSpeech (
 ) {
   SpeechRequest *req;
 
-  if ((req = newSpeechRequest(REQ_DRAIN_SPEECH, NULL))) {
+  if ((req = newSpeechRequest(sdt, REQ_DRAIN_SPEECH, NULL))) {
     if (enqueueSpeechRequest(sdt, req)) {
       awaitSpeechResponse(sdt, SPEECH_RESPONSE_WAIT_TIMEOUT);
       return 1;
     }
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -718,11 +867,12 @@ speechRequest_setVolume (
 ) {
   SpeechRequest *req;
 
-  if ((req = newSpeechRequest(REQ_SET_VOLUME, NULL))) {
+  if ((req = newSpeechRequest(sdt, REQ_SET_VOLUME, NULL))) {
     req->arguments.setVolume.setting = setting;
+    if (coalesceSpeechRequest(sdt, req)) return 1;
     if (enqueueSpeechRequest(sdt, req)) return 1;
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -735,11 +885,12 @@ speechRequest_setRate (
 ) {
   SpeechRequest *req;
 
-  if ((req = newSpeechRequest(REQ_SET_RATE, NULL))) {
+  if ((req = newSpeechRequest(sdt, REQ_SET_RATE, NULL))) {
     req->arguments.setRate.setting = setting;
+    if (coalesceSpeechRequest(sdt, req)) return 1;
     if (enqueueSpeechRequest(sdt, req)) return 1;
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -752,11 +903,12 @@ speechRequest_setPitch (
 ) {
   SpeechRequest *req;
 
-  if ((req = newSpeechRequest(REQ_SET_PITCH, NULL))) {
+  if ((req = newSpeechRequest(sdt, REQ_SET_PITCH, NULL))) {
     req->arguments.setPitch.setting = setting;
+    if (coalesceSpeechRequest(sdt, req)) return 1;
     if (enqueueSpeechRequest(sdt, req)) return 1;
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -769,11 +921,12 @@ speechRequest_setPunctuation (
 ) {
   SpeechRequest *req;
 
-  if ((req = newSpeechRequest(REQ_SET_PUNCTUATION, NULL))) {
+  if ((req = newSpeechRequest(sdt, REQ_SET_PUNCTUATION, NULL))) {
     req->arguments.setPunctuation.setting = setting;
+    if (coalesceSpeechRequest(sdt, req)) return 1;
     if (enqueueSpeechRequest(sdt, req)) return 1;
 
-    free(req);
+    releaseSpeechRequest(sdt, req);
   }
 
   return 0;
@@ -860,8 +1013,10 @@ static void
 deallocateSpeechRequest (void *item, void *data) {
   SpeechRequest *req = item;
 
+  volatile SpeechDriverThread *sdt = data;
+
   logSpeechRequest(req, "unqueuing");
-  free(req);
+  releaseSpeechRequest(sdt, req);
 }
 
 int
@@ -879,7 +1034,9 @@ constructSpeechDriverThread (
     sdt->speechSynthesizer = spk;
     sdt->driverParameters = parameters;
 
-    if ((sdt->requestQueue = newQueue(deallocateSpeechRequest, NULL))) {
+    if ((sdt->requestQueue = newQueue(deallocateSpeechRequest, compareSpeechRequests))) {
+      setQueueData(sdt->requestQueue, (void *)sdt);
+      allocateSpeechRequestPool(sdt);
       spk->driver.thread = sdt;
 
 #ifdef GOT_PTHREADS
@@ -922,6 +1079,7 @@ constructSpeechDriverThread (
 
       spk->driver.thread = NULL;
       deallocateQueue(sdt->requestQueue);
+      deallocateSpeechRequestPool(sdt);
     }
 
     free((void *)sdt);
@@ -956,8 +1114,12 @@ destroySpeechDriverThread (volatile SpeechSynthesizer *spk) {
   setThreadState(sdt, THD_FINISHED);
 #endif /* GOT_PTHREADS */
 
+  logSpeechMetrics(sdt);
   sdt->speechSynthesizer->driver.thread = NULL;
   deallocateQueue(sdt->requestQueue);
+
+  releaseSpeechRequest(sdt, sdt->currentRequest);
+  deallocateSpeechRequestPool(sdt);
   free((void *)sdt);
 }
 #endif /* ENABLE_SPEECH_SUPPORT */
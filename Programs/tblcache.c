@@ -0,0 +1,499 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2018 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#include "log.h"
+#include "file.h"
+#include "thread.h"
+#include "tblcache.h"
+
+/*
+ * A cache file holds the compiled (position-independent) image of a table
+ * together with the identity (device, inode, size, modification time) of
+ * every source file which was read while compiling it. The image is only
+ * used if all of those files are still the same. The image starts on a page
+ * boundary so that it can be mapped read-only (and shared) as is.
+ *
+ * TABLE_CACHE_FORMAT must be incremented whenever the layout of any of the
+ * cached table images changes.
+ */
+
+#define TABLE_CACHE_DIRECTORY "table-cache"
+#define TABLE_CACHE_MAGIC "BRLTTY-TABLE-CACHE"
+#define TABLE_CACHE_FORMAT 1
+#define TABLE_CACHE_SOURCES_LIMIT 0X10000
+
+typedef struct {
+  char magic[0X18];
+  char version[0X18];
+  char type[0X08];
+  uint32_t format;
+  uint32_t layout;
+  uint32_t sourceCount;
+  uint32_t sourcesSize;
+  uint64_t imageOffset;
+  uint64_t imageSize;
+} TableCacheHeader;
+
+typedef struct {
+  uint64_t device;
+  uint64_t inode;
+  uint64_t size;
+  int64_t modified;
+  uint32_t nanoseconds;
+  uint32_t pathLength;
+} TableCacheSource;
+
+struct TableCacheStruct {
+  char *path;
+  TableCacheHeader header;
+
+  struct {
+    unsigned char *buffer;
+    size_t size;
+    size_t used;
+    unsigned int count;
+  } sources;
+
+  unsigned uncacheable:1;
+};
+
+typedef struct {
+  TableCache *cache;
+} TableCacheThreadSpecificData;
+
+static THREAD_SPECIFIC_DATA_NEW(tsdTableCache) {
+  TableCacheThreadSpecificData *tsd;
+
+  if ((tsd = malloc(sizeof(*tsd)))) {
+    memset(tsd, 0, sizeof(*tsd));
+    tsd->cache = NULL;
+    return tsd;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static THREAD_SPECIFIC_DATA_DESTROY(tsdTableCache) {
+  TableCacheThreadSpecificData *tsd = data;
+  if (tsd) free(tsd);
+}
+
+THREAD_SPECIFIC_DATA_CONTROL(tsdTableCache);
+
+static TableCacheThreadSpecificData *
+getTableCacheThreadSpecificData (void) {
+  return getThreadSpecificData(&tsdTableCache);
+}
+
+static size_t
+getTableCachePageSize (void) {
+#if defined(_SC_PAGESIZE)
+  long size = sysconf(_SC_PAGESIZE);
+  if (size > 0) return size;
+#endif /* _SC_PAGESIZE */
+
+  return 0X1000;
+}
+
+static char *
+makeTableCachePath (const char *type, const char *path) {
+  char *directory = makeWritablePath(TABLE_CACHE_DIRECTORY);
+
+  if (directory) {
+    char *file = NULL;
+
+    if (ensureDirectory(directory)) {
+      uint64_t hash = UINT64_C(0XCBF29CE484222325);
+
+      {
+        const char *strings[] = {type, path, NULL};
+        const char *const *string = strings;
+
+        while (*string) {
+          const unsigned char *byte = (const unsigned char *)*string++;
+
+          do {
+            hash ^= *byte;
+            hash *= UINT64_C(0X100000001B3);
+          } while (*byte++);
+        }
+      }
+
+      {
+        char name[0X40];
+
+        snprintf(name, sizeof(name), "%016" PRIX64 "%s", hash, type);
+        file = makePath(directory, name);
+      }
+    }
+
+    free(directory);
+    return file;
+  }
+
+  return NULL;
+}
+
+TableCache *
+beginTableCache (const char *type, const char *path, size_t layout) {
+  TableCacheThreadSpecificData *tsd = getTableCacheThreadSpecificData();
+
+  if (tsd && !tsd->cache) {
+    TableCache *cache;
+
+    if ((cache = malloc(sizeof(*cache)))) {
+      memset(cache, 0, sizeof(*cache));
+
+      cache->sources.buffer = NULL;
+      cache->sources.size = 0;
+      cache->sources.used = 0;
+      cache->sources.count = 0;
+      cache->uncacheable = 0;
+
+      {
+        TableCacheHeader *header = &cache->header;
+
+        snprintf(header->magic, sizeof(header->magic), "%s", TABLE_CACHE_MAGIC);
+        snprintf(header->version, sizeof(header->version), "%s", PACKAGE_VERSION);
+        snprintf(header->type, sizeof(header->type), "%s", type);
+        header->format = TABLE_CACHE_FORMAT;
+        header->layout = layout;
+      }
+
+      if ((cache->path = makeTableCachePath(type, path))) {
+        tsd->cache = cache;
+        return cache;
+      }
+
+      free(cache);
+    } else {
+      logMallocError();
+    }
+  }
+
+  return NULL;
+}
+
+void
+endTableCache (TableCache *cache) {
+  TableCacheThreadSpecificData *tsd = getTableCacheThreadSpecificData();
+
+  if (tsd && (tsd->cache == cache)) tsd->cache = NULL;
+  if (cache->sources.buffer) free(cache->sources.buffer);
+  free(cache->path);
+  free(cache);
+}
+
+static size_t
+getTableCacheSourceSize (size_t pathLength) {
+  size_t size = sizeof(TableCacheSource) + pathLength;
+  size_t alignment = __alignof__(TableCacheSource);
+
+  return (size + (alignment - 1)) / alignment * alignment;
+}
+
+static void
+setTableCacheSource (TableCacheSource *source, const struct stat *status) {
+  source->device = status->st_dev;
+  source->inode = status->st_ino;
+  source->size = status->st_size;
+  source->modified = status->st_mtime;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+  source->nanoseconds = status->st_mtim.tv_nsec;
+#else /* HAVE_STRUCT_STAT_ST_MTIM */
+  source->nanoseconds = 0;
+#endif /* HAVE_STRUCT_STAT_ST_MTIM */
+}
+
+void
+addTableCacheSource (const char *path, const struct stat *status) {
+  TableCacheThreadSpecificData *tsd = getTableCacheThreadSpecificData();
+  TableCache *cache = tsd? tsd->cache: NULL;
+
+  if (cache && !cache->uncacheable) {
+    size_t pathLength = strlen(path) + 1;
+    size_t size = getTableCacheSourceSize(pathLength);
+    size_t newUsed = cache->sources.used + size;
+
+    if (newUsed > TABLE_CACHE_SOURCES_LIMIT) {
+      cache->uncacheable = 1;
+      return;
+    }
+
+    if (newUsed > cache->sources.size) {
+      size_t newSize = (newUsed | 0XFFF) + 1;
+      unsigned char *newBuffer = realloc(cache->sources.buffer, newSize);
+
+      if (!newBuffer) {
+        logMallocError();
+        cache->uncacheable = 1;
+        return;
+      }
+
+      cache->sources.buffer = newBuffer;
+      cache->sources.size = newSize;
+    }
+
+    {
+      TableCacheSource *source = (TableCacheSource *)&cache->sources.buffer[cache->sources.used];
+
+      memset(source, 0, size);
+      setTableCacheSource(source, status);
+      source->pathLength = pathLength;
+      memcpy(source+1, path, pathLength);
+    }
+
+    cache->sources.used = newUsed;
+    cache->sources.count += 1;
+  }
+}
+
+void
+disableTableCache (void) {
+  TableCacheThreadSpecificData *tsd = getTableCacheThreadSpecificData();
+  TableCache *cache = tsd? tsd->cache: NULL;
+
+  if (cache) cache->uncacheable = 1;
+}
+
+static int
+readTableCacheBytes (int file, void *buffer, size_t size) {
+  unsigned char *bytes = buffer;
+
+  while (size > 0) {
+    ssize_t count = read(file, bytes, size);
+
+    if (count == -1) {
+      if (errno == EINTR) continue;
+      return 0;
+    }
+
+    if (count == 0) return 0;
+    bytes += count;
+    size -= count;
+  }
+
+  return 1;
+}
+
+static int
+writeTableCacheBytes (int file, const void *buffer, size_t size) {
+  const unsigned char *bytes = buffer;
+
+  while (size > 0) {
+    ssize_t count = write(file, bytes, size);
+
+    if (count == -1) {
+      if (errno == EINTR) continue;
+      return 0;
+    }
+
+    bytes += count;
+    size -= count;
+  }
+
+  return 1;
+}
+
+static int
+verifyTableCacheSources (const unsigned char *buffer, size_t size, unsigned int count) {
+  const unsigned char *end = buffer + size;
+
+  while (count > 0) {
+    const TableCacheSource *source = (const TableCacheSource *)buffer;
+    struct stat status;
+    TableCacheSource current;
+
+    if ((size_t)(end - buffer) < sizeof(*source)) return 0;
+    if (source->pathLength < 1) return 0;
+    if (source->pathLength > (size_t)(end - buffer - sizeof(*source))) return 0;
+
+    {
+      const char *path = (const char *)(source + 1);
+
+      if (path[source->pathLength - 1]) return 0;
+      if (stat(path, &status) == -1) return 0;
+    }
+
+    setTableCacheSource(&current, &status);
+    if (current.device != source->device) return 0;
+    if (current.inode != source->inode) return 0;
+    if (current.size != source->size) return 0;
+    if (current.modified != source->modified) return 0;
+    if (current.nanoseconds != source->nanoseconds) return 0;
+
+    buffer += getTableCacheSourceSize(source->pathLength);
+    count -= 1;
+  }
+
+  return 1;
+}
+
+static int
+verifyTableCacheHeader (const TableCache *cache, const TableCacheHeader *header) {
+  if (memcmp(header->magic, cache->header.magic, sizeof(header->magic)) != 0) return 0;
+  if (memcmp(header->version, cache->header.version, sizeof(header->version)) != 0) return 0;
+  if (memcmp(header->type, cache->header.type, sizeof(header->type)) != 0) return 0;
+  if (header->format != cache->header.format) return 0;
+  if (header->layout != cache->header.layout) return 0;
+  if (header->sourcesSize > TABLE_CACHE_SOURCES_LIMIT) return 0;
+  if (header->imageOffset < (sizeof(*header) + header->sourcesSize)) return 0;
+  if (header->imageOffset % getTableCachePageSize()) return 0;
+  if (header->imageSize < header->layout) return 0;
+  return 1;
+}
+
+static void *
+readTableCacheImage (int file, const TableCacheHeader *header) {
+#ifdef HAVE_SYS_MMAN_H
+  void *image = mmap(NULL, header->imageSize, PROT_READ, MAP_SHARED, file, header->imageOffset);
+  if (image != MAP_FAILED) return image;
+  logSystemError("mmap");
+#else /* HAVE_SYS_MMAN_H */
+  void *image = malloc(header->imageSize);
+
+  if (image) {
+    if (lseek(file, header->imageOffset, SEEK_SET) != -1) {
+      if (readTableCacheBytes(file, image, header->imageSize)) {
+        return image;
+      }
+    }
+
+    free(image);
+  } else {
+    logMallocError();
+  }
+#endif /* HAVE_SYS_MMAN_H */
+
+  return NULL;
+}
+
+void *
+loadTableCacheImage (TableCache *cache, size_t *size) {
+  void *image = NULL;
+  TableCacheHeader header;
+  int file;
+
+  if ((file = open(cache->path, O_RDONLY)) != -1) {
+    if (readTableCacheBytes(file, &header, sizeof(header))) {
+      if (verifyTableCacheHeader(cache, &header)) {
+        unsigned char *sources;
+
+        if ((sources = malloc(header.sourcesSize))) {
+          if (readTableCacheBytes(file, sources, header.sourcesSize)) {
+            if (verifyTableCacheSources(sources, header.sourcesSize, header.sourceCount)) {
+              struct stat status;
+
+              if (fstat(file, &status) != -1) {
+                if ((uint64_t)status.st_size == (header.imageOffset + header.imageSize)) {
+                  image = readTableCacheImage(file, &header);
+                }
+              }
+            }
+          }
+
+          free(sources);
+        } else {
+          logMallocError();
+        }
+      }
+    }
+
+    close(file);
+  }
+
+  if (image) {
+    *size = header.imageSize;
+    logMessage(LOG_DEBUG, "table cache loaded: %s", cache->path);
+  }
+
+  return image;
+}
+
+int
+saveTableCacheImage (TableCache *cache, const void *image, size_t size) {
+  int saved = 0;
+
+  if (!cache->uncacheable && cache->sources.count) {
+    char path[strlen(cache->path) + 0X20];
+    int file;
+
+    snprintf(path, sizeof(path), "%s.%ld", cache->path, (long)getpid());
+
+    if ((file = open(path, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH)) != -1) {
+      TableCacheHeader header = cache->header;
+      size_t pageSize = getTableCachePageSize();
+
+      header.sourceCount = cache->sources.count;
+      header.sourcesSize = cache->sources.used;
+      header.imageOffset = (sizeof(header) + header.sourcesSize + (pageSize - 1)) / pageSize * pageSize;
+      header.imageSize = size;
+
+      if (writeTableCacheBytes(file, &header, sizeof(header)) &&
+          writeTableCacheBytes(file, cache->sources.buffer, cache->sources.used) &&
+          (lseek(file, header.imageOffset, SEEK_SET) != -1) &&
+          writeTableCacheBytes(file, image, size)) {
+        saved = 1;
+      } else {
+        logSystemError("table cache write");
+      }
+
+      if (close(file) == -1) saved = 0;
+
+      if (saved) {
+        if (rename(path, cache->path) == -1) {
+          logSystemError("table cache rename");
+          saved = 0;
+        }
+      }
+
+      if (saved) {
+        logMessage(LOG_DEBUG, "table cache saved: %s", cache->path);
+      } else {
+        unlink(path);
+      }
+    } else {
+      logMessage(LOG_WARNING, "cannot create table cache: %s: %s", path, strerror(errno));
+    }
+  }
+
+  return saved;
+}
+
+void
+releaseTableCacheImage (void *image, size_t size) {
+#ifdef HAVE_SYS_MMAN_H
+  if (munmap(image, size) == -1) logSystemError("munmap");
+#else /* HAVE_SYS_MMAN_H */
+  free(image);
+#endif /* HAVE_SYS_MMAN_H */
+}
@@ -24,6 +24,7 @@
 #include "file.h"
 #include "datafile.h"
 #include "dataarea.h"
+#include "tblcache.h"
 #include "charset.h"
 #include "ttb.h"
 #include "ttb_internal.h"
@@ -207,6 +208,9 @@ int
 setTextTableByte (TextTableData *ttd, unsigned char byte, unsigned char dots) {
   wint_t character = convertCharToWchar(byte);
 
+  /* the result depends on the charset so it mustn't be cached */
+  disableTableCache();
+
   if (character != WEOF)
     if (!setTextTableCharacter(ttd, character, dots))
       return 0;
@@ -341,28 +345,50 @@ processTextTableLines (FILE *stream, const char *name, DataOperandsProcessor *pr
   return NULL;
 }
 
-TextTable *
-makeTextTable (TextTableData *ttd) {
+static TextTable *
+newTextTable (TextTableHeader *header, size_t size) {
   TextTable *table = malloc(sizeof(*table));
 
   if (table) {
     memset(table, 0, sizeof(*table));
 
-    table->header.fields = getTextTableHeader(ttd);
-    table->size = getDataSize(ttd->area);
+    table->header.fields = header;
+    table->size = size;
 
     table->options.tryBaseCharacter = 1;
-
-    resetDataArea(ttd->area);
   }
 
   return table;
 }
 
+TextTable *
+makeTextTable (TextTableData *ttd) {
+  TextTable *table = newTextTable(getTextTableHeader(ttd), getDataSize(ttd->area));
+
+  if (table) resetDataArea(ttd->area);
+  return table;
+}
+
+TextTable *
+makeCachedTextTable (void *image, size_t size) {
+  TextTable *table = newTextTable(image, size);
+
+  if (table) table->fromCache = 1;
+  return table;
+}
+
 void
 destroyTextTable (TextTable *table) {
   if (table->size) {
-    free(table->header.fields);
+    if (table->cache.cells) free(table->cache.cells);
+    if (table->fallbacks.entries) free(table->fallbacks.entries);
+
+    if (table->fromCache) {
+      releaseTableCacheImage(table->header.fields, table->size);
+    } else {
+      free(table->header.fields);
+    }
+
     free(table);
   }
 }
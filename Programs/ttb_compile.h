@@ -33,6 +33,7 @@ extern void destroyTextTableData (TextTableData *ttd);
 
 extern TextTableData *processTextTableLines (FILE *stream, const char *name, DataOperandsProcessor *processOperands);
 extern TextTable *makeTextTable (TextTableData *ttd);
+extern TextTable *makeCachedTextTable (void *image, size_t size);
 
 typedef TextTableData *TextTableProcessor (FILE *stream, const char *name);
 extern TextTableProcessor processTextTableStream;
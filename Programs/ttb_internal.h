@@ -60,6 +60,13 @@ typedef struct {
   uint32_t aliasCount;
 } TextTableHeader;
 
+typedef struct {
+  wchar_t character;
+  unsigned char dots;
+  unsigned defined:1;
+  unsigned resolved:1;
+} TextTableFallbackEntry;
+
 struct TextTableStruct {
   union {
     TextTableHeader *fields;
@@ -67,10 +74,25 @@ struct TextTableStruct {
   } header;
 
   size_t size;
+  unsigned fromCache:1;
 
   struct {
     unsigned char tryBaseCharacter;
   } options;
+
+  struct {
+    unsigned short *cells;
+    unsigned failed:1;
+  } cache;
+
+  struct {
+    TextTableFallbackEntry *entries;
+    unsigned int size;
+    unsigned int count;
+
+    unsigned int hits;
+    unsigned int misses;
+  } fallbacks;
 };
 
 extern const TextTableAliasEntry *locateTextTableAlias (
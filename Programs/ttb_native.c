@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include "file.h"
+#include "tblcache.h"
 #include "ttb.h"
 #include "ttb_internal.h"
 #include "ttb_compile.h"
@@ -215,19 +216,37 @@ processTextTableStream (FILE *stream, const char *name) {
 TextTable *
 compileTextTable (const char *name) {
   TextTable *table = NULL;
-  FILE *stream;
+  TableCache *cache = beginTableCache(TEXT_TABLE_EXTENSION, name, sizeof(TextTableHeader));
 
-  if ((stream = openDataFile(name, "r", 0))) {
-    TextTableData *ttd;
+  if (cache) {
+    size_t size;
+    void *image = loadTableCacheImage(cache, &size);
 
-    if ((ttd = processTextTableStream(stream, name))) {
-      table = makeTextTable(ttd);
-
-      destroyTextTableData(ttd);
+    if (image) {
+      if (!(table = makeCachedTextTable(image, size))) {
+        releaseTableCacheImage(image, size);
+      }
     }
+  }
+
+  if (!table) {
+    FILE *stream;
+
+    if ((stream = openDataFile(name, "r", 0))) {
+      TextTableData *ttd;
 
-    fclose(stream);
+      if ((ttd = processTextTableStream(stream, name))) {
+        if ((table = makeTextTable(ttd))) {
+          if (cache) saveTableCacheImage(cache, table->header.bytes, table->size);
+        }
+
+        destroyTextTableData(ttd);
+      }
+
+      fclose(stream);
+    }
   }
 
+  if (cache) endTableCache(cache);
   return table;
 }
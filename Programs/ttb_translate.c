@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include "log.h"
 #include "file.h"
@@ -26,6 +27,7 @@
 #include "ttb.h"
 #include "ttb_internal.h"
 #include "brl_dots.h"
+#include "thread.h"
 
 static const unsigned char internalTextTableBytes[] = {
 #include "text.auto.h"
@@ -86,9 +88,49 @@ getUnicodeCellEntry (TextTable *table, wchar_t character) {
   return NULL;
 }
 
+#define TEXT_TABLE_CACHE_MASK (UNICODE_ROW_MASK | UNICODE_CELL_MASK)
+#define TEXT_TABLE_CACHE_SIZE (UNICODE_ROWS_PER_PLANE * UNICODE_CELLS_PER_ROW)
+#define TEXT_TABLE_CACHE_DEFINED 0X100
+
+static void
+resetTextTableCache (TextTable *table) {
+  if (table->cache.cells) {
+    memset(table->cache.cells, 0, ARRAY_SIZE(table->cache.cells, TEXT_TABLE_CACHE_SIZE));
+  }
+}
+
+static unsigned short *
+getTextTableCache (TextTable *table) {
+  if (!table->cache.cells && !table->cache.failed) {
+    static CriticalSectionLock cacheLock = CRITICAL_SECTION_LOCK_INITIALIZER;
+    int failed = 0;
+
+    enterCriticalSection(&cacheLock);
+
+    if (!table->cache.cells && !table->cache.failed) {
+      unsigned short *cells = calloc(TEXT_TABLE_CACHE_SIZE, sizeof(*cells));
+
+      if (cells) {
+        table->cache.cells = cells;
+      } else {
+        table->cache.failed = 1;
+        failed = 1;
+      }
+    }
+
+    leaveCriticalSection(&cacheLock);
+    if (failed) logMallocError();
+  }
+
+  return table->cache.cells;
+}
+
 void
 setTryBaseCharacter (TextTable *table, unsigned char yes) {
-  table->options.tryBaseCharacter = yes;
+  if (yes != table->options.tryBaseCharacter) {
+    table->options.tryBaseCharacter = yes;
+    resetTextTableCache(table);
+  }
 }
 
 static int
@@ -136,8 +178,158 @@ setBrailleRepresentation (wchar_t character, void *data) {
   return 0;
 }
 
-unsigned char
-convertCharacterToDots (TextTable *table, wchar_t character) {
+#define TEXT_TABLE_FALLBACKS_INITIAL_SIZE 0X40
+#define TEXT_TABLE_FALLBACKS_MAXIMUM_SIZE 0X4000
+#define TEXT_TABLE_FALLBACKS_LOG_INTERVAL 0X1000
+
+static CriticalSectionLock fallbacksLock = CRITICAL_SECTION_LOCK_INITIALIZER;
+
+static TextTableFallbackEntry *
+findTextTableFallback (TextTableFallbackEntry *entries, unsigned int size, wchar_t character) {
+  unsigned int mask = size - 1;
+  unsigned int index = (((uint32_t)character * UINT32_C(0X9E3779B1)) >> 16) & mask;
+
+  while (1) {
+    TextTableFallbackEntry *entry = &entries[index];
+
+    if (!entry->defined) return entry;
+    if (entry->character == character) return entry;
+    index = (index + 1) & mask;
+  }
+}
+
+static void
+logTextTableFallbacks (const char *action, unsigned int hits, unsigned int misses, unsigned int count) {
+  logMessage(LOG_CATEGORY(TEXT_TABLES),
+             "fallbacks %s: Hits:%u Misses:%u Entries:%u",
+             action, hits, misses, count);
+}
+
+static int
+getTextTableFallback (TextTable *table, wchar_t character, TextTableFallbackEntry *fallback) {
+  int found = 0;
+  int log;
+  unsigned int hits;
+  unsigned int misses;
+  unsigned int count;
+
+  enterCriticalSection(&fallbacksLock);
+
+  if (table->fallbacks.entries) {
+    const TextTableFallbackEntry *entry = findTextTableFallback(
+      table->fallbacks.entries, table->fallbacks.size, character
+    );
+
+    if (entry->defined) {
+      *fallback = *entry;
+      found = 1;
+    }
+  }
+
+  if (found) {
+    table->fallbacks.hits += 1;
+  } else {
+    table->fallbacks.misses += 1;
+  }
+
+  hits = table->fallbacks.hits;
+  misses = table->fallbacks.misses;
+  count = table->fallbacks.count;
+  log = !((hits + misses) % TEXT_TABLE_FALLBACKS_LOG_INTERVAL);
+
+  leaveCriticalSection(&fallbacksLock);
+
+  /* so that the hit rate can be watched while the table is in use */
+  if (log) logTextTableFallbacks("used", hits, misses, count);
+  return found;
+}
+
+static int
+resizeTextTableFallbacks (TextTable *table) {
+  unsigned int oldSize = table->fallbacks.size;
+  unsigned int newSize = oldSize? (oldSize << 1): TEXT_TABLE_FALLBACKS_INITIAL_SIZE;
+  TextTableFallbackEntry *oldEntries = table->fallbacks.entries;
+  TextTableFallbackEntry *newEntries;
+
+  if (newSize > TEXT_TABLE_FALLBACKS_MAXIMUM_SIZE) {
+    memset(oldEntries, 0, ARRAY_SIZE(oldEntries, oldSize));
+    table->fallbacks.count = 0;
+    return 1;
+  }
+
+  if (!(newEntries = calloc(newSize, sizeof(*newEntries)))) return 0;
+
+  {
+    const TextTableFallbackEntry *entry = oldEntries;
+    const TextTableFallbackEntry *end = entry + oldSize;
+
+    while (entry < end) {
+      if (entry->defined) *findTextTableFallback(newEntries, newSize, entry->character) = *entry;
+      entry += 1;
+    }
+  }
+
+  if (oldEntries) free(oldEntries);
+  table->fallbacks.entries = newEntries;
+  table->fallbacks.size = newSize;
+  return 1;
+}
+
+static void
+addTextTableFallback (TextTable *table, const TextTableFallbackEntry *fallback) {
+  int ok = 1;
+
+  enterCriticalSection(&fallbacksLock);
+
+  if (((table->fallbacks.count + 1) * 4) > (table->fallbacks.size * 3)) {
+    ok = resizeTextTableFallbacks(table);
+  }
+
+  if (ok) {
+    TextTableFallbackEntry *entry = findTextTableFallback(
+      table->fallbacks.entries, table->fallbacks.size, fallback->character
+    );
+
+    if (!entry->defined) {
+      *entry = *fallback;
+      entry->defined = 1;
+      table->fallbacks.count += 1;
+    }
+  }
+
+  leaveCriticalSection(&fallbacksLock);
+  if (!ok) logMallocError();
+}
+
+static void
+resetTextTableFallbacks (TextTable *table) {
+  unsigned int hits;
+  unsigned int misses;
+  unsigned int count;
+
+  enterCriticalSection(&fallbacksLock);
+
+  hits = table->fallbacks.hits;
+  misses = table->fallbacks.misses;
+  count = table->fallbacks.count;
+
+  if (table->fallbacks.entries) {
+    free(table->fallbacks.entries);
+    table->fallbacks.entries = NULL;
+  }
+
+  table->fallbacks.size = 0;
+  table->fallbacks.count = 0;
+  table->fallbacks.hits = 0;
+  table->fallbacks.misses = 0;
+
+  leaveCriticalSection(&fallbacksLock);
+
+  logTextTableFallbacks("reset", hits, misses, count);
+}
+
+static unsigned char
+translateCharacterToDots (TextTable *table, wchar_t character) {
   switch (character & ~UNICODE_CELL_MASK) {
     case UNICODE_BRAILLE_ROW:
       return character & UNICODE_CELL_MASK;
@@ -178,14 +370,21 @@ convertCharacterToDots (TextTable *table, wchar_t character) {
       }
 
       if (table->options.tryBaseCharacter) {
-        SetBrailleRepresentationData sbr = {
-          .table = table,
-          .dots = 0
-        };
-
-        if (handleBestCharacter(character, setBrailleRepresentation, &sbr)) {
-          return sbr.dots;
+        TextTableFallbackEntry fallback;
+
+        if (!getTextTableFallback(table, character, &fallback)) {
+          SetBrailleRepresentationData sbr = {
+            .table = table,
+            .dots = 0
+          };
+
+          fallback.character = character;
+          fallback.resolved = handleBestCharacter(character, setBrailleRepresentation, &sbr);
+          fallback.dots = sbr.dots;
+          addTextTableFallback(table, &fallback);
         }
+
+        if (fallback.resolved) return fallback.dots;
       }
 
       break;
@@ -202,6 +401,51 @@ convertCharacterToDots (TextTable *table, wchar_t character) {
   return BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_3 | BRL_DOT_4 | BRL_DOT_5 | BRL_DOT_6 | BRL_DOT_7 | BRL_DOT_8;
 }
 
+static inline int
+isCacheableCharacter (wchar_t character) {
+  if (character & ~TEXT_TABLE_CACHE_MASK) return 0;
+
+  /* this row depends on the current character set */
+  if ((character & ~UNICODE_CELL_MASK) == 0XF000) return 0;
+
+  return 1;
+}
+
+static inline unsigned char
+getCachedDots (TextTable *table, unsigned short *cells, wchar_t character) {
+  unsigned short *cell = &cells[character];
+
+  if (!*cell) *cell = translateCharacterToDots(table, character) | TEXT_TABLE_CACHE_DEFINED;
+  return *cell & ~TEXT_TABLE_CACHE_DEFINED;
+}
+
+unsigned char
+convertCharacterToDots (TextTable *table, wchar_t character) {
+  if (isCacheableCharacter(character)) {
+    unsigned short *cells = getTextTableCache(table);
+    if (cells) return getCachedDots(table, cells, character);
+  }
+
+  return translateCharacterToDots(table, character);
+}
+
+void
+convertCharactersToDots (
+  TextTable *table, const wchar_t *characters,
+  unsigned char *cells, size_t count
+) {
+  const wchar_t *end = characters + count;
+  unsigned short *cache = getTextTableCache(table);
+
+  while (characters < end) {
+    wchar_t character = *characters++;
+
+    *cells++ = (cache && isCacheableCharacter(character))?
+               getCachedDots(table, cache, character):
+               translateCharacterToDots(table, character);
+  }
+}
+
 wchar_t
 convertDotsToCharacter (TextTable *table, unsigned char dots) {
   const TextTableHeader *header = table->header.fields;
@@ -233,6 +477,7 @@ replaceTextTable (const char *directory, const char *name) {
     TextTable *oldTable = textTable;
 
     textTable = newTable;
+    resetTextTableFallbacks(oldTable);
     destroyTextTable(oldTable);
     return 1;
   }
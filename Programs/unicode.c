@@ -21,6 +21,7 @@
 #include "log.h"
 #include "unicode.h"
 #include "ascii.h"
+#include "thread.h"
 
 #ifdef HAVE_ICU
 #include <unicode/uchar.h>
@@ -139,12 +140,9 @@ getBaseCharacter (wchar_t character) {
     UErrorCode error = U_ZERO_ERROR;
 
 #ifdef HAVE_UNICODE_UNORM2_H
-    static const UNormalizer2 *normalizer = NULL;
-
-    if (!normalizer) {
-      normalizer = unorm2_getNFDInstance(&error);
-      if (!U_SUCCESS(error)) return 0;
-    }
+    /* ICU keeps the instance so it needn't be saved (which wouldn't be thread-safe) */
+    const UNormalizer2 *normalizer = unorm2_getNFDInstance(&error);
+    if (!U_SUCCESS(error)) return 0;
 
     unorm2_normalize(normalizer,
                      source, ARRAY_COUNT(source),
@@ -166,8 +164,14 @@ getBaseCharacter (wchar_t character) {
 
 wchar_t
 getTransliteratedCharacter (wchar_t character) {
+  wchar_t result = 0;
+
 #ifdef HAVE_ICONV_H
+  /* the conversion descriptor can only be used by one thread at a time */
+  static CriticalSectionLock handleLock = CRITICAL_SECTION_LOCK_INITIALIZER;
   static iconv_t handle = NULL;
+
+  enterCriticalSection(&handleLock);
   if (!handle) handle = iconv_open("ASCII//TRANSLIT", "WCHAR_T");
 
   if (handle != (iconv_t)-1) {
@@ -179,13 +183,15 @@ getTransliteratedCharacter (wchar_t character) {
 
     if (iconv(handle, &inputAddress, &inputSize, &outputAddress, &outputSize) != (size_t)-1) {
       if ((outputAddress - outputBuffer) == 1) {
-        return outputBuffer[0] & 0XFF;
+        result = outputBuffer[0] & 0XFF;
       }
     }
   }
+
+  leaveCriticalSection(&handleLock);
 #endif /* HAVE_ICONV_H */
 
-  return 0;
+  return result;
 }
 
 int
@@ -27,6 +27,7 @@
 #include "report.h"
 #include "strfmt.h"
 #include "update.h"
+#include "autospeak.h"
 #include "async_alarm.h"
 #include "timing.h"
 #include "unicode.h"
@@ -159,7 +160,7 @@ getScreenCursorPosition (int x, int y) {
   return position;
 }
 
-static void
+static int
 overlayAttributesUnderline (unsigned char *cell, unsigned char attributes) {
   unsigned char dots;
 
@@ -168,7 +169,7 @@ overlayAttributesUnderline (unsigned char *cell, unsigned char attributes) {
     case SCR_COLOUR_FG_LIGHT_GREY | SCR_COLOUR_BG_BLACK:
     case SCR_COLOUR_FG_LIGHT_GREY | SCR_COLOUR_BG_BLUE:
     case SCR_COLOUR_FG_BLACK | SCR_COLOUR_BG_CYAN:
-      return;
+      return 0;
 
     case SCR_COLOUR_FG_BLACK | SCR_COLOUR_BG_LIGHT_GREY:
       dots = BRL_DOT_7 | BRL_DOT_8;
@@ -186,6 +187,8 @@ overlayAttributesUnderline (unsigned char *cell, unsigned char attributes) {
     requireBlinkDescriptor(blink);
     if (isBlinkVisible(blink)) *cell |= dots;
   }
+
+  return 1;
 }
 
 static int
@@ -330,8 +333,8 @@ saveScreenCharacters (
   return 1;
 }
 
-static void
-checkScreenScroll (int track) {
+static int
+checkScreenScroll (int track, ScreenCharacter *row) {
   const int rowCount = 3;
 
   static int oldScreen = -1;
@@ -379,13 +382,19 @@ checkScreenScroll (int track) {
     oldRow = ses->winy;
     oldWidth = newWidth;
   }
+
+  /* the last row which was read is the current one unless the search for a
+   * scrolled row gave up without finding it */
+  if (!row || !newCount || (newRow != ses->winy)) return 0;
+  memcpy(row, &newCharacters[newCount-newWidth], ARRAY_SIZE(row, newWidth));
+  return 1;
 }
 
 #ifdef ENABLE_SPEECH_SUPPORT
 static int wasAutospeaking;
 
-void
-autospeak (AutospeakMode mode) {
+static void
+autospeakRow (AutospeakMode mode, const ScreenCharacter *newCharacters) {
   static int oldScreen = -1;
   static int oldX = -1;
   static int oldY = -1;
@@ -398,9 +407,6 @@ autospeak (AutospeakMode mode) {
   int newX = scr.posx;
   int newY = scr.posy;
   int newWidth = scr.cols;
-  ScreenCharacter newCharacters[newWidth];
-
-  readScreenRow(ses->winy, newWidth, newCharacters);
 
   if (!spk.track.isActive) {
     const ScreenCharacter *characters = newCharacters;
@@ -420,7 +426,10 @@ autospeak (AutospeakMode mode) {
       int onScreen = (newX >= 0) && (newX < newWidth);
 
       if (!isSameRow(newCharacters, oldCharacters, newWidth, isSameText)) {
-        if ((newY == ses->winy) && (newY == oldY) && onScreen) {
+        int cursorTracked = (newY == ses->winy) && (newY == oldY) && onScreen;
+        AutospeakChange change;
+
+        if (cursorTracked) {
           /* Sometimes the cursor moves after the screen content has been
            * updated. Make sure we don't race ahead of such a cursor move
            * before assuming that it is actually stable.
@@ -430,114 +439,16 @@ autospeak (AutospeakMode mode) {
 	    cursorAssumedStable = 1;
 	    return;
 	  }
-
-          if ((newX == oldX) &&
-              isSameRow(newCharacters, oldCharacters, newX, isSameText)) {
-            int oldLength = oldWidth;
-            int newLength = newWidth;
-            int x = newX;
-
-            while (oldLength > oldX) {
-              if (!iswspace(oldCharacters[oldLength-1].text)) break;
-              oldLength -= 1;
-            }
-            if (oldLength < oldWidth) oldLength += 1;
-
-            while (newLength > newX) {
-              if (!iswspace(newCharacters[newLength-1].text)) break;
-              newLength -= 1;
-            }
-            if (newLength < newWidth) newLength += 1;
-
-            while (1) {
-              int done = 1;
-
-              if (x < newLength) {
-                if (isSameRow(newCharacters+x, oldCharacters+oldX, newWidth-x, isSameText)) {
-                  column = newX;
-                  count = prefs.autospeakInsertedCharacters? (x - newX): 0;
-                  reason = "characters inserted after cursor";
-                  goto autospeak;
-                }
-
-                done = 0;
-              }
-
-              if (x < oldLength) {
-                if (isSameRow(newCharacters+newX, oldCharacters+x, oldWidth-x, isSameText)) {
-                  characters = oldCharacters;
-                  column = oldX;
-                  count = prefs.autospeakDeletedCharacters? (x - oldX): 0;
-                  reason = "characters deleted after cursor";
-                  goto autospeak;
-                }
-
-                done = 0;
-              }
-
-              if (done) break;
-              x += 1;
-            }
-          }
-
-          if (oldX < 0) oldX = 0;
-          if ((newX > oldX) &&
-              isSameRow(newCharacters, oldCharacters, oldX, isSameText) &&
-              isSameRow(newCharacters+newX, oldCharacters+oldX, newWidth-newX, isSameText)) {
-            column = oldX;
-            count = newX - oldX;
-
-            if (prefs.autospeakCompletedWords) {
-              int last = column + count - 1;
-
-              if (iswspace(characters[last].text)) {
-                int first = column;
-
-                while (first > 0) {
-                  if (iswspace(characters[--first].text)) {
-                    first += 1;
-                    break;
-                  }
-                }
-
-                if (first < column) {
-                  while (last >= first) {
-                    if (!iswspace(characters[last].text)) break;
-                    last -= 1;
-                  }
-
-                  if (last > first) {
-                    column = first;
-                    count = last - first + 1;
-                    reason = "word inserted";
-                    goto autospeak;
-                  }
-                }
-              }
-            }
-
-            if (!prefs.autospeakInsertedCharacters) count = 0;
-            reason = "characters inserted before cursor";
-            goto autospeak;
-          }
-
-          if (oldX >= oldWidth) oldX = oldWidth - 1;
-          if ((newX < oldX) &&
-              isSameRow(newCharacters, oldCharacters, newX, isSameText) &&
-              isSameRow(newCharacters+newX, oldCharacters+oldX, oldWidth-oldX, isSameText)) {
-            characters = oldCharacters;
-            column = newX;
-            count = prefs.autospeakDeletedCharacters? (oldX - newX): 0;
-            reason = "characters deleted before cursor";
-            goto autospeak;
-          }
         }
 
-        while (newCharacters[column].text == oldCharacters[column].text) ++column;
-        while (newCharacters[count-1].text == oldCharacters[count-1].text) --count;
-        count -= column;
-        if (!prefs.autospeakReplacedCharacters) count = 0;
-        reason = "characters replaced";
+        findAutospeakChange(&change, &prefs,
+                            oldCharacters, oldX, newCharacters, newX,
+                            newWidth, cursorTracked);
+
+        characters = change.characters;
+        column = change.column;
+        count = change.count;
+        reason = change.reason;
       } else if ((newY == ses->winy) && ((newX != oldX) || (newY != oldY)) && onScreen) {
         column = newX;
         count = prefs.autospeakSelectedCharacter? 1: 0;
@@ -602,6 +513,14 @@ autospeak (AutospeakMode mode) {
   }
 }
 
+void
+autospeak (AutospeakMode mode) {
+  ScreenCharacter characters[scr.cols];
+
+  readScreenRow(ses->winy, scr.cols, characters);
+  autospeakRow(mode, characters);
+}
+
 void
 suppressAutospeak (void) {
   if (isAutospeakActive()) {
@@ -639,6 +558,236 @@ writeBrailleWindow (BrailleDisplay *brl, const wchar_t *text) {
   return braille->writeWindow(brl, text);
 }
 
+typedef enum {
+  WINDOW_BLINK_UPPERCASE = 0X01,
+  WINDOW_BLINK_UNDERLINE = 0X02
+} WindowBlinkFlag;
+
+typedef struct {
+  int screenNumber;
+  short screenColumns;
+  short screenRows;
+
+  unsigned int textCount;
+  unsigned int textRows;
+
+  int windowLeft;
+  int windowTop;
+  int visibleColumns;
+
+  const TextTable *textTable;
+  const AttributesTable *attributesTable;
+
+  unsigned char displayMode;
+  unsigned char textStyle;
+  unsigned char showAttributes;
+  unsigned char uppercaseVisible;
+  unsigned char underlineVisible;
+} WindowRenderingState;
+
+static struct {
+  WindowRenderingState state;
+  unsigned isValid:1;
+
+  unsigned int size;
+  unsigned char *dots;
+  wchar_t *text;
+  unsigned char *blinks;
+} renderedWindow = {
+  .isValid = 0
+};
+
+static int
+prepareRenderedWindow (unsigned int count) {
+  if (count > renderedWindow.size) {
+    if (renderedWindow.dots) free(renderedWindow.dots);
+    if (renderedWindow.text) free(renderedWindow.text);
+    if (renderedWindow.blinks) free(renderedWindow.blinks);
+
+    renderedWindow.isValid = 0;
+    renderedWindow.size = 0;
+
+    renderedWindow.dots = malloc(ARRAY_SIZE(renderedWindow.dots, count));
+    renderedWindow.text = malloc(ARRAY_SIZE(renderedWindow.text, count));
+    renderedWindow.blinks = malloc(ARRAY_SIZE(renderedWindow.blinks, count));
+
+    if (!(renderedWindow.dots && renderedWindow.text && renderedWindow.blinks)) {
+      logMallocError();
+      return 0;
+    }
+
+    renderedWindow.size = count;
+  }
+
+  return 1;
+}
+
+static void
+translateWindowCharacter (
+  const ScreenCharacter *character,
+  unsigned char *dots, wchar_t *text, unsigned char *blinks
+) {
+  *blinks = 0;
+
+  if (ses->displayMode) {
+    *dots = convertAttributesToDots(attributesTable, character->attributes);
+    *text = UNICODE_BRAILLE_ROW | *dots;
+  } else {
+    /* the dots have already been converted by renderWindowRegion() */
+    if (iswupper(character->text)) {
+      *blinks |= WINDOW_BLINK_UPPERCASE;
+      if (!isBlinkVisible(&uppercaseLettersBlinkDescriptor)) *dots = 0;
+    }
+
+    if (prefs.textStyle) *dots &= ~(BRL_DOT_7 | BRL_DOT_8);
+
+    if (prefs.showAttributes) {
+      if (overlayAttributesUnderline(dots, character->attributes)) {
+        *blinks |= WINDOW_BLINK_UNDERLINE;
+      }
+    }
+
+    *text = character->text;
+  }
+}
+
+static void
+renderWindowRegion (
+  unsigned char *dots, wchar_t *text, unsigned char *blinks,
+  int visibleColumns, int top, int bottom, int left, int right
+) {
+  const int height = bottom - top + 1;
+  const int readWidth = MAX(MIN(right+1, visibleColumns) - left, 0);
+  ScreenCharacter characters[MAX(readWidth, 1) * height];
+
+  if (readWidth > 0) {
+    readScreen(ses->winx+left, ses->winy+top, readWidth, height, characters);
+  }
+
+  {
+    ScreenCharacter blank;
+    clearScreenCharacters(&blank, 1);
+
+    for (int row=0; row<height; row+=1) {
+      const ScreenCharacter *source = &characters[row * readWidth];
+      unsigned int offset = ((top + row) * textCount) + left;
+
+      if (!ses->displayMode && (right >= left)) {
+        unsigned int count = right - left + 1;
+
+        for (int column=left; column<=right; column+=1) {
+          text[offset + column - left] = (column < visibleColumns)? source[column - left].text: blank.text;
+        }
+
+        convertCharactersToDots(textTable, &text[offset], &dots[offset], count);
+      }
+
+      for (int column=left; column<=right; column+=1) {
+        const ScreenCharacter *character = (column < visibleColumns)? source++: &blank;
+
+        translateWindowCharacter(character, &dots[offset], &text[offset], &blinks[offset]);
+        offset += 1;
+      }
+    }
+  }
+}
+
+static void
+renderTextWindow (wchar_t *textBuffer) {
+  const unsigned int count = textCount * brl.textRows;
+  WindowRenderingState state;
+
+  ScreenDamage damage;
+  int isIncremental = getScreenDamage(&damage);
+
+  memset(&state, 0, sizeof(state));
+  state.screenNumber = scr.number;
+  state.screenColumns = scr.cols;
+  state.screenRows = scr.rows;
+  state.textCount = textCount;
+  state.textRows = brl.textRows;
+  state.windowLeft = ses->winx;
+  state.windowTop = ses->winy;
+  state.visibleColumns = MIN(textCount, scr.cols-ses->winx);
+  state.textTable = textTable;
+  state.attributesTable = attributesTable;
+  state.displayMode = ses->displayMode;
+  state.textStyle = prefs.textStyle;
+  state.showAttributes = prefs.showAttributes;
+  state.uppercaseVisible = isBlinkVisible(&uppercaseLettersBlinkDescriptor);
+  state.underlineVisible = isBlinkVisible(&attributesUnderlineBlinkDescriptor);
+
+  if (prefs.wordWrap) {
+    int columns = getWordWrapLength(ses->winy, ses->winx, state.visibleColumns);
+    if (columns < state.visibleColumns) state.visibleColumns = columns;
+  }
+
+  unsigned char dotsBuffer[count];
+  wchar_t textCells[count];
+  unsigned char blinksBuffer[count];
+
+  unsigned char *dots;
+  wchar_t *text;
+  unsigned char *blinks;
+
+  if (prepareRenderedWindow(count)) {
+    dots = renderedWindow.dots;
+    text = renderedWindow.text;
+    blinks = renderedWindow.blinks;
+
+    if (!renderedWindow.isValid) {
+      isIncremental = 0;
+    } else if (memcmp(&state, &renderedWindow.state, sizeof(state)) != 0) {
+      isIncremental = 0;
+    }
+
+    renderedWindow.state = state;
+    renderedWindow.isValid = 1;
+  } else {
+    dots = dotsBuffer;
+    text = textCells;
+    blinks = blinksBuffer;
+    isIncremental = 0;
+  }
+
+  if (!isIncremental) {
+    logMessage(LOG_CATEGORY(UPDATE_EVENTS), "window rendered: all");
+
+    renderWindowRegion(dots, text, blinks, state.visibleColumns,
+                       0, brl.textRows-1, 0, textCount-1);
+  } else if (damage.top <= damage.bottom) {
+    int top = MAX(damage.top-ses->winy, 0);
+    int bottom = MIN(damage.bottom-ses->winy, (int)brl.textRows-1);
+    int left = MAX(damage.left-ses->winx, 0);
+    int right = MIN(damage.right-ses->winx, (int)textCount-1);
+
+    if ((top <= bottom) && (left <= right)) {
+      logMessage(LOG_CATEGORY(UPDATE_EVENTS),
+                 "window rendered: rows %d-%d columns %d-%d",
+                 top, bottom, left, right);
+
+      renderWindowRegion(dots, text, blinks, state.visibleColumns,
+                         top, bottom, left, right);
+    }
+  }
+
+  {
+    unsigned char flags = 0;
+
+    for (unsigned int row=0; row<brl.textRows; row+=1) {
+      unsigned int from = row * textCount;
+      unsigned int to = (row * brl.textColumns) + textStart;
+
+      memcpy(&brl.buffer[to], &dots[from], textCount);
+      wmemcpy(&textBuffer[to], &text[from], textCount);
+    }
+
+    for (unsigned int index=0; index<count; index+=1) flags |= blinks[index];
+    if (flags & WINDOW_BLINK_UPPERCASE) requireBlinkDescriptor(&uppercaseLettersBlinkDescriptor);
+    if (flags & WINDOW_BLINK_UNDERLINE) requireBlinkDescriptor(&attributesUnderlineBlinkDescriptor);
+  }
+}
+
 static void
 doUpdate (void) {
   logMessage(LOG_CATEGORY(UPDATE_EVENTS), "starting");
@@ -724,20 +873,29 @@ doUpdate (void) {
     trackScreenScroll = 1;
   }
 
-  checkScreenScroll(trackScreenScroll);
-
 #ifdef ENABLE_SPEECH_SUPPORT
+  ScreenCharacter currentRow[scr.cols];
+  int haveCurrentRow = checkScreenScroll(trackScreenScroll, currentRow);
+
   if (spk.canAutospeak) {
     int isAutospeaking = isAutospeakActive();
 
     if (isAutospeaking) {
-      autospeak(wasAutospeaking? AUTOSPEAK_CHANGES: AUTOSPEAK_FORCE);
+      AutospeakMode mode = wasAutospeaking? AUTOSPEAK_CHANGES: AUTOSPEAK_FORCE;
+
+      if (haveCurrentRow) {
+        autospeakRow(mode, currentRow);
+      } else {
+        autospeak(mode);
+      }
     } else if (wasAutospeaking) {
       muteSpeech(&spk, "autospeak disabled");
     }
 
     wasAutospeaking = isAutospeaking;
   }
+#else /* ENABLE_SPEECH_SUPPORT */
+  checkScreenScroll(trackScreenScroll, NULL);
 #endif /* ENABLE_SPEECH_SUPPORT */
 
   /* There are a few things to take care of if the display has moved. */
@@ -882,78 +1040,15 @@ doUpdate (void) {
                          outputBuffer, outputLength);
           break;
         }
+
+        /* the next line is the one most likely to be asked for */
+        prefetchContractedRow(ses->winy+1, textLength);
       }
 
       if (!isContracted)
 #endif /* ENABLE_CONTRACTED_BRAILLE */
       {
-        int windowColumns = MIN(textCount, scr.cols-ses->winx);
-
-        ScreenCharacter characters[textLength];
-        readScreen(ses->winx, ses->winy, windowColumns, brl.textRows, characters);
-
-        if (prefs.wordWrap) {
-          int columns = getWordWrapLength(ses->winy, ses->winx, windowColumns);
-          if (columns < windowColumns) windowColumns = columns;
-        }
-
-        if (windowColumns < textCount) {
-          /* We got a rectangular piece of text with readScreen but the display
-           * is in an off-right position with some cells at the end blank
-           * so we'll insert these cells and blank them.
-           */
-
-          for (int row=brl.textRows-1; row>0; row-=1) {
-            memmove(characters + (row * textCount),
-                    characters + (row * windowColumns),
-                    windowColumns * sizeof(*characters));
-          }
-
-          for (int row=0; row<brl.textRows; row+=1) {
-            clearScreenCharacters(characters + (row * textCount) + windowColumns,
-                                  textCount-windowColumns);
-          }
-        }
-
-        /* convert to dots using the current translation table */
-        if (ses->displayMode) {
-          for (int row=0; row<brl.textRows; row+=1) {
-            const ScreenCharacter *source = &characters[row * textCount];
-            unsigned int start = (row * brl.textColumns) + textStart;
-            unsigned char *target = &brl.buffer[start];
-            wchar_t *text = &textBuffer[start];
-
-            for (int column=0; column<textCount; column+=1) {
-              text[column] = UNICODE_BRAILLE_ROW | (target[column] = convertAttributesToDots(attributesTable, source[column].attributes));
-            }
-          }
-        } else {
-          for (unsigned int row=0; row<brl.textRows; row+=1) {
-            const ScreenCharacter *source = &characters[row * textCount];
-            unsigned int start = (row * brl.textColumns) + textStart;
-            unsigned char *target = &brl.buffer[start];
-            wchar_t *text = &textBuffer[start];
-
-            for (unsigned int column=0; column<textCount; column+=1) {
-              const ScreenCharacter *character = &source[column];
-
-              unsigned char *dots = &target[column];
-              *dots = convertCharacterToDots(textTable, character->text);
-
-              if (iswupper(character->text)) {
-                BlinkDescriptor *blink = &uppercaseLettersBlinkDescriptor;
-
-                requireBlinkDescriptor(blink);
-                if (!isBlinkVisible(blink)) *dots = 0;
-              }
-
-              if (prefs.textStyle) *dots &= ~(BRL_DOT_7 | BRL_DOT_8);
-              if (prefs.showAttributes) overlayAttributesUnderline(dots, character->attributes);
-
-              text[column] = character->text;
-            }
-          }
-        }
+        renderTextWindow(textBuffer);
       }
 
       if ((brl.cursor = getScreenCursorPosition(scr.posx, scr.posy)) != BRL_NO_CURSOR) {
@@ -614,6 +614,11 @@ usbHaveInputError (UsbEndpoint *endpoint) {
   return endpoint->direction.input.pipe.input == INVALID_FILE_DESCRIPTOR;
 }
 
+static inline int
+usbHaveInputRing (UsbEndpoint *endpoint) {
+  return endpoint->direction.input.ring.active;
+}
+
 void
 usbSetEndpointInputError (UsbEndpoint *endpoint, int error) {
   if (!usbHaveInputError(endpoint)) {
@@ -710,7 +715,14 @@ usbDeallocateEndpoint (void *item, void *data) {
         endpoint->direction.input.pending.requests = NULL;
       }
 
-      if (endpoint->direction.input.completed.request) {
+      if (usbHaveInputRing(endpoint)) {
+        /* the held responses belong to the ring's requests */
+        endpoint->direction.input.completed.request = NULL;
+        endpoint->direction.input.ring.count = 0;
+
+        endpoint->direction.input.ring.stop(endpoint);
+        endpoint->direction.input.ring.active = 0;
+      } else if (endpoint->direction.input.completed.request) {
         free(endpoint->direction.input.completed.request);
         endpoint->direction.input.completed.request = NULL;
       }
@@ -794,6 +806,13 @@ usbGetEndpoint (UsbDevice *device, unsigned char endpointAddress) {
           endpoint->direction.input.completed.buffer = NULL;
           endpoint->direction.input.completed.length = 0;
 
+          endpoint->direction.input.ring.start = NULL;
+          endpoint->direction.input.ring.release = NULL;
+          endpoint->direction.input.ring.stop = NULL;
+          endpoint->direction.input.ring.first = 0;
+          endpoint->direction.input.ring.count = 0;
+          endpoint->direction.input.ring.active = 0;
+
           endpoint->direction.input.pipe.input = INVALID_FILE_DESCRIPTOR;
           endpoint->direction.input.pipe.output = INVALID_FILE_DESCRIPTOR;
           endpoint->direction.input.pipe.monitor = NULL;
@@ -1151,6 +1170,120 @@ usbHandleInputResponse (UsbEndpoint *endpoint, const void *buffer, size_t length
   return 1;
 }
 
+int
+usbHoldInputResponse (UsbEndpoint *endpoint, void *request, unsigned char *buffer, size_t length) {
+  UsbInputRing *ring = &endpoint->direction.input.ring;
+
+  if (usbHaveInputError(endpoint)) {
+    errno = EIO;
+    return 0;
+  }
+
+  if (ring->count == ARRAY_COUNT(ring->responses)) {
+    usbLogInputProblem(endpoint, "too many held responses");
+    errno = ENOBUFS;
+    return 0;
+  }
+
+  /* The pipe holds one byte while there's unread ring input. */
+  if (!ring->count && !endpoint->direction.input.completed.request) {
+    static const unsigned char signal = 0;
+
+    if (writeFile(endpoint->direction.input.pipe.input, &signal, 1) == -1) {
+      usbLogInputProblem(endpoint, "input not signalled");
+      return 0;
+    }
+  }
+
+  {
+    UsbInputResponse *response = &ring->responses[(ring->first + ring->count++) % ARRAY_COUNT(ring->responses)];
+
+    response->request = request;
+    response->buffer = buffer;
+    response->length = length;
+  }
+
+  return 1;
+}
+
+static int
+usbLoadCompletedInput (UsbEndpoint *endpoint) {
+  UsbInputResponse *completed = &endpoint->direction.input.completed;
+
+  if (completed->request) return 1;
+
+  if (usbHaveInputRing(endpoint)) {
+    UsbInputRing *ring = &endpoint->direction.input.ring;
+
+    if (ring->count) {
+      *completed = ring->responses[ring->first];
+      ring->first = (ring->first + 1) % ARRAY_COUNT(ring->responses);
+      ring->count -= 1;
+      return 1;
+    }
+  } else if (usbHaveInputPipe(endpoint)) {
+    size_t size = getLittleEndian16(endpoint->descriptor->wMaxPacketSize);
+    unsigned char *buffer = malloc(size);
+
+    if (!buffer) {
+      logMallocError();
+      return 0;
+    }
+
+    {
+      ssize_t count = readFile(endpoint->direction.input.pipe.output, buffer, size, 0, 0);
+
+      if (count > 0) {
+        completed->request = buffer;
+        completed->buffer = buffer;
+        completed->length = count;
+        return 1;
+      }
+    }
+
+    free(buffer);
+  }
+
+  errno = EAGAIN;
+  return 0;
+}
+
+static void
+usbConsumeCompletedInput (UsbEndpoint *endpoint, size_t count) {
+  UsbInputResponse *completed = &endpoint->direction.input.completed;
+
+  if ((completed->length -= count)) {
+    completed->buffer += count;
+  } else {
+    void *request = completed->request;
+
+    completed->request = NULL;
+    completed->buffer = NULL;
+
+    if (usbHaveInputRing(endpoint)) {
+      if (!endpoint->direction.input.ring.count) {
+        unsigned char signal;
+        readFile(endpoint->direction.input.pipe.output, &signal, 1, 0, 0);
+      }
+
+      if (!endpoint->direction.input.ring.release(endpoint, request)) {
+        usbSetEndpointInputError(endpoint, errno);
+      }
+    } else {
+      free(request);
+    }
+  }
+}
+
+static size_t
+usbTakeCompletedInput (UsbEndpoint *endpoint, unsigned char *target, size_t length) {
+  size_t count = MIN(length, endpoint->direction.input.completed.length);
+
+  memcpy(target, endpoint->direction.input.completed.buffer, count);
+  usbConsumeCompletedInput(endpoint, count);
+  return count;
+}
+
 void
 usbBeginInput (
   UsbDevice *device,
@@ -1159,6 +1292,17 @@ usbBeginInput (
   UsbEndpoint *endpoint = usbGetInputEndpoint(device, endpointNumber);
 
   if (endpoint) {
+    if (endpoint->direction.input.ring.start) {
+      if (usbHaveInputRing(endpoint)) return;
+
+      if (endpoint->direction.input.ring.start(endpoint)) {
+        endpoint->direction.input.ring.active = 1;
+        return;
+      }
+
+      usbLogInputProblem(endpoint, "ring not started");
+    }
+
     if (!endpoint->direction.input.pending.requests) {
       if ((endpoint->direction.input.pending.requests = newQueue(usbDeallocatePendingInputRequest, NULL))) {
         setQueueData(endpoint->direction.input.pending.requests, endpoint);
@@ -1203,6 +1347,7 @@ usbAwaitInput (
       return 0;
     }
 
+    if (endpoint->direction.input.completed.request) return 1;
     return awaitFileInput(endpoint->direction.input.pipe.output, timeout);
   }
 
@@ -1310,7 +1455,27 @@ usbReadData (
         return -1;
       }
 
-      return readFile(endpoint->direction.input.pipe.output, buffer, length, initialTimeout, subsequentTimeout);
+      if (!(usbHaveInputRing(endpoint) || endpoint->direction.input.completed.request)) {
+        return readFile(endpoint->direction.input.pipe.output, buffer, length, initialTimeout, subsequentTimeout);
+      }
+
+      while (length > 0) {
+        if (usbLoadCompletedInput(endpoint)) {
+          size_t count = usbTakeCompletedInput(endpoint, target, length);
+
+          target += count;
+          length -= count;
+        } else {
+          int timeout = (target != bytes)? subsequentTimeout: initialTimeout;
+
+          if (!timeout) break;
+          if (!awaitFileInput(endpoint->direction.input.pipe.output, timeout)) break;
+          if (usbHaveInputError(endpoint)) break;
+        }
+      }
+
+      if (target == bytes) errno = EAGAIN;
+      return target - bytes;
     }
 
     while (length > 0) {
@@ -1324,18 +1489,7 @@ usbReadData (
       }
 
       {
-        size_t count = endpoint->direction.input.completed.length;
-
-        if (length < count) count = length;
-        memcpy(target, endpoint->direction.input.completed.buffer, count);
-
-        if ((endpoint->direction.input.completed.length -= count)) {
-          endpoint->direction.input.completed.buffer += count;
-        } else {
-          endpoint->direction.input.completed.buffer = NULL;
-          free(endpoint->direction.input.completed.request);
-          endpoint->direction.input.completed.request = NULL;
-        }
+        size_t count = usbTakeCompletedInput(endpoint, target, length);
 
         target += count;
         length -= count;
@@ -19,6 +19,7 @@
 #ifndef BRLTTY_INCLUDED_USB_INTERNAL
 #define BRLTTY_INCLUDED_USB_INTERNAL
 
+#include "parameters.h"
 #include "bitfield.h"
 #include "queue.h"
 
@@ -34,6 +35,23 @@ typedef struct UsbDeviceExtensionStruct UsbDeviceExtension;
 typedef struct UsbEndpointStruct UsbEndpoint;
 typedef struct UsbEndpointExtensionStruct UsbEndpointExtension;
 
+typedef struct {
+  void *request;
+  unsigned char *buffer;
+  size_t length;
+} UsbInputResponse;
+
+typedef struct {
+  int (*start) (UsbEndpoint *endpoint);
+  int (*release) (UsbEndpoint *endpoint, void *request);
+  void (*stop) (UsbEndpoint *endpoint);
+
+  UsbInputResponse responses[USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM];
+  unsigned int first;
+  unsigned int count;
+  unsigned active:1;
+} UsbInputRing;
+
 struct UsbEndpointStruct {
   UsbDevice *device;
   const UsbEndpointDescriptor *descriptor;
@@ -48,11 +66,9 @@ struct UsbEndpointStruct {
         int delay;
       } pending;
 
-      struct {
-        void *request;
-        unsigned char *buffer;
-        size_t length;
-      } completed;
+      UsbInputResponse completed;
+
+      UsbInputRing ring;
 
       struct {
         FileDescriptor input;
@@ -98,6 +114,7 @@ extern int usbApplyInputFilters (UsbEndpoint *endpoint, void *buffer, size_t siz
 
 extern void usbLogInputProblem (UsbEndpoint *endpoint, const char *problem);
 extern int usbHandleInputResponse (UsbEndpoint *endpoint, const void *buffer, size_t length);
+extern int usbHoldInputResponse (UsbEndpoint *endpoint, void *request, unsigned char *buffer, size_t length);
 
 extern int usbSetSerialOperations (UsbDevice *device);
 
@@ -68,6 +68,17 @@ struct UsbDeviceExtensionStruct {
 struct UsbEndpointExtensionStruct {
   Queue *completedRequests;
 
+  struct {
+    struct usbdevfs_urb *array[USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM];
+    unsigned int count;
+  } spareRequests;
+
+  struct {
+    struct usbdevfs_urb *array[USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM];
+    unsigned char submitted[USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM];
+    unsigned int count;
+  } inputRing;
+
   struct {
     struct {
       AsyncHandle handle;
@@ -631,6 +642,42 @@ usbSubmitURB (struct usbdevfs_urb *urb, UsbEndpoint *endpoint) {
   }
 }
 
+static void
+usbRecycleURB (UsbEndpoint *endpoint, struct usbdevfs_urb *urb) {
+  UsbEndpointExtension *eptx = endpoint->extension;
+
+  if (USB_ENDPOINT_DIRECTION(endpoint->descriptor) == UsbEndpointDirection_Input) {
+    if (urb->buffer_length == getLittleEndian16(endpoint->descriptor->wMaxPacketSize)) {
+      if (eptx->spareRequests.count < ARRAY_COUNT(eptx->spareRequests.array)) {
+        eptx->spareRequests.array[eptx->spareRequests.count++] = urb;
+        return;
+      }
+    }
+  }
+
+  free(urb);
+}
+
+static struct usbdevfs_urb *
+usbGetSpareURB (UsbEndpoint *endpoint, void *buffer, size_t length, void *context) {
+  UsbEndpointExtension *eptx = endpoint->extension;
+
+  if (!buffer && eptx->spareRequests.count) {
+    struct usbdevfs_urb *urb = eptx->spareRequests.array[eptx->spareRequests.count - 1];
+
+    if (urb->buffer_length == length) {
+      eptx->spareRequests.count -= 1;
+
+      urb->status = 0;
+      urb->flags = 0;
+      urb->usercontext = context;
+      return urb;
+    }
+  }
+
+  return usbMakeURB(endpoint->descriptor, buffer, length, context);
+}
+
 void *
 usbSubmitRequest (
   UsbDevice *device,
@@ -648,7 +695,7 @@ usbSubmitRequest (
       UsbEndpointExtension *eptx = endpoint->extension;
       struct usbdevfs_urb *urb;
 
-      if ((urb = usbMakeURB(endpoint->descriptor, buffer, length, context))) {
+      if ((urb = usbGetSpareURB(endpoint, buffer, length, context))) {
         urb->actual_length = 0;
         urb->signr = eptx->monitor.signal.number;
 
@@ -656,7 +703,7 @@ usbSubmitRequest (
           return urb;
         }
 
-        free(urb);
+        usbRecycleURB(endpoint, urb);
       } else {
         logSystemError("USB URB allocate");
       }
@@ -995,7 +1042,7 @@ ASYNC_SIGNAL_CALLBACK(usbHandleInputSignal) {
         usbStopSignalMonitor(eptx);
       }
 
-      free(urb);
+      usbRecycleURB(endpoint, urb);
       if (!handled) return 0;
     }
   }
@@ -1061,6 +1108,131 @@ usbHandleCompletedInputRequest (UsbEndpoint *endpoint, struct usbdevfs_urb *urb)
   return 0;
 }
 
+static int
+usbGetRingURB (UsbEndpointExtension *eptx, const struct usbdevfs_urb *urb) {
+  for (unsigned int index=0; index<eptx->inputRing.count; index+=1) {
+    if (eptx->inputRing.array[index] == urb) return index;
+  }
+
+  return -1;
+}
+
+/* A ring URB is marked as submitted until its completion has been handled,
+ * i.e. while the kernel, or the completed requests queue, still has it.
+ */
+static int
+usbSubmitRingURB (UsbEndpoint *endpoint, void *request) {
+  UsbEndpointExtension *eptx = endpoint->extension;
+  struct usbdevfs_urb *urb = request;
+  int index = usbGetRingURB(eptx, urb);
+
+  urb->status = 0;
+  urb->flags = 0;
+  urb->actual_length = 0;
+  urb->signr = 0;
+
+  if (!usbSubmitURB(urb, endpoint)) return 0;
+  if (index >= 0) eptx->inputRing.submitted[index] = 1;
+  return 1;
+}
+
+static int
+usbHandleCompletedRingURB (UsbEndpoint *endpoint, struct usbdevfs_urb *urb) {
+  ssize_t count = urb->actual_length;
+  int error = urb->status;
+
+  if (error) {
+    if (error < 0) error = -error;
+    errno = error;
+    logSystemError("USB URB status");
+    return 0;
+  }
+
+  if (!usbApplyInputFilters(endpoint, urb->buffer, urb->buffer_length, &count)) {
+    errno = EIO;
+    return 0;
+  }
+
+  /* The URB is resubmitted once the reader has consumed its data. */
+  if (count > 0) return usbHoldInputResponse(endpoint, urb, urb->buffer, count);
+
+  /* The host controller polls at the endpoint's interval so an empty
+   * completion can be resubmitted immediately.
+   */
+  return usbSubmitRingURB(endpoint, urb);
+}
+
+static int
+usbStartInputRing (UsbEndpoint *endpoint) {
+  UsbEndpointExtension *eptx = endpoint->extension;
+  size_t size = getLittleEndian16(endpoint->descriptor->wMaxPacketSize);
+
+  while (eptx->inputRing.count < ARRAY_COUNT(eptx->inputRing.array)) {
+    struct usbdevfs_urb *urb = usbMakeURB(endpoint->descriptor, NULL, size, endpoint);
+
+    if (!urb) break;
+    eptx->inputRing.array[eptx->inputRing.count] = urb;
+    eptx->inputRing.submitted[eptx->inputRing.count] = 0;
+    eptx->inputRing.count += 1;
+
+    if (!usbSubmitRingURB(endpoint, urb)) {
+      eptx->inputRing.count -= 1;
+      free(urb);
+      break;
+    }
+  }
+
+  if (!eptx->inputRing.count) return 0;
+
+  logMessage(LOG_CATEGORY(USB_IO), "input ring started: Ept:%02X URBs:%u",
+             endpoint->descriptor->bEndpointAddress, eptx->inputRing.count);
+  return 1;
+}
+
+static void
+usbStopInputRing (UsbEndpoint *endpoint) {
+  UsbDevice *device = endpoint->device;
+  UsbDeviceExtension *devx = device->extension;
+  UsbEndpointExtension *eptx = endpoint->extension;
+
+  while (eptx->inputRing.count) {
+    struct usbdevfs_urb *urb = eptx->inputRing.array[--eptx->inputRing.count];
+
+    if (eptx->inputRing.submitted[eptx->inputRing.count]) {
+      int found = 0;
+
+      if (devx->usbfsFile != -1) {
+        int reap = 1;
+
+        if (ioctl(devx->usbfsFile, USBDEVFS_DISCARDURB, urb) == -1) {
+          if (errno == ENODEV) {
+            reap = 0;
+          } else if (errno != EINVAL) {
+            logSystemError("USB URB discard");
+          }
+        }
+
+        /* the kernel writes into the URB until it's been reaped,
+         * and a discarded URB is returned promptly
+         */
+        while (!(found = deleteItem(eptx->completedRequests, urb))) {
+          if (!reap) break;
+          if (!usbReapURB(device, 1)) break;
+        }
+      }
+
+      if (!found) {
+        /* it might still be returned so it mustn't be freed */
+        logMessage(LOG_ERR, "USB request not found: urb=%p ept=%02X",
+                   urb, urb->endpoint);
+        continue;
+      }
+    }
+
+    free(urb);
+  }
+}
+
 ASYNC_MONITOR_CALLBACK(usbHandleCompletedInputRequests) {
   UsbDevice *device = parameters->data;
   UsbEndpoint *endpoint;
@@ -1083,10 +1255,19 @@ ASYNC_MONITOR_CALLBACK(usbHandleCompletedInputRequests) {
       usbLogURB(urb, "reaped");
 
       {
-        int handled = usbHandleCompletedInputRequest(endpoint, urb);
-        if (!handled) usbSetEndpointInputError(endpoint, errno);
+        int ringIndex = usbGetRingURB(eptx, urb);
+        int isRing = ringIndex >= 0;
+        int handled;
+
+        if (isRing) {
+          eptx->inputRing.submitted[ringIndex] = 0;
+          handled = usbHandleCompletedRingURB(endpoint, urb);
+        } else {
+          handled = usbHandleCompletedInputRequest(endpoint, urb);
+        }
 
-        free(urb);
+        if (!handled) usbSetEndpointInputError(endpoint, errno);
+        if (!isRing) usbRecycleURB(endpoint, urb);
         if (!handled) return 0;
       }
     }
@@ -1140,6 +1321,12 @@ usbPrepareInputEndpoint (UsbEndpoint *endpoint) {
                          usbStartUsbfsMonitor(device);
 
     if (monitorStarted) {
+      if (!LINUX_USB_INPUT_USE_SIGNAL_MONITOR) {
+        endpoint->direction.input.ring.start = usbStartInputRing;
+        endpoint->direction.input.ring.release = usbSubmitRingURB;
+        endpoint->direction.input.ring.stop = usbStopInputRing;
+      }
+
       return 1;
     } else {
       usbLogInputProblem(endpoint, "monitor not started");
@@ -1160,6 +1347,8 @@ usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
   if ((eptx = malloc(sizeof(*eptx)))) {
     memset(eptx, 0, sizeof(*eptx));
     usbInitializeSignalMonitor(eptx);
+    eptx->spareRequests.count = 0;
+    eptx->inputRing.count = 0;
 
     if ((eptx->completedRequests = newQueue(NULL, NULL))) {
       switch (USB_ENDPOINT_DIRECTION(endpoint->descriptor)) {
@@ -1186,6 +1375,10 @@ void
 usbDeallocateEndpointExtension (UsbEndpointExtension *eptx) {
   usbStopSignalMonitor(eptx);
 
+  while (eptx->spareRequests.count) {
+    free(eptx->spareRequests.array[--eptx->spareRequests.count]);
+  }
+
   if (eptx->completedRequests) {
     deallocateQueue(eptx->completedRequests);
     eptx->completedRequests = NULL;